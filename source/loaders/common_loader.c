@@ -53,6 +53,7 @@
  */
 #include <syslog.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <dlfcn.h>
 
 /*
@@ -66,6 +67,12 @@ GlobusDebugDefine(GLOBUS_GRIDFTP_SERVER_HPSS);
 /* Our handle reference which we hold between activate / deactivate. */
 static void * _real_module_handle = NULL;
 
+/* Set in the environment to warm up the real module at activation. */
+#define LOADER_WARMUP_ENV "HPSS_DSI_PREFORK_WARMUP"
+
+/* Entry point in the real module that does the warm up. */
+#define LOADER_WARMUP_FUNC "dsi_warmup"
+
 static void
 loader_log_to_syslog(const char * Format, ...)
 {
@@ -115,6 +122,24 @@ loader_activate(const char                 * DsiName,
 		return GLOBUS_FAILURE;
 	}
 
+	/*
+	 * When the server loads us at startup (load_dsi_module), this runs in
+	 * the parent before any session forks, so sessions inherit the parsed
+	 * config and an initialized HPSS client instead of each doing it. A
+	 * failure here is not fatal; sessions just do the work themselves.
+	 */
+	if (getenv(LOADER_WARMUP_ENV))
+	{
+		int (*warmup)() = (int (*)())dlsym(_real_module_handle, LOADER_WARMUP_FUNC);
+
+		if (!warmup)
+			loader_log_to_syslog("Failed to find symbol %s in libglobus_gridftp_server_hpss_real.so: %s",
+			                     LOADER_WARMUP_FUNC,
+			                     dlerror());
+		else if (warmup())
+			loader_log_to_syslog("HPSS DSI warm up failed; sessions will initialize on their own");
+	}
+
 	globus_extension_registry_add(GLOBUS_GFS_DSI_REGISTRY,
 	                              DsiName,
 	                              Module,
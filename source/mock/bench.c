@@ -0,0 +1,1185 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * hpss_dsi_bench drives the DSI's session start, STOR, RETR and CKSM paths
+ * in process, standing in for globus-gridftp-server. The DSI is loaded
+ * from its shared library and the server calls it makes are answered by
+ * the functions below, which take precedence over libglobus_gridftp_server
+ * because this program exports them (-rdynamic) and the DSI is not loaded
+ * with RTLD_DEEPBIND.
+ *
+ * The data channel is a pool of stream threads, one per stream, which pace
+ * each buffer to the configured network latency and rate. STOR is fed a
+ * generated pattern which RETR verifies when it follows a STOR in the same
+ * run.
+ *
+ * With -R, the operations marked in a call trace (see calltrace.h) are
+ * issued instead, in order, against the paths they were recorded on. The
+ * trace is also handed to the mock library (HPSS_MOCK_REPLAY) so each HPSS
+ * call takes as long as it did when it was recorded.
+ *
+ * Run it against the mock HPSS library (see README) to measure the DSI's
+ * own overhead, or against a real HPSS client library for an end to end
+ * figure without a GridFTP client.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <pwd.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "calltrace.h"
+
+#define BENCH_DEFAULT_DSI  "libglobus_gridftp_server_hpss_real.so"
+#define BENCH_DSI_IFACE    "hpss_local_dsi_iface"
+#define BENCH_MAX_STREAMS  64
+
+typedef enum {
+	BENCH_STOR,
+	BENCH_RETR,
+	BENCH_CKSM,
+	BENCH_STAT,
+	BENCH_KINDS,
+} bench_kind_t;
+
+static const char * bench_kind_names[BENCH_KINDS] = {"stor", "retr", "cksm", "stat"};
+
+/* An operation read from a call trace. */
+typedef struct {
+	bench_kind_t Kind;
+	char       * Path;
+	globus_off_t Size;       // STOR allocation size
+	int          StatFlags;  // CALLTRACE_STAT_*
+} bench_replay_op_t;
+
+/* Stands in for the server's operation handle. */
+typedef struct {
+	pthread_mutex_t Lock;
+	pthread_cond_t  Cond;
+	int             Finished;
+	globus_result_t Result;
+	void          * SessionArg;
+	int             Verify;       // RETR checks the pattern
+	globus_off_t    Size;
+	globus_off_t    RecvOffset;   // STOR offset handed out so far
+	int             ReadRanges;   // RETR calls to get_read_range()
+	int             Outstanding;  // Data channel requests in flight
+	uint64_t        BadBytes;     // RETR bytes that failed verification
+	uint64_t        Bytes;        // Moved across the data channel
+
+	uint64_t        Start;
+	uint64_t        Begin;        // begin_transfer()
+	uint64_t        FirstData;
+	uint64_t        LastData;
+	uint64_t        End;          // finished_*()
+} bench_op_t;
+
+typedef struct bench_request {
+	struct bench_request            * Next;
+	bench_op_t                      * Op;
+	globus_byte_t                   * Buffer;
+	globus_size_t                     Length;
+	globus_off_t                      Offset;
+	globus_gridftp_server_read_cb_t   ReadCallback;  // NULL for writes
+	globus_gridftp_server_write_cb_t  WriteCallback;
+	void                            * Arg;
+} bench_request_t;
+
+typedef struct {
+	uint64_t Count;
+	uint64_t Bytes;
+	uint64_t Sum[4];
+	uint64_t Min[4];
+	uint64_t Max[4];
+} bench_stats_t;
+
+/* Phases of a transfer, in usecs. */
+enum {
+	BENCH_PHASE_OPEN,  // Start to begin_transfer()
+	BENCH_PHASE_DATA,  // begin_transfer() to last data
+	BENCH_PHASE_CLOSE, // Last data to finished
+	BENCH_PHASE_TOTAL,
+};
+
+static const char * bench_phase_names[] = {"open", "data", "close", "total"};
+
+static struct {
+	/* Options */
+	char          * Library;
+	char          * Path;
+	char          * UserName;
+	globus_off_t    Size;
+	globus_size_t   BlockSize;
+	int             Streams;
+	int             Iterations;
+	int             Kinds[BENCH_KINDS * 4];
+	int             KindCount;
+	uint64_t        NetLatency;   // usecs per buffer
+	uint64_t        NetRate;      // MB/s across all streams, 0 = unlimited
+	char          * Replay;       // Call trace to replay
+	int             Verbose;
+
+	/* Replay */
+	bench_replay_op_t * ReplayOps;
+	int                 ReplayCount;
+	int                 ReplaySkipped; // Operations we can not issue
+
+	/* Data channel */
+	pthread_mutex_t Lock;
+	pthread_cond_t  Cond;
+	bench_request_t * Head;
+	bench_request_t * Tail;
+	int             Shutdown;
+	pthread_t       Threads[BENCH_MAX_STREAMS];
+
+	bench_stats_t   Stats[BENCH_KINDS];
+} bench = {
+	.Library    = BENCH_DEFAULT_DSI,
+	.Path       = "/hpss_dsi_bench.dat",
+	.Size       = 256*1024*1024,
+	.BlockSize  = 4*1024*1024,
+	.Streams    = 4,
+	.Iterations = 3,
+	.Lock       = PTHREAD_MUTEX_INITIALIZER,
+	.Cond       = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t
+bench_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+bench_sleep_until(uint64_t Deadline)
+{
+	uint64_t now = bench_now();
+
+	if (Deadline > now)
+		usleep(Deadline - now);
+}
+
+/* Pattern byte for a file offset; 251 is prime so it never lines up with a block. */
+static inline globus_byte_t
+bench_pattern(globus_off_t Offset)
+{
+	return Offset % 251;
+}
+
+static void
+bench_fill(globus_byte_t * Buffer, globus_size_t Length, globus_off_t Offset)
+{
+	globus_size_t i;
+	globus_byte_t value = bench_pattern(Offset);
+
+	for (i = 0; i < Length; i++)
+	{
+		Buffer[i] = value;
+		if (++value == 251)
+			value = 0;
+	}
+}
+
+static uint64_t
+bench_verify(globus_byte_t * Buffer, globus_size_t Length, globus_off_t Offset)
+{
+	globus_size_t i;
+	uint64_t      bad   = 0;
+	globus_byte_t value = bench_pattern(Offset);
+
+	for (i = 0; i < Length; i++)
+	{
+		if (Buffer[i] != value)
+			bad++;
+		if (++value == 251)
+			value = 0;
+	}
+	return bad;
+}
+
+static void
+bench_op_init(bench_op_t * Op, globus_off_t Size, int Verify)
+{
+	memset(Op, 0, sizeof(bench_op_t));
+	pthread_mutex_init(&Op->Lock, NULL);
+	pthread_cond_init(&Op->Cond, NULL);
+	Op->Size   = Size;
+	Op->Verify = Verify;
+	Op->Start  = bench_now();
+}
+
+static void
+bench_op_destroy(bench_op_t * Op)
+{
+	pthread_mutex_destroy(&Op->Lock);
+	pthread_cond_destroy(&Op->Cond);
+}
+
+static void
+bench_op_finish(globus_gfs_operation_t Operation, globus_result_t Result)
+{
+	bench_op_t * op = (bench_op_t *)Operation;
+
+	pthread_mutex_lock(&op->Lock);
+	{
+		op->Result   = Result;
+		op->End      = bench_now();
+		op->Finished = 1;
+		pthread_cond_broadcast(&op->Cond);
+	}
+	pthread_mutex_unlock(&op->Lock);
+}
+
+/* Waits for the DSI to finish the op and for the data channel to let go of it. */
+static globus_result_t
+bench_op_wait(bench_op_t * Op)
+{
+	globus_result_t result;
+
+	pthread_mutex_lock(&Op->Lock);
+	{
+		while (!Op->Finished || Op->Outstanding)
+			pthread_cond_wait(&Op->Cond, &Op->Lock);
+		result = Op->Result;
+	}
+	pthread_mutex_unlock(&Op->Lock);
+
+	return result;
+}
+
+static void
+bench_print_error(const char * What, globus_result_t Result)
+{
+	char * message = globus_error_print_friendly(globus_error_peek(Result));
+
+	fprintf(stderr, "%s failed: %s\n", What, message ? message : "unknown error");
+	free(message);
+}
+
+/*
+ * Data channel.
+ */
+
+static void
+bench_queue_request(bench_request_t * Request)
+{
+	pthread_mutex_lock(&Request->Op->Lock);
+	Request->Op->Outstanding++;
+	pthread_mutex_unlock(&Request->Op->Lock);
+
+	pthread_mutex_lock(&bench.Lock);
+	{
+		Request->Next = NULL;
+		if (bench.Tail)
+			bench.Tail->Next = Request;
+		else
+			bench.Head = Request;
+		bench.Tail = Request;
+		pthread_cond_signal(&bench.Cond);
+	}
+	pthread_mutex_unlock(&bench.Lock);
+}
+
+/* Moves one buffer across the simulated network. */
+static void
+bench_serve_request(bench_request_t * Request, uint64_t * Deadline)
+{
+	bench_op_t   * op      = Request->Op;
+	globus_size_t  length  = Request->Length;
+	globus_off_t   offset  = 0;
+	globus_bool_t  eof     = GLOBUS_FALSE;
+	uint64_t       bad     = 0;
+	uint64_t       now     = bench_now();
+
+	/* STOR: the data arrives in order across the streams. */
+	if (Request->ReadCallback)
+	{
+		pthread_mutex_lock(&op->Lock);
+		{
+			offset = op->RecvOffset;
+			if (length > op->Size - offset)
+				length = op->Size - offset;
+			op->RecvOffset += length;
+			eof = (op->RecvOffset == op->Size);
+		}
+		pthread_mutex_unlock(&op->Lock);
+
+		bench_fill(Request->Buffer, length, offset);
+	} else if (op->Verify)
+	{
+		bad = bench_verify(Request->Buffer, length, Request->Offset);
+	}
+
+	if (*Deadline < now)
+		*Deadline = now;
+	*Deadline += bench.NetLatency;
+	if (bench.NetRate)
+		*Deadline += length * bench.Streams / bench.NetRate;
+	bench_sleep_until(*Deadline);
+
+	pthread_mutex_lock(&op->Lock);
+	{
+		now = bench_now();
+		if (!op->FirstData)
+			op->FirstData = now;
+		op->LastData  = now;
+		op->BadBytes += bad;
+		op->Bytes    += length;
+	}
+	pthread_mutex_unlock(&op->Lock);
+
+	if (Request->ReadCallback)
+		Request->ReadCallback((globus_gfs_operation_t)op,
+		                      GLOBUS_SUCCESS,
+		                      Request->Buffer,
+		                      length,
+		                      offset,
+		                      eof,
+		                      Request->Arg);
+	else
+		Request->WriteCallback((globus_gfs_operation_t)op,
+		                       GLOBUS_SUCCESS,
+		                       Request->Buffer,
+		                       length,
+		                       Request->Arg);
+
+	pthread_mutex_lock(&op->Lock);
+	{
+		op->Outstanding--;
+		pthread_cond_broadcast(&op->Cond);
+	}
+	pthread_mutex_unlock(&op->Lock);
+
+	free(Request);
+}
+
+static void *
+bench_stream_thread(void * Arg)
+{
+	bench_request_t * request  = NULL;
+	uint64_t          deadline = 0;
+
+	while (1)
+	{
+		pthread_mutex_lock(&bench.Lock);
+		{
+			while (!bench.Head && !bench.Shutdown)
+				pthread_cond_wait(&bench.Cond, &bench.Lock);
+
+			request = bench.Head;
+			if (request)
+			{
+				bench.Head = request->Next;
+				if (!bench.Head)
+					bench.Tail = NULL;
+			}
+		}
+		pthread_mutex_unlock(&bench.Lock);
+
+		if (!request)
+			break;
+
+		bench_serve_request(request, &deadline);
+	}
+	return NULL;
+}
+
+static globus_result_t
+bench_new_request(globus_gfs_operation_t   Operation,
+                  globus_byte_t          * Buffer,
+                  globus_size_t            Length,
+                  globus_off_t             Offset,
+                  void                   * ReadCallback,
+                  void                   * WriteCallback,
+                  void                   * Arg)
+{
+	bench_request_t * request = calloc(1, sizeof(bench_request_t));
+
+	if (!request)
+		return globus_error_put(globus_error_construct_string(NULL, NULL, "out of memory"));
+
+	request->Op            = (bench_op_t *)Operation;
+	request->Buffer        = Buffer;
+	request->Length        = Length;
+	request->Offset        = Offset;
+	request->ReadCallback  = ReadCallback;
+	request->WriteCallback = WriteCallback;
+	request->Arg           = Arg;
+
+	bench_queue_request(request);
+	return GLOBUS_SUCCESS;
+}
+
+/*
+ * The server side of the DSI interface.
+ */
+
+void
+globus_gfs_log_message(globus_gfs_log_type_t Type, const char * Format, ...)
+{
+	va_list ap;
+
+	if (!bench.Verbose)
+		return;
+
+	va_start(ap, Format);
+	vfprintf(stderr, Format, ap);
+	va_end(ap);
+}
+
+void
+globus_gridftp_server_finished_session_start(globus_gfs_operation_t   Operation,
+                                             globus_result_t          Result,
+                                             void                   * SessionArg,
+                                             char                   * UserName,
+                                             char                   * HomeDirectory)
+{
+	((bench_op_t *)Operation)->SessionArg = SessionArg;
+	/* The server takes ownership of the home directory. */
+	free(HomeDirectory);
+	bench_op_finish(Operation, Result);
+}
+
+void
+globus_gridftp_server_finished_transfer(globus_gfs_operation_t Operation, globus_result_t Result)
+{
+	bench_op_finish(Operation, Result);
+}
+
+void
+globus_gridftp_server_finished_command(globus_gfs_operation_t   Operation,
+                                       globus_result_t          Result,
+                                       char                   * CommandResponse)
+{
+	if (bench.Verbose && CommandResponse)
+		fprintf(stderr, "%s\n", CommandResponse);
+	bench_op_finish(Operation, Result);
+}
+
+void
+globus_gridftp_server_intermediate_command(globus_gfs_operation_t   Operation,
+                                           globus_result_t          Result,
+                                           char                   * CommandResponse)
+{
+	if (bench.Verbose && CommandResponse)
+		fprintf(stderr, "%s\n", CommandResponse);
+}
+
+void
+globus_gridftp_server_finished_stat(globus_gfs_operation_t   Operation,
+                                    globus_result_t          Result,
+                                    globus_gfs_stat_t      * StatArray,
+                                    int                      StatCount)
+{
+	bench_op_finish(Operation, Result);
+}
+
+void
+globus_gridftp_server_finished_stat_partial(globus_gfs_operation_t   Operation,
+                                            globus_result_t          Result,
+                                            globus_gfs_stat_t      * StatArray,
+                                            int                      StatCount)
+{
+}
+
+void
+globus_gridftp_server_begin_transfer(globus_gfs_operation_t   Operation,
+                                     int                      EventMask,
+                                     void                   * EventArg)
+{
+	((bench_op_t *)Operation)->Begin = bench_now();
+}
+
+void
+globus_gridftp_server_get_block_size(globus_gfs_operation_t Operation, globus_size_t * BlockSize)
+{
+	*BlockSize = bench.BlockSize;
+}
+
+void
+globus_gridftp_server_get_optimal_concurrency(globus_gfs_operation_t Operation, int * Count)
+{
+	*Count = bench.Streams;
+}
+
+/* The whole file, once. */
+void
+globus_gridftp_server_get_read_range(globus_gfs_operation_t   Operation,
+                                     globus_off_t           * Offset,
+                                     globus_off_t           * Length)
+{
+	bench_op_t * op = (bench_op_t *)Operation;
+
+	*Offset = 0;
+	*Length = op->ReadRanges++ ? 0 : -1;
+}
+
+void
+globus_gridftp_server_get_write_range(globus_gfs_operation_t   Operation,
+                                      globus_off_t           * Offset,
+                                      globus_off_t           * Length)
+{
+	*Offset = 0;
+	*Length = -1;
+}
+
+void
+globus_gridftp_server_get_update_interval(globus_gfs_operation_t Operation, int * Interval)
+{
+	*Interval = 5;
+}
+
+void
+globus_gridftp_server_update_bytes_written(globus_gfs_operation_t Operation,
+                                           globus_off_t           Offset,
+                                           globus_off_t           Length)
+{
+}
+
+void
+globus_gridftp_server_update_bytes_recvd(globus_gfs_operation_t Operation, globus_off_t Length)
+{
+}
+
+void
+globus_gridftp_server_update_range_recvd(globus_gfs_operation_t Operation,
+                                         globus_off_t           Offset,
+                                         globus_off_t           Length)
+{
+}
+
+globus_result_t
+globus_gridftp_server_register_read(globus_gfs_operation_t            Operation,
+                                    globus_byte_t                   * Buffer,
+                                    globus_size_t                     Length,
+                                    globus_gridftp_server_read_cb_t   Callback,
+                                    void                            * UserArg)
+{
+	return bench_new_request(Operation, Buffer, Length, 0, Callback, NULL, UserArg);
+}
+
+globus_result_t
+globus_gridftp_server_register_write(globus_gfs_operation_t             Operation,
+                                     globus_byte_t                    * Buffer,
+                                     globus_size_t                      Length,
+                                     globus_off_t                       Offset,
+                                     int                                StripeIndex,
+                                     globus_gridftp_server_write_cb_t   Callback,
+                                     void                             * UserArg)
+{
+	return bench_new_request(Operation, Buffer, Length, Offset, NULL, Callback, UserArg);
+}
+
+/* Only the SITE commands ask and the benchmark does not issue them. */
+globus_result_t
+globus_gridftp_server_query_op_info(globus_gfs_operation_t     Operation,
+                                    globus_gfs_op_info_t       OpInfo,
+                                    globus_gfs_op_info_param_t Param,
+                                    ...)
+{
+	return globus_error_put(globus_error_construct_string(NULL, NULL, "not supported by the benchmark"));
+}
+
+globus_result_t
+globus_gridftp_server_add_command(globus_gfs_operation_t   Operation,
+                                  const char             * CommandName,
+                                  int                      CommandId,
+                                  int                      MinArgs,
+                                  int                      MaxArgs,
+                                  const char             * HelpString,
+                                  globus_bool_t            HasPathname,
+                                  int                      AccessType)
+{
+	return GLOBUS_SUCCESS;
+}
+
+/*
+ * Driver.
+ */
+
+static globus_result_t
+bench_run(globus_gfs_storage_iface_t * Iface,
+          void                       * SessionArg,
+          bench_kind_t                 Kind,
+          char                       * Path,
+          globus_off_t                 Size,
+          int                          Verify,
+          int                          StatFlags,
+          bench_op_t                 * Op)
+{
+	globus_gfs_transfer_info_t transfer_info;
+	globus_gfs_command_info_t  command_info;
+	globus_gfs_stat_info_t     stat_info;
+
+	memset(&transfer_info, 0, sizeof(transfer_info));
+	memset(&command_info, 0, sizeof(command_info));
+	memset(&stat_info, 0, sizeof(stat_info));
+
+	bench_op_init(Op, Size, Verify);
+
+	switch (Kind)
+	{
+	case BENCH_STOR:
+	case BENCH_RETR:
+		transfer_info.pathname   = Path;
+		transfer_info.alloc_size = Size;
+		transfer_info.truncate   = GLOBUS_TRUE;
+		globus_range_list_init(&transfer_info.range_list);
+		globus_range_list_insert(transfer_info.range_list, 0, -1);
+
+		if (Kind == BENCH_STOR)
+			Iface->recv_func((globus_gfs_operation_t)Op, &transfer_info, SessionArg);
+		else
+			Iface->send_func((globus_gfs_operation_t)Op, &transfer_info, SessionArg);
+
+		bench_op_wait(Op);
+		globus_range_list_destroy(transfer_info.range_list);
+		break;
+
+	case BENCH_CKSM:
+		command_info.command     = GLOBUS_GFS_CMD_CKSM;
+		command_info.pathname    = Path;
+		command_info.cksm_alg    = "MD5";
+		command_info.cksm_offset = 0;
+		command_info.cksm_length = -1;
+
+		Iface->command_func((globus_gfs_operation_t)Op, &command_info, SessionArg);
+		bench_op_wait(Op);
+		break;
+
+	case BENCH_STAT:
+		stat_info.pathname         = Path;
+		stat_info.file_only        = (StatFlags & CALLTRACE_STAT_FILE_ONLY) ? GLOBUS_TRUE : GLOBUS_FALSE;
+		stat_info.use_symlink_info = (StatFlags & CALLTRACE_STAT_SYMLINK) ? GLOBUS_TRUE : GLOBUS_FALSE;
+
+		Iface->stat_func((globus_gfs_operation_t)Op, &stat_info, SessionArg);
+		bench_op_wait(Op);
+		break;
+
+	default:
+		break;
+	}
+
+	if (!Op->Result && Op->BadBytes)
+		return globus_error_put(globus_error_construct_string(NULL, NULL, "data did not verify"));
+	return Op->Result;
+}
+
+static void
+bench_record(bench_kind_t Kind, bench_op_t * Op)
+{
+	bench_stats_t * stats = &bench.Stats[Kind];
+	uint64_t        phases[4] = {0};
+	int             i;
+
+	/* CKSM and STAT only have a total. */
+	if (Op->Begin)
+	{
+		phases[BENCH_PHASE_OPEN]  = Op->Begin - Op->Start;
+		phases[BENCH_PHASE_DATA]  = (Op->LastData ? Op->LastData : Op->Begin) - Op->Begin;
+		phases[BENCH_PHASE_CLOSE] = Op->End - (Op->LastData ? Op->LastData : Op->Begin);
+	}
+	phases[BENCH_PHASE_TOTAL] = Op->End - Op->Start;
+
+	for (i = 0; i < 4; i++)
+	{
+		if (stats->Count == 0 || phases[i] < stats->Min[i])
+			stats->Min[i] = phases[i];
+		if (phases[i] > stats->Max[i])
+			stats->Max[i] = phases[i];
+		stats->Sum[i] += phases[i];
+	}
+	stats->Count++;
+	stats->Bytes += Op->Bytes;
+}
+
+static void
+bench_report()
+{
+	int             kind;
+	int             i;
+	bench_stats_t * stats;
+
+	printf("%-5s %5s %10s", "op", "runs", "MB/s");
+	for (i = 0; i < 4; i++)
+		printf(" %26s", bench_phase_names[i]);
+	printf("\n%-5s %5s %10s", "", "", "");
+	for (i = 0; i < 4; i++)
+		printf(" %8s %8s %8s", "avg ms", "min", "max");
+	printf("\n");
+
+	for (kind = 0; kind < BENCH_KINDS; kind++)
+	{
+		stats = &bench.Stats[kind];
+		if (!stats->Count)
+			continue;
+
+		printf("%-5s %5"PRIu64" %10.1f",
+		       bench_kind_names[kind],
+		       stats->Count,
+		       stats->Sum[BENCH_PHASE_TOTAL] ?
+		           (double)stats->Bytes / stats->Sum[BENCH_PHASE_TOTAL] : 0.0);
+
+		for (i = 0; i < 4; i++)
+			printf(" %8.1f %8.1f %8.1f",
+			       stats->Sum[i] / 1000.0 / stats->Count,
+			       stats->Min[i] / 1000.0,
+			       stats->Max[i] / 1000.0);
+		printf("\n");
+	}
+}
+
+static uint64_t
+bench_parse_size(const char * Value)
+{
+	char   * end  = NULL;
+	uint64_t size = strtoull(Value, &end, 0);
+
+	switch (*end)
+	{
+	case 'g': case 'G': size *= 1024;
+	case 'm': case 'M': size *= 1024;
+	case 'k': case 'K': size *= 1024;
+	}
+	return size;
+}
+
+static int
+bench_parse_kinds(char * Value)
+{
+	char * kind    = NULL;
+	char * saveptr = NULL;
+	int    i;
+
+	bench.KindCount = 0;
+	for (kind = strtok_r(Value, ",", &saveptr); kind; kind = strtok_r(NULL, ",", &saveptr))
+	{
+		for (i = 0; i < BENCH_KINDS; i++)
+		{
+			if (strcasecmp(kind, bench_kind_names[i]) == 0)
+				break;
+		}
+
+		if (i == BENCH_KINDS || bench.KindCount == sizeof(bench.Kinds)/sizeof(*bench.Kinds))
+			return 1;
+		bench.Kinds[bench.KindCount++] = i;
+	}
+	return bench.KindCount == 0;
+}
+
+static int
+bench_read(FILE * File, void * Buffer, size_t Length)
+{
+	return Length == 0 || fread(Buffer, Length, 1, File) == 1;
+}
+
+/*
+ * Collects the operation markers from a call trace. Session starts are
+ * covered by our own session and commands other than CKSM are counted but
+ * not issued.
+ */
+static int
+bench_replay_load(const char * Path)
+{
+	uint32_t            i;
+	int                 j;
+	int                 retval   = 1;
+	uint8_t             length   = 0;
+	int                 capacity = 0;
+	FILE              * file     = NULL;
+	char              * path     = NULL;
+	int               * kinds    = NULL;
+	char                name[256];
+	calltrace_header_t  header;
+	calltrace_record_t  record;
+	bench_replay_op_t * ops      = NULL;
+	bench_replay_op_t * op       = NULL;
+
+	file = fopen(Path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", Path, strerror(errno));
+		return 1;
+	}
+
+	if (!bench_read(file, &header, sizeof(header)) || header.Magic != CALLTRACE_MAGIC)
+	{
+		fprintf(stderr, "%s is not a call trace\n", Path);
+		goto cleanup;
+	}
+
+	if (header.Version != CALLTRACE_VERSION)
+	{
+		fprintf(stderr, "%s is a version %u call trace, expected %u\n",
+		        Path, header.Version, CALLTRACE_VERSION);
+		goto cleanup;
+	}
+
+	for (i = 0; i < header.CallCount; i++)
+	{
+		if (!bench_read(file, &length, 1) || !bench_read(file, name, length))
+			goto truncated;
+	}
+
+	/* Map the trace's operations onto ours by name; -1 if we can not issue it. */
+	kinds = malloc(sizeof(int) * (header.OpCount ? header.OpCount : 1));
+	if (!kinds)
+		goto cleanup;
+
+	for (i = 0; i < header.OpCount; i++)
+	{
+		if (!bench_read(file, &length, 1) || !bench_read(file, name, length))
+			goto truncated;
+		name[length] = '\0';
+
+		kinds[i] = -1;
+		for (j = 0; j < BENCH_KINDS; j++)
+		{
+			if (strcasecmp(name, bench_kind_names[j]) == 0)
+				kinds[i] = j;
+		}
+
+		/* Our own session start stands in for the recorded one. */
+		if (strcasecmp(name, "session") == 0)
+			kinds[i] = BENCH_KINDS;
+	}
+
+	while (bench_read(file, &record, sizeof(record)))
+	{
+		path = calloc(1, record.PathLength + 1);
+		if (!path)
+			goto cleanup;
+
+		if (!bench_read(file, path, record.PathLength))
+			goto truncated;
+
+		if (record.Call != CALLTRACE_OPERATION || record.Op >= header.OpCount ||
+		    kinds[record.Op] == BENCH_KINDS)
+		{
+			free(path);
+			path = NULL;
+			continue;
+		}
+
+		if (kinds[record.Op] == -1 || !record.PathLength)
+		{
+			bench.ReplaySkipped++;
+			free(path);
+			path = NULL;
+			continue;
+		}
+
+		if (bench.ReplayCount == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 64;
+			ops = realloc(bench.ReplayOps, sizeof(bench_replay_op_t) * capacity);
+			if (!ops)
+				goto cleanup;
+			bench.ReplayOps = ops;
+		}
+
+		op = &bench.ReplayOps[bench.ReplayCount++];
+		op->Kind      = kinds[record.Op];
+		op->Path      = path;
+		op->Size      = record.Args[0];
+		op->StatFlags = record.Args[0];
+		path = NULL;
+	}
+
+	retval = 0;
+	goto cleanup;
+
+truncated:
+	fprintf(stderr, "%s is truncated\n", Path);
+cleanup:
+	free(path);
+	free(kinds);
+	fclose(file);
+	return retval;
+}
+
+static void
+bench_usage(const char * Program)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  -L <library>   DSI library (default %s)\n"
+	        "  -p <path>      HPSS path to transfer (default %s)\n"
+	        "  -u <user>      Session user (default the current user)\n"
+	        "  -s <size>      File size, k/m/g suffixes allowed (default 256m)\n"
+	        "  -b <size>      GridFTP block size (default 4m)\n"
+	        "  -c <streams>   Parallel streams (default 4)\n"
+	        "  -n <count>     Iterations (default 3)\n"
+	        "  -o <ops>       Comma separated list of stor, retr, cksm, stat (default stor,retr)\n"
+	        "  -l <usecs>     Network latency per buffer (default 0)\n"
+	        "  -r <MB/s>      Network rate across all streams (default unlimited)\n"
+	        "  -R <trace>     Issue the operations recorded in a call trace instead of\n"
+	        "                 -o; STORs without an allocation size send -s bytes\n"
+	        "  -v             Show the DSI's log messages and replies\n"
+	        "The DSI's config file is taken from HPSS_DSI_CONFIG_FILE as usual.\n",
+	        Program,
+	        BENCH_DEFAULT_DSI,
+	        bench.Path);
+}
+
+int
+main(int argc, char * argv[])
+{
+	int                          opt;
+	int                          i;
+	int                          j;
+	int                          stored  = 0;
+	int                          retval  = 1;
+	int                          threads = 0;
+	void                       * handle  = NULL;
+	struct passwd              * pw      = NULL;
+	bench_replay_op_t          * replay  = NULL;
+	globus_result_t              result  = GLOBUS_SUCCESS;
+	globus_gfs_storage_iface_t * iface   = NULL;
+	globus_gfs_session_info_t    session_info;
+	bench_op_t                   session_op;
+	bench_op_t                   op;
+	char                         default_kinds[] = "stor,retr";
+
+	bench_parse_kinds(default_kinds);
+
+	while ((opt = getopt(argc, argv, "L:p:u:s:b:c:n:o:l:r:R:vh")) != -1)
+	{
+		switch (opt)
+		{
+		case 'L': bench.Library    = optarg; break;
+		case 'p': bench.Path       = optarg; break;
+		case 'u': bench.UserName   = optarg; break;
+		case 's': bench.Size       = bench_parse_size(optarg); break;
+		case 'b': bench.BlockSize  = bench_parse_size(optarg); break;
+		case 'c': bench.Streams    = atoi(optarg); break;
+		case 'n': bench.Iterations = atoi(optarg); break;
+		case 'l': bench.NetLatency = strtoull(optarg, NULL, 0); break;
+		case 'r': bench.NetRate    = strtoull(optarg, NULL, 0); break;
+		case 'R': bench.Replay     = optarg; break;
+		case 'v': bench.Verbose    = 1; break;
+		case 'o':
+			if (bench_parse_kinds(optarg))
+			{
+				bench_usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			bench_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (bench.Size <= 0 || bench.BlockSize == 0 || bench.Iterations < 1 ||
+	    bench.Streams < 1 || bench.Streams > BENCH_MAX_STREAMS)
+	{
+		bench_usage(argv[0]);
+		return 1;
+	}
+
+	if (bench.Replay)
+	{
+		if (bench_replay_load(bench.Replay))
+			return 1;
+
+		/* The mock library replays the recorded call times. */
+		setenv("HPSS_MOCK_REPLAY", bench.Replay, 0);
+	}
+
+	if (!bench.UserName)
+	{
+		pw = getpwuid(getuid());
+		if (!pw)
+		{
+			fprintf(stderr, "Unable to determine the current user\n");
+			return 1;
+		}
+		bench.UserName = strdup(pw->pw_name);
+	}
+
+	/* The DSI's periodic callbacks need a threaded callback space. */
+	setenv("GLOBUS_THREAD_MODEL", "pthread", 0);
+	if (globus_module_activate(GLOBUS_COMMON_MODULE) != GLOBUS_SUCCESS)
+	{
+		fprintf(stderr, "Unable to activate globus_common\n");
+		return 1;
+	}
+
+	/* No RTLD_DEEPBIND; the DSI must bind to our server functions. */
+	handle = dlopen(bench.Library, RTLD_NOW|RTLD_GLOBAL);
+	if (!handle)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		goto cleanup;
+	}
+
+	iface = dlsym(handle, BENCH_DSI_IFACE);
+	if (!iface)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		goto cleanup;
+	}
+
+	for (threads = 0; threads < bench.Streams; threads++)
+	{
+		if (pthread_create(&bench.Threads[threads], NULL, bench_stream_thread, NULL))
+		{
+			fprintf(stderr, "Unable to start the stream threads\n");
+			goto cleanup;
+		}
+	}
+
+	memset(&session_info, 0, sizeof(session_info));
+	session_info.username = bench.UserName;
+
+	bench_op_init(&session_op, 0, 0);
+	iface->init_func((globus_gfs_operation_t)&session_op, &session_info);
+	result = bench_op_wait(&session_op);
+	bench_op_destroy(&session_op);
+	if (result)
+	{
+		bench_print_error("Session start", result);
+		goto cleanup;
+	}
+
+	printf("session start %.1f ms, %"GLOBUS_OFF_T_FORMAT" bytes, %zu byte blocks, %d streams\n",
+	       (session_op.End - session_op.Start) / 1000.0,
+	       bench.Size,
+	       (size_t)bench.BlockSize,
+	       bench.Streams);
+
+	/* A trace is replayed once; its HPSS calls are only recorded once. */
+	for (i = 0; bench.Replay && i < bench.ReplayCount; i++)
+	{
+		replay = &bench.ReplayOps[i];
+		result = bench_run(iface,
+		                   session_op.SessionArg,
+		                   replay->Kind,
+		                   replay->Path,
+		                   (replay->Kind == BENCH_STOR && replay->Size > 0) ? replay->Size : bench.Size,
+		                   0,
+		                   replay->StatFlags,
+		                   &op);
+		if (result)
+		{
+			/* The recorded operation may have failed too. */
+			fprintf(stderr, "%s %s: ", bench_kind_names[replay->Kind], replay->Path);
+			bench_print_error("replay", result);
+		}
+
+		bench_record(replay->Kind, &op);
+		bench_op_destroy(&op);
+	}
+
+	if (bench.Replay)
+		printf("replayed %d operations, skipped %d unsupported commands\n",
+		       bench.ReplayCount,
+		       bench.ReplaySkipped);
+
+	for (i = 0; !bench.Replay && i < bench.Iterations; i++)
+	{
+		for (j = 0; j < bench.KindCount; j++)
+		{
+			result = bench_run(iface,
+			                   session_op.SessionArg,
+			                   bench.Kinds[j],
+			                   bench.Path,
+			                   bench.Size,
+			                   stored,
+			                   CALLTRACE_STAT_FILE_ONLY,
+			                   &op);
+			if (result)
+			{
+				bench_print_error(bench_kind_names[bench.Kinds[j]], result);
+				bench_op_destroy(&op);
+				iface->destroy_func(session_op.SessionArg);
+				goto cleanup;
+			}
+
+			if (bench.Kinds[j] == BENCH_STOR)
+				stored = 1;
+
+			bench_record(bench.Kinds[j], &op);
+			bench_op_destroy(&op);
+		}
+	}
+
+	iface->destroy_func(session_op.SessionArg);
+
+	bench_report();
+	retval = 0;
+
+cleanup:
+	pthread_mutex_lock(&bench.Lock);
+	bench.Shutdown = 1;
+	pthread_cond_broadcast(&bench.Cond);
+	pthread_mutex_unlock(&bench.Lock);
+
+	for (i = 0; i < threads; i++)
+	{
+		pthread_join(bench.Threads[i], NULL);
+	}
+
+	globus_module_deactivate(GLOBUS_COMMON_MODULE);
+	return retval;
+}
@@ -0,0 +1,177 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * Client configuration and credentials. There is no core server to log in
+ * to, so logins always succeed and the thread credential is the local
+ * account the DSI masquerades as.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pwd.h>
+
+/*
+ * Local includes
+ */
+#include "mock.h"
+
+static api_config_t _api_config = {0, 0, "", hpss_authn_mech_unix};
+static uid_t        _thread_uid = -1;
+
+char *
+hpss_Getenv(const char * Name)
+{
+	return getenv(Name);
+}
+
+int
+hpss_GetConfiguration(api_config_t * ConfigOut)
+{
+	*ConfigOut = _api_config;
+	return 0;
+}
+
+int
+hpss_SetConfiguration(const api_config_t * ConfigIn)
+{
+	_api_config = *ConfigIn;
+	return 0;
+}
+
+int
+hpss_AuthnMechTypeFromString(const char * AuthnMechString, hpss_authn_mech_t * AuthnMech)
+{
+	if (strcasecmp(AuthnMechString, "krb5") == 0)
+		*AuthnMech = hpss_authn_mech_krb5;
+	else if (strcasecmp(AuthnMechString, "unix") == 0)
+		*AuthnMech = hpss_authn_mech_unix;
+	else if (strcasecmp(AuthnMechString, "gsi") == 0)
+		*AuthnMech = hpss_authn_mech_gsi;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+/* Accepts <auth_type>:<authenticator>, ie unix:/var/hpss/etc/hpss.unix.keytab */
+int
+hpss_ParseAuthString(char                 * AuthString,
+                     hpss_authn_mech_t    * Mechanism,
+                     hpss_rpc_auth_type_t * AuthType,
+                     void                ** Authenticator)
+{
+	char * colon = strchr(AuthString, ':');
+
+	MOCK_REPLAY("hpss_ParseAuthString", NULL);
+
+	if (!colon)
+		return -EINVAL;
+
+	if (strncasecmp(AuthString, "auth_keytab", colon - AuthString) == 0)
+		*AuthType = hpss_rpc_auth_type_keytab;
+	else if (strncasecmp(AuthString, "auth_keyfile", colon - AuthString) == 0)
+		*AuthType = hpss_rpc_auth_type_keyfile;
+	else if (strncasecmp(AuthString, "auth_passwd", colon - AuthString) == 0)
+		*AuthType = hpss_rpc_auth_type_passwd;
+	else
+		*AuthType = hpss_rpc_auth_type_none;
+
+	*Authenticator = strdup(colon + 1);
+	if (!*Authenticator)
+		return -ENOMEM;
+	return 0;
+}
+
+int
+hpss_SetLoginCred(char                 * PrincipalName,
+                  hpss_authn_mech_t      Mechanism,
+                  hpss_rpc_cred_type_t   CredType,
+                  hpss_rpc_auth_type_t   AuthType,
+                  void                 * Authenticator)
+{
+	MOCK_REPLAY("hpss_SetLoginCred", NULL);
+
+	return 0;
+}
+
+int
+hpss_PurgeLoginCred(void)
+{
+	return 0;
+}
+
+int
+hpss_LoadDefaultThreadState(uid_t UserID, mode_t Umask, char * ClientFullName)
+{
+	MOCK_REPLAY("hpss_LoadDefaultThreadState", NULL);
+
+	if (!getpwuid(UserID))
+		return -ESRCH;
+
+	_thread_uid = UserID;
+	umask(Umask);
+	return 0;
+}
+
+int
+hpss_GetThreadUcred(sec_cred_t * RetUcred)
+{
+	struct passwd * pw = getpwuid(_thread_uid == (uid_t)-1 ? geteuid() : _thread_uid);
+
+	memset(RetUcred, 0, sizeof(sec_cred_t));
+	if (!pw)
+		return -ESRCH;
+
+	snprintf(RetUcred->Name, sizeof(RetUcred->Name), "%s", pw->pw_name);
+	snprintf(RetUcred->Directory, sizeof(RetUcred->Directory), "%s", mock_config()->Home);
+	RetUcred->SecPWent_Uid = pw->pw_uid;
+	RetUcred->SecPWent_Gid = pw->pw_gid;
+	return 0;
+}
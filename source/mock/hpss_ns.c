@@ -0,0 +1,519 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * Name space and file calls. Each maps onto the same call against the
+ * backing tree; failures return -errno like the real library.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+
+/*
+ * Local includes
+ */
+#include "mock.h"
+
+#define MOCK_LOCAL_PATH(Path, LocalPath)                                   \
+	do {                                                                   \
+		int _rc = mock_local_path(Path, LocalPath, sizeof(LocalPath));     \
+		if (_rc) return _rc;                                               \
+	} while (0)
+
+static void
+mock_translate_stat(struct stat * Local, hpss_stat_t * Buf)
+{
+	memset(Buf, 0, sizeof(hpss_stat_t));
+	Buf->st_dev        = Local->st_dev;
+	Buf->st_ino        = Local->st_ino;
+	Buf->st_mode       = Local->st_mode;
+	Buf->st_nlink      = Local->st_nlink;
+	Buf->st_uid        = Local->st_uid;
+	Buf->st_gid        = Local->st_gid;
+	Buf->st_size       = Local->st_size;
+	Buf->hpss_st_atime = Local->st_atime;
+	Buf->hpss_st_mtime = Local->st_mtime;
+	Buf->hpss_st_ctime = Local->st_ctime;
+}
+
+static void
+mock_translate_attrs(struct stat * Local, hpss_Attrs_t * Attrs)
+{
+	memset(Attrs, 0, sizeof(hpss_Attrs_t));
+
+	if (S_ISDIR(Local->st_mode))
+		Attrs->Type = NS_OBJECT_TYPE_DIRECTORY;
+	else if (S_ISLNK(Local->st_mode))
+		Attrs->Type = NS_OBJECT_TYPE_SYM_LINK;
+	else
+		Attrs->Type = NS_OBJECT_TYPE_FILE;
+
+	Attrs->FilesetId         = Local->st_dev;
+	Attrs->DataLength        = Local->st_size;
+	Attrs->BitfileId.Device  = Local->st_dev;
+	Attrs->BitfileId.Inode   = Local->st_ino;
+	Attrs->UserPerms         = (Local->st_mode >> 6) & 07;
+	Attrs->GroupPerms        = (Local->st_mode >> 3) & 07;
+	Attrs->OtherPerms        = Local->st_mode & 07;
+	Attrs->ModePerms         = (Local->st_mode >> 9) & 07;
+	Attrs->LinkCount         = Local->st_nlink;
+	Attrs->UID               = Local->st_uid;
+	Attrs->GID               = Local->st_gid;
+	Attrs->COSId             = 1;
+	Attrs->TimeLastRead      = Local->st_atime;
+	Attrs->TimeLastWritten   = Local->st_mtime;
+	Attrs->TimeCreated       = Local->st_ctime;
+	Attrs->TimeModified      = Local->st_mtime;
+}
+
+int
+hpss_Open(const char                  * Path,
+          int                           Oflag,
+          mode_t                        Mode,
+          const hpss_cos_hints_t      * HintsIn,
+          const hpss_cos_priorities_t * HintsPri,
+          hpss_cos_hints_t            * HintsOut)
+{
+	int  fd = -1;
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Open", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+
+	/* Like HPSS, opening a purged file for reading waits for the stage. */
+	if ((Oflag & O_ACCMODE) != O_WRONLY)
+		mock_stage(local_path);
+
+	fd = open(local_path, Oflag, Mode);
+	if (fd == -1)
+		return -errno;
+
+	if (HintsOut)
+	{
+		memset(HintsOut, 0, sizeof(hpss_cos_hints_t));
+		HintsOut->COSId       = 1;
+		HintsOut->StripeWidth = mock_config()->StripeWidth;
+	}
+	return fd;
+}
+
+int
+hpss_Close(int Fildes)
+{
+	MOCK_REPLAY("hpss_Close", NULL);
+
+	return close(Fildes) ? -errno : 0;
+}
+
+int
+hpss_SetCOSByHints(int                           Fildes,
+                   unsigned32                    Flags,
+                   const hpss_cos_hints_t      * HintsPtr,
+                   const hpss_cos_priorities_t * PrioPtr,
+                   hpss_cos_md_t               * COSPtr)
+{
+	MOCK_REPLAY("hpss_SetCOSByHints", NULL);
+
+	if (COSPtr)
+		COSPtr->COSId = 1;
+	return 0;
+}
+
+int
+hpss_Truncate(const char * Path, u_signed64 Length)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Truncate", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return truncate(local_path, Length) ? -errno : 0;
+}
+
+int
+hpss_Stat(const char * Path, hpss_stat_t * Buf)
+{
+	struct stat local;
+	char        local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Stat", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	if (stat(local_path, &local))
+		return -errno;
+
+	mock_translate_stat(&local, Buf);
+	return 0;
+}
+
+int
+hpss_Lstat(const char * Path, hpss_stat_t * Buf)
+{
+	struct stat local;
+	char        local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Lstat", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	if (lstat(local_path, &local))
+		return -errno;
+
+	mock_translate_stat(&local, Buf);
+	return 0;
+}
+
+int
+hpss_FileGetAttributes(const char * Path, hpss_fileattr_t * AttrOut)
+{
+	struct stat local;
+	char        local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_FileGetAttributes", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	if (stat(local_path, &local))
+		return -errno;
+
+	memset(AttrOut, 0, sizeof(hpss_fileattr_t));
+	snprintf(AttrOut->ObjectHandle.Path, sizeof(AttrOut->ObjectHandle.Path), "%s", Path);
+	mock_translate_attrs(&local, &AttrOut->Attrs);
+	return 0;
+}
+
+/*
+ * Every regular file has a disk level over a tape level. Archived files
+ * have nothing left at the disk level; tape only files have no disk level.
+ */
+static int
+mock_get_xattrs(const char * LocalPath, hpss_xfileattr_t * AttrOut)
+{
+	int              level = 0;
+	pv_list_t      * pv_list = NULL;
+	struct stat      local;
+	mock_residency_t residency;
+
+	if (lstat(LocalPath, &local))
+		return -errno;
+
+	memset(AttrOut, 0, sizeof(hpss_xfileattr_t));
+	mock_translate_attrs(&local, &AttrOut->Attrs);
+
+	if (!S_ISREG(local.st_mode))
+		return 0;
+
+	residency = mock_get_residency(LocalPath);
+
+	if (residency != MOCK_TAPE_ONLY)
+	{
+		AttrOut->SCAttrib[level].Flags        = BFS_BFATTRS_LEVEL_IS_DISK;
+		AttrOut->SCAttrib[level].BytesAtLevel = residency == MOCK_ARCHIVED ? 0 : local.st_size;
+		level++;
+	}
+
+	pv_list = malloc(sizeof(pv_list_t));
+	if (!pv_list)
+		return -ENOMEM;
+	pv_list->Length = 1;
+	snprintf(pv_list->List[0].Name, sizeof(pv_list->List[0].Name), "MK%04lu", (unsigned long)(local.st_ino % 10000));
+
+	AttrOut->SCAttrib[level].Flags                  = BFS_BFATTRS_LEVEL_IS_TAPE;
+	AttrOut->SCAttrib[level].BytesAtLevel           = local.st_size;
+	AttrOut->SCAttrib[level].NumberOfVVs            = 1;
+	AttrOut->SCAttrib[level].VVAttrib[0].PVList     = pv_list;
+	AttrOut->SCAttrib[level].VVAttrib[0].BytesOnVV  = local.st_size;
+	return 0;
+}
+
+int
+hpss_FileGetXAttributes(const char       * Path,
+                        unsigned32         Flags,
+                        unsigned32         StorageLevel,
+                        hpss_xfileattr_t * AttrOut)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_FileGetXAttributes", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return mock_get_xattrs(local_path, AttrOut);
+}
+
+int
+hpss_FileGetXAttributesHandle(const ns_ObjHandle_t * ObjHandle,
+                              const char           * Path,
+                              const sec_cred_t     * Ucred,
+                              unsigned32             Flags,
+                              unsigned32             StorageLevel,
+                              hpss_xfileattr_t     * AttrOut)
+{
+	int  rc = 0;
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_FileGetXAttributesHandle", Path);
+	rc = mock_local_path_handle(ObjHandle, Path, local_path, sizeof(local_path));
+	if (rc)
+		return rc;
+	return mock_get_xattrs(local_path, AttrOut);
+}
+
+int
+hpss_FilesetGetAttributes(const char           * Name,
+                          const u_signed64     * FilesetId,
+                          const ns_ObjHandle_t * FilesetHandle,
+                          const void           * GatewayUUID,
+                          ns_FilesetAttrBits_t   FilesetAttrBits,
+                          ns_FilesetAttrs_t    * FilesetAttrs)
+{
+	MOCK_REPLAY("hpss_FilesetGetAttributes", Name);
+
+	/* No fileset forces a class of service. */
+	memset(FilesetAttrs, 0, sizeof(ns_FilesetAttrs_t));
+	return 0;
+}
+
+/*
+ * Offsets are entry indexes (not counting . and ..) so that a listing can
+ * be resumed from a fresh DIR stream.
+ */
+int
+hpss_ReadAttrsHandle(const ns_ObjHandle_t * ObjHandle,
+                     u_signed64             OffsetIn,
+                     const sec_cred_t     * Ucred,
+                     unsigned32             BufferSize,
+                     unsigned32             GetAttributes,
+                     unsigned32           * End,
+                     u_signed64           * OffsetOut,
+                     ns_DirEntry_t        * DirentPtr)
+{
+	int             rc        = 0;
+	int             count     = 0;
+	int             max_count = BufferSize / sizeof(ns_DirEntry_t);
+	u_signed64      index     = 0;
+	DIR           * dir       = NULL;
+	struct dirent * entry     = NULL;
+	struct stat     local;
+	char            local_path[HPSS_MAX_PATH_NAME * 2];
+	char            entry_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_ReadAttrsHandle", NULL);
+	rc = mock_local_path(ObjHandle->Path, local_path, sizeof(local_path));
+	if (rc)
+		return rc;
+
+	dir = opendir(local_path);
+	if (!dir)
+		return -errno;
+
+	*End = TRUE;
+	while ((entry = readdir(dir)))
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		if (index++ < OffsetIn)
+			continue;
+
+		if (count == max_count)
+		{
+			*End = FALSE;
+			break;
+		}
+
+		if (snprintf(entry_path, sizeof(entry_path), "%s/%s", local_path, entry->d_name) >= sizeof(entry_path))
+		{
+			closedir(dir);
+			return -ENAMETOOLONG;
+		}
+		if (lstat(entry_path, &local))
+			continue;
+
+		memset(&DirentPtr[count], 0, sizeof(ns_DirEntry_t));
+		snprintf(DirentPtr[count].Name, sizeof(DirentPtr[count].Name), "%s", entry->d_name);
+		if (snprintf(DirentPtr[count].ObjHandle.Path,
+		             sizeof(DirentPtr[count].ObjHandle.Path),
+		             "%s/%s",
+		             strcmp(ObjHandle->Path, "/") == 0 ? "" : ObjHandle->Path,
+		             entry->d_name) >= sizeof(DirentPtr[count].ObjHandle.Path))
+		{
+			closedir(dir);
+			return -ENAMETOOLONG;
+		}
+		if (GetAttributes)
+			mock_translate_attrs(&local, &DirentPtr[count].Attrs);
+		count++;
+	}
+	closedir(dir);
+
+	*OffsetOut = OffsetIn + count;
+	return count;
+}
+
+static int
+mock_readlink(const char * LocalPath, char * Contents, size_t BufferSize)
+{
+	ssize_t length = readlink(LocalPath, Contents, BufferSize - 1);
+
+	if (length == -1)
+		return -errno;
+	Contents[length] = '\0';
+	return length;
+}
+
+int
+hpss_Readlink(const char * Path, char * Contents, size_t BufferSize)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Readlink", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return mock_readlink(local_path, Contents, BufferSize);
+}
+
+int
+hpss_ReadlinkHandle(const ns_ObjHandle_t * ObjHandle,
+                    const char           * Path,
+                    char                 * Contents,
+                    size_t                 BufferSize,
+                    const sec_cred_t     * Ucred)
+{
+	int  rc = 0;
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_ReadlinkHandle", Path);
+	rc = mock_local_path_handle(ObjHandle, Path, local_path, sizeof(local_path));
+	if (rc)
+		return rc;
+	return mock_readlink(local_path, Contents, BufferSize);
+}
+
+int
+hpss_Mkdir(const char * Path, mode_t Mode)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Mkdir", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return mkdir(local_path, Mode) ? -errno : 0;
+}
+
+int
+hpss_Rmdir(const char * Path)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Rmdir", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return rmdir(local_path) ? -errno : 0;
+}
+
+int
+hpss_Unlink(const char * Path)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Unlink", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return unlink(local_path) ? -errno : 0;
+}
+
+int
+hpss_Rename(const char * Old, const char * New)
+{
+	char old_path[HPSS_MAX_PATH_NAME * 2];
+	char new_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Rename", Old);
+	MOCK_LOCAL_PATH(Old, old_path);
+	MOCK_LOCAL_PATH(New, new_path);
+	return rename(old_path, new_path) ? -errno : 0;
+}
+
+/* Contents is an HPSS path and is stored as is. */
+int
+hpss_Symlink(const char * Contents, const char * Path)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Symlink", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return symlink(Contents, local_path) ? -errno : 0;
+}
+
+int
+hpss_Chmod(const char * Path, mode_t Mode)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Chmod", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return chmod(local_path, Mode) ? -errno : 0;
+}
+
+int
+hpss_Chown(const char * Path, uid_t Owner, gid_t Group)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Chown", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return chown(local_path, Owner, Group) ? -errno : 0;
+}
+
+int
+hpss_Utime(const char * Path, const struct utimbuf * Times)
+{
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_Utime", Path);
+	MOCK_LOCAL_PATH(Path, local_path);
+	return utime(local_path, Times) ? -errno : 0;
+}
+
+mode_t
+hpss_Umask(mode_t CMask)
+{
+	return umask(CMask);
+}
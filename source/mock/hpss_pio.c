@@ -0,0 +1,473 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * Parallel I/O. A stripe group connects the coordinator (hpss_PIOExecute())
+ * with the one participant (hpss_PIORegister()) the DSI uses. Each execute
+ * is handed to the participant, which moves the range block by block
+ * between the backing file and the participant's callback, pacing itself
+ * to the configured mover latency and bandwidth.
+ *
+ * Holes in the backing file are reported as gaps: the execute stops at the
+ * hole and returns its extent, like HPSS does for sparse files.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Local includes
+ */
+#include "mock.h"
+
+struct hpss_pio_grp_s {
+	pthread_mutex_t    Lock;
+	pthread_cond_t     Cond;
+	hpss_pio_params_t  Params;
+	int                References;
+	int                Ended;
+
+	/* The execute in progress. */
+	int                Pending;
+	int                Done;
+	int                FD;
+	u_signed64         Offset;
+	u_signed64         Length;
+	u_signed64         BytesMoved;
+	hpss_pio_gapinfo_t GapInfo;
+	int                Result;
+
+	/* Mover pacing. */
+	uint64_t           Deadline;
+	uint64_t           ReplayDuration; // Recorded execute, usecs
+	uint64_t           ReplaySize;     // Recorded execute, bytes; 0 if none
+
+	/* Bytes moved since the last injected mover fault. */
+	uint64_t           FaultBytes;
+	int                Faulted; // This execute failed with an injected fault
+};
+
+static void
+mock_pio_release(hpss_pio_grp_t Group)
+{
+	int references = 0;
+
+	pthread_mutex_lock(&Group->Lock);
+	references = --Group->References;
+	pthread_mutex_unlock(&Group->Lock);
+
+	if (references == 0)
+	{
+		pthread_mutex_destroy(&Group->Lock);
+		pthread_cond_destroy(&Group->Cond);
+		free(Group);
+	}
+}
+
+int
+hpss_PIOStart(hpss_pio_params_t * InputParams, hpss_pio_grp_t * StripeGroup)
+{
+	hpss_pio_grp_t group = NULL;
+
+	MOCK_REPLAY("hpss_PIOStart", NULL);
+
+	if (InputParams->BlockSize == 0)
+		return -EINVAL;
+
+	group = calloc(1, sizeof(struct hpss_pio_grp_s));
+	if (!group)
+		return -ENOMEM;
+
+	pthread_mutex_init(&group->Lock, NULL);
+	pthread_cond_init(&group->Cond, NULL);
+	group->Params     = *InputParams;
+	group->References = 1;
+
+	if (group->Params.FileStripeWidth < 1)
+		group->Params.FileStripeWidth = 1;
+
+	*StripeGroup = group;
+	return 0;
+}
+
+/*
+ * Ends this side's use of the group. The first call ends the group, which
+ * releases the participant from hpss_PIORegister().
+ */
+int
+hpss_PIOEnd(hpss_pio_grp_t StripeGroup)
+{
+	/* The group must end regardless of how the recorded call went. */
+	mock_replay("hpss_PIOEnd", NULL);
+
+	pthread_mutex_lock(&StripeGroup->Lock);
+	{
+		StripeGroup->Ended = 1;
+		pthread_cond_broadcast(&StripeGroup->Cond);
+	}
+	pthread_mutex_unlock(&StripeGroup->Lock);
+
+	mock_pio_release(StripeGroup);
+	return 0;
+}
+
+/* Groups never leave the process, so the exported form is the pointer. */
+int
+hpss_PIOExportGrp(hpss_pio_grp_t    StripeGroup,
+                  void           ** Buffer,
+                  unsigned int    * BufLength)
+{
+	MOCK_REPLAY("hpss_PIOExportGrp", NULL);
+
+	*Buffer = malloc(sizeof(hpss_pio_grp_t));
+	if (!*Buffer)
+		return -ENOMEM;
+
+	memcpy(*Buffer, &StripeGroup, sizeof(hpss_pio_grp_t));
+	*BufLength = sizeof(hpss_pio_grp_t);
+	return 0;
+}
+
+int
+hpss_PIOImportGrp(const void     * Buffer,
+                  unsigned int     BufLength,
+                  hpss_pio_grp_t * StripeGroup)
+{
+	MOCK_REPLAY("hpss_PIOImportGrp", NULL);
+
+	if (BufLength != sizeof(hpss_pio_grp_t))
+		return -EINVAL;
+
+	memcpy(StripeGroup, Buffer, sizeof(hpss_pio_grp_t));
+
+	pthread_mutex_lock(&(*StripeGroup)->Lock);
+	(*StripeGroup)->References++;
+	pthread_mutex_unlock(&(*StripeGroup)->Lock);
+	return 0;
+}
+
+/*
+ * Charges one block to the mover: the per block latency plus the block's
+ * time at the stripe group's bandwidth or, when replaying, the block's share
+ * of the recorded execute. Time not spent waiting on the mover (ie in the
+ * callback) is not made up later.
+ */
+static void
+mock_pio_pace(hpss_pio_grp_t Group, uint64_t Length)
+{
+	const mock_config_t * config = mock_config();
+	uint64_t              now    = mock_now();
+	uint64_t              cost   = config->MoverLatency;
+
+	if (Group->ReplaySize)
+		cost = Group->ReplayDuration * Length / Group->ReplaySize;
+	else if (config->MoverBandwidth)
+		cost += Length * 1000000 / (config->MoverBandwidth * Group->Params.FileStripeWidth);
+
+	if (Group->Deadline < now)
+		Group->Deadline = now;
+	Group->Deadline += cost;
+
+	mock_sleep_until(Group->Deadline);
+}
+
+/* Returns the end of the data starting at Offset or, if Offset is in a hole, Offset. */
+static u_signed64
+mock_pio_data_end(int FD, u_signed64 Offset, u_signed64 End)
+{
+	off_t data = 0;
+	off_t hole = 0;
+
+	/* Replayed files are sparse stand ins; read the holes as data. */
+	if (mock_config()->Replay)
+		return End;
+
+	data = lseek(FD, Offset, SEEK_DATA);
+
+	/* Past the last data (or no SEEK_DATA support). */
+	if (data == -1)
+		return errno == ENXIO ? Offset : End;
+	if (data > Offset)
+		return Offset;
+
+	hole = lseek(FD, Offset, SEEK_HOLE);
+	if (hole == -1 || hole > End)
+		return End;
+	return hole;
+}
+
+/*
+ * With HPSS_MOCK_MOVER_FAULTS, fails the execute as if the mover connection
+ * dropped with Length bytes in flight. Returns non zero if it did.
+ */
+static int
+mock_pio_fault(hpss_pio_grp_t Group, unsigned32 Length)
+{
+	uint64_t interval = mock_config()->MoverFaults;
+
+	if (!interval)
+		return 0;
+
+	Group->FaultBytes += Length;
+	if (Group->FaultBytes < interval)
+		return 0;
+
+	Group->FaultBytes = 0;
+	Group->Faulted    = 1;
+	Group->Result     = -ECONNRESET;
+	return 1;
+}
+
+static void
+mock_pio_read(hpss_pio_grp_t  Group,
+              char          * Buffer,
+              unsigned32      BufLength,
+              hpss_pio_cb_t   IOCallback,
+              void          * IOCallbackArg)
+{
+	u_signed64 offset   = Group->Offset;
+	u_signed64 end      = Group->Offset + Group->Length;
+	u_signed64 data_end = mock_pio_data_end(Group->FD, offset, end);
+	u_signed64 hole_end = 0;
+	unsigned32 length   = 0;
+	ssize_t    count    = 0;
+	void     * buffer   = NULL;
+
+	/* Report a hole at the front as a gap. */
+	if (data_end == offset)
+	{
+		hole_end = lseek(Group->FD, offset, SEEK_DATA);
+		if (hole_end == (u_signed64)-1 || hole_end > end)
+			hole_end = end;
+		Group->GapInfo.Offset = 0;
+		Group->GapInfo.Length = hole_end - offset;
+		return;
+	}
+
+	while (offset < data_end)
+	{
+		length = BufLength;
+		if (length > data_end - offset)
+			length = data_end - offset;
+
+		mock_pio_pace(Group, length);
+
+		count = pread(Group->FD, Buffer, length, offset);
+		if (count <= 0)
+		{
+			Group->Result = count ? -errno : -EIO;
+			return;
+		}
+		length = count;
+
+		buffer = Buffer;
+		Group->Result = IOCallback(IOCallbackArg, offset, &length, &buffer);
+		if (Group->Result)
+			return;
+
+		if (mock_pio_fault(Group, length))
+			return;
+
+		offset            += length;
+		Group->BytesMoved += length;
+	}
+
+	/* Stopped short at a hole. */
+	if (offset < end)
+	{
+		hole_end = lseek(Group->FD, offset, SEEK_DATA);
+		if (hole_end == (u_signed64)-1 || hole_end > end)
+			hole_end = end;
+		Group->GapInfo.Offset = offset - Group->Offset;
+		Group->GapInfo.Length = hole_end - offset;
+	}
+}
+
+static void
+mock_pio_write(hpss_pio_grp_t  Group,
+               char          * Buffer,
+               unsigned32      BufLength,
+               hpss_pio_cb_t   IOCallback,
+               void          * IOCallbackArg)
+{
+	u_signed64 offset = Group->Offset;
+	u_signed64 end    = Group->Offset + Group->Length;
+	unsigned32 length = 0;
+	ssize_t    count  = 0;
+	void     * buffer = NULL;
+
+	while (offset < end)
+	{
+		length = BufLength;
+		if (length > end - offset)
+			length = end - offset;
+
+		buffer = Buffer;
+		Group->Result = IOCallback(IOCallbackArg, offset, &length, &buffer);
+		if (Group->Result)
+			return;
+
+		if (mock_pio_fault(Group, length))
+			return;
+
+		mock_pio_pace(Group, length);
+
+		count = pwrite(Group->FD, buffer, length, offset);
+		if (count != length)
+		{
+			Group->Result = count == -1 ? -errno : -EIO;
+			return;
+		}
+
+		offset            += length;
+		Group->BytesMoved += length;
+	}
+}
+
+/*
+ * Serves executes until the group is ended. Returns the first error
+ * returned by IOCallback, if any.
+ */
+int
+hpss_PIORegister(unsigned32       StripeElement,
+                 void           * DataNetSockAddr,
+                 void           * DataBuffer,
+                 unsigned32       DataBufLen,
+                 hpss_pio_grp_t   StripeGroup,
+                 hpss_pio_cb_t    IOCallback,
+                 void           * IOCallbackArg)
+{
+	int result = 0;
+
+	if (StripeElement != 0 || !DataBuffer || DataBufLen == 0)
+		return -EINVAL;
+
+	pthread_mutex_lock(&StripeGroup->Lock);
+	while (!StripeGroup->Ended)
+	{
+		if (!StripeGroup->Pending)
+		{
+			pthread_cond_wait(&StripeGroup->Cond, &StripeGroup->Lock);
+			continue;
+		}
+		pthread_mutex_unlock(&StripeGroup->Lock);
+
+		/* Only the coordinator waiting on us looks at the request now. */
+		if (StripeGroup->Params.Operation == HPSS_PIO_READ)
+			mock_pio_read(StripeGroup, DataBuffer, DataBufLen, IOCallback, IOCallbackArg);
+		else
+			mock_pio_write(StripeGroup, DataBuffer, DataBufLen, IOCallback, IOCallbackArg);
+
+		/* Only the coordinator hears about a mover fault. */
+		if (StripeGroup->Result && !StripeGroup->Faulted && !result)
+			result = StripeGroup->Result;
+
+		pthread_mutex_lock(&StripeGroup->Lock);
+		StripeGroup->Pending = 0;
+		StripeGroup->Done    = 1;
+		pthread_cond_broadcast(&StripeGroup->Cond);
+	}
+	pthread_mutex_unlock(&StripeGroup->Lock);
+
+	return result;
+}
+
+int
+hpss_PIOExecute(int                  Fd,
+                u_signed64           FileOffset,
+                u_signed64           Size,
+                hpss_pio_grp_t       StripeGroup,
+                hpss_pio_gapinfo_t * GapInfo,
+                u_signed64         * BytesMoved)
+{
+	int      result   = 0;
+	uint64_t duration = 0;
+	int32_t  retval   = 0;
+	uint64_t args[2]  = {0, 0};
+
+	/* A recorded execute sets the pace of this one; see mock_pio_pace(). */
+	if (!mock_replay_find("hpss_PIOExecute", NULL, &duration, &retval, args))
+		args[1] = 0;
+
+	if (retval < 0)
+	{
+		mock_sleep_until(mock_now() + duration);
+		*BytesMoved = 0;
+		return retval;
+	}
+
+	pthread_mutex_lock(&StripeGroup->Lock);
+	{
+		StripeGroup->FD             = Fd;
+		StripeGroup->Offset         = FileOffset;
+		StripeGroup->Length         = Size;
+		StripeGroup->BytesMoved     = 0;
+		StripeGroup->Result         = 0;
+		StripeGroup->Faulted        = 0;
+		StripeGroup->ReplayDuration = duration;
+		StripeGroup->ReplaySize     = args[1];
+		StripeGroup->Done           = 0;
+		StripeGroup->Pending        = 1;
+		memset(&StripeGroup->GapInfo, 0, sizeof(hpss_pio_gapinfo_t));
+		pthread_cond_broadcast(&StripeGroup->Cond);
+
+		while (!StripeGroup->Done && !StripeGroup->Ended)
+			pthread_cond_wait(&StripeGroup->Cond, &StripeGroup->Lock);
+
+		if (!StripeGroup->Done)
+			result = -ECANCELED;
+		else
+			result = StripeGroup->Result;
+
+		*BytesMoved = StripeGroup->BytesMoved;
+		if (GapInfo)
+			*GapInfo = StripeGroup->GapInfo;
+	}
+	pthread_mutex_unlock(&StripeGroup->Lock);
+
+	return result;
+}
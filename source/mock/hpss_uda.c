@@ -0,0 +1,234 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * User defined attributes and staging. UDAs are kept in the backing file's
+ * extended attributes, one per key, so the backing file system must support
+ * user xattrs.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/xattr.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Local includes
+ */
+#include "mock.h"
+
+#define MOCK_XML_HEADER "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+
+static int
+mock_uda_name(const char * Key, char * Name, size_t Length)
+{
+	if (snprintf(Name, Length, "%s%s", MOCK_XATTR_UDA, Key) >= Length)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+int
+hpss_UserAttrSetAttrs(const char           * Path,
+                      hpss_userattr_list_t * Attr,
+                      const char           * Schema)
+{
+	int  i  = 0;
+	int  rc = 0;
+	char name[HPSS_MAX_PATH_NAME];
+	char local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_UserAttrSetAttrs", Path);
+	rc = mock_local_path(Path, local_path, sizeof(local_path));
+	if (rc)
+		return rc;
+
+	for (i = 0; i < Attr->len; i++)
+	{
+		rc = mock_uda_name(Attr->Pair[i].Key, name, sizeof(name));
+		if (rc)
+			return rc;
+
+		if (setxattr(local_path, name, Attr->Pair[i].Value, strlen(Attr->Pair[i].Value), 0))
+			return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Each Value must be HPSS_XML_SIZE bytes. Values come back as an XML
+ * document whose root element is the last component of the key, ie
+ * <state>Valid</state>; keys that are not set come back empty. Returns
+ * -ENOENT if none of the keys are set.
+ */
+int
+hpss_UserAttrGetAttrs(const char           * Path,
+                      hpss_userattr_list_t * Attr,
+                      int                    XMLFlag)
+{
+	int          i      = 0;
+	int          rc     = 0;
+	int          found  = 0;
+	ssize_t      length = 0;
+	const char * tag    = NULL;
+	char         name[HPSS_MAX_PATH_NAME];
+	char         value[HPSS_XML_SIZE];
+	char         local_path[HPSS_MAX_PATH_NAME * 2];
+
+	MOCK_REPLAY("hpss_UserAttrGetAttrs", Path);
+	rc = mock_local_path(Path, local_path, sizeof(local_path));
+	if (rc)
+		return rc;
+
+	for (i = 0; i < Attr->len; i++)
+	{
+		Attr->Pair[i].Value[0] = '\0';
+
+		rc = mock_uda_name(Attr->Pair[i].Key, name, sizeof(name));
+		if (rc)
+			return rc;
+
+		length = getxattr(local_path, name, value, sizeof(value) - 1);
+		if (length == -1)
+		{
+			if (errno == ENODATA)
+				continue;
+			return -errno;
+		}
+		value[length] = '\0';
+		found++;
+
+		tag = strrchr(Attr->Pair[i].Key, '/');
+		tag = tag ? tag + 1 : Attr->Pair[i].Key;
+
+		/* HPSS caps values at HPSS_XML_SIZE as well. */
+		if (snprintf(Attr->Pair[i].Value,
+		             HPSS_XML_SIZE,
+		             "%s<%s>%s</%s>",
+		             MOCK_XML_HEADER,
+		             tag,
+		             value,
+		             tag) >= HPSS_XML_SIZE)
+			return -ERANGE;
+	}
+
+	return found ? 0 : -ENOENT;
+}
+
+char *
+hpss_ChompXMLHeader(const char * XML, char * Element)
+{
+	const char * start = NULL;
+	const char * end   = NULL;
+
+	if (strncmp(XML, MOCK_XML_HEADER, strlen(MOCK_XML_HEADER)) == 0)
+		XML += strlen(MOCK_XML_HEADER);
+
+	start = strchr(XML, '>');
+	end   = strrchr(XML, '<');
+	if (XML[0] != '<' || !start || !end || end <= start)
+		return NULL;
+
+	return strndup(start + 1, end - start - 1);
+}
+
+static void *
+mock_stage_thread(void * Arg)
+{
+	mock_stage(Arg);
+	free(Arg);
+	return NULL;
+}
+
+/* The stage runs in the background; CallBackPtr is never called. */
+int
+hpss_StageCallBack(const char   * Path,
+                   u_signed64     Offset,
+                   u_signed64     Length,
+                   unsigned32     StorageLevel,
+                   void         * CallBackPtr,
+                   unsigned32     Flags,
+                   hpss_reqid_t * ReqID,
+                   hpssoid_t    * BitfileID)
+{
+	static unsigned32 next_reqid = 1;
+
+	int             rc         = 0;
+	char          * local_path = NULL;
+	struct stat     local;
+	pthread_t       thread;
+	pthread_attr_t  attr;
+
+	MOCK_REPLAY("hpss_StageCallBack", Path);
+
+	local_path = malloc(HPSS_MAX_PATH_NAME * 2);
+	if (!local_path)
+		return -ENOMEM;
+
+	rc = mock_local_path(Path, local_path, HPSS_MAX_PATH_NAME * 2);
+	if (!rc && stat(local_path, &local))
+		rc = -errno;
+	if (rc)
+	{
+		free(local_path);
+		return rc;
+	}
+
+	BitfileID->Device = local.st_dev;
+	BitfileID->Inode  = local.st_ino;
+	*ReqID = __sync_fetch_and_add(&next_reqid, 1);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	rc = pthread_create(&thread, &attr, mock_stage_thread, local_path);
+	pthread_attr_destroy(&attr);
+	if (rc)
+	{
+		free(local_path);
+		return -rc;
+	}
+	return 0;
+}
@@ -0,0 +1,473 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_MOCK_HPSS_API_H
+#define HPSS_MOCK_HPSS_API_H
+
+/*
+ * Stand-in for the HPSS client API, backed by a local directory tree. See
+ * source/mock/README for how it is configured. Only the calls, types and
+ * fields the DSI uses are provided; layouts do not match the real library.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <utime.h>
+
+/*
+ * Local includes
+ */
+#include "u_signed64.h"
+#include "ns_ObjHandle.h"
+#include "hpss_stat.h"
+#include "hpss_errno.h"
+#include "hpss_mech.h"
+#include "hpss_xml.h"
+#include "hpss_Getenv.h"
+
+#define HPSS_MAX_STORAGE_LEVELS 5
+#define HPSS_PV_NAME_SIZE       32
+
+/*
+ * Name space.
+ */
+#define NS_PERMS_RD 4
+#define NS_PERMS_WR 2
+#define NS_PERMS_XS 1
+
+enum {
+	NS_OBJECT_TYPE_FILE = 1,
+	NS_OBJECT_TYPE_DIRECTORY,
+	NS_OBJECT_TYPE_SYM_LINK,
+	NS_OBJECT_TYPE_HARD_LINK,
+	NS_OBJECT_TYPE_JUNCTION,
+	NS_OBJECT_TYPE_FILESET_ROOT,
+};
+
+typedef struct {
+	u_signed64 FilesetId;
+	u_signed64 DataLength;
+	hpssoid_t  BitfileId;
+	unsigned32 Type;
+	unsigned32 UserPerms;
+	unsigned32 GroupPerms;
+	unsigned32 OtherPerms;
+	unsigned32 ModePerms; // setuid, setgid, sticky
+	unsigned32 LinkCount;
+	unsigned32 UID;
+	unsigned32 GID;
+	unsigned32 COSId;
+	signed32   TimeLastRead;
+	signed32   TimeLastWritten;
+	signed32   TimeCreated;
+	signed32   TimeModified;
+} hpss_Attrs_t;
+
+typedef struct {
+	ns_ObjHandle_t ObjectHandle;
+	hpss_Attrs_t   Attrs;
+} hpss_fileattr_t;
+
+typedef struct {
+	ns_ObjHandle_t ObjHandle;
+	hpss_Attrs_t   Attrs;
+	char           Name[HPSS_MAX_FILE_NAME];
+} ns_DirEntry_t;
+
+typedef u_signed64 ns_FilesetAttrBits_t;
+#define NS_FS_ATTRINDEX_COS 3
+
+typedef struct {
+	unsigned32 ClassOfService; // Non zero if the fileset forces a COS
+} ns_FilesetAttrs_t;
+
+typedef struct {
+	char Name[HPSS_PV_NAME_SIZE];
+} pv_list_element_t;
+
+typedef struct {
+	unsigned32        Length;
+	pv_list_element_t List[1];
+} pv_list_t;
+
+typedef struct {
+	pv_list_t  * PVList;  // malloc'ed; the caller frees it
+	u_signed64   BytesOnVV;
+} vv_attrib_t;
+
+/*
+ * Storage levels. The mock gives every regular file a disk level and a
+ * tape level (see hpss_FileGetXAttributes()).
+ */
+#define BFS_BFATTRS_LEVEL_IS_DISK     0x1
+#define BFS_BFATTRS_LEVEL_IS_TAPE     0x2
+#define BFS_MAX_VV_TO_RETURN_AT_LEVEL 4
+
+typedef struct {
+	unsigned32  Flags;
+	u_signed64  BytesAtLevel;
+	unsigned32  NumberOfVVs;
+	vv_attrib_t VVAttrib[BFS_MAX_VV_TO_RETURN_AT_LEVEL];
+} bf_sc_attrib_t;
+
+typedef struct {
+	hpss_Attrs_t   Attrs;
+	bf_sc_attrib_t SCAttrib[HPSS_MAX_STORAGE_LEVELS];
+} hpss_xfileattr_t;
+
+#define API_GET_STATS_FOR_LEVEL      0x1
+#define API_GET_STATS_FOR_ALL_LEVELS 0x2
+#define API_GET_XATTRS_NO_BLOCK      0x4
+
+/*
+ * Class of service.
+ */
+#define NO_PRIORITY             0
+#define LOWEST_PRIORITY         1
+#define LOW_PRIORITY            2
+#define DESIRED_PRIORITY        3
+#define HIGHLY_DESIRED_PRIORITY 4
+#define REQUIRED_PRIORITY       5
+
+typedef struct {
+	u_signed64 MinFileSize;
+	u_signed64 MaxFileSize;
+	unsigned32 COSId;
+	unsigned32 StripeWidth;
+} hpss_cos_hints_t;
+
+typedef struct {
+	unsigned32 COSIdPriority;
+	unsigned32 MinFileSizePriority;
+	unsigned32 MaxFileSizePriority;
+	unsigned32 StripeWidthPriority;
+} hpss_cos_priorities_t;
+
+typedef struct {
+	unsigned32 COSId;
+} hpss_cos_md_t;
+
+/*
+ * Staging.
+ */
+typedef unsigned32 hpss_reqid_t;
+
+#define BFS_STAGE_ALL   0x1
+#define BFS_ASYNCH_CALL 0x2
+
+/*
+ * User defined attributes.
+ */
+typedef struct {
+	char * Key;
+	char * Value;
+} hpss_userattr_t;
+
+typedef struct {
+	signed32          len;
+	hpss_userattr_t * Pair;
+} hpss_userattr_list_t;
+
+#define UDA_API_VALUE 0x1
+#define UDA_API_XML   0x2
+
+/*
+ * Parallel I/O.
+ */
+typedef struct hpss_pio_grp_s * hpss_pio_grp_t;
+
+typedef enum {
+	HPSS_PIO_READ,
+	HPSS_PIO_WRITE,
+} hpss_pio_operation_t;
+
+#define HPSS_PIO_TCPIP      0
+#define HPSS_PIO_MVR_SELECT 1
+
+#define HPSS_PIO_HANDLE_GAP 0x1
+
+typedef struct {
+	hpss_pio_operation_t Operation;
+	unsigned32           ClntStripeWidth;
+	unsigned32           BlockSize;
+	unsigned32           FileStripeWidth;
+	unsigned32           IOTimeOutSecs;
+	unsigned32           Transport;
+	unsigned32           Options;
+} hpss_pio_params_t;
+
+/* Offset is relative to the offset given to hpss_PIOExecute(). */
+typedef struct {
+	u_signed64 Offset;
+	u_signed64 Length;
+} hpss_pio_gapinfo_t;
+
+typedef int
+(*hpss_pio_cb_t)(void       *  Arg,
+                 u_signed64    Offset,
+                 unsigned32 *  Length,
+                 void       ** Buffer);
+
+/*
+ * Client configuration and credentials.
+ */
+#define API_USE_CONFIG 0x1
+
+typedef struct {
+	unsigned32        Flags;
+	unsigned32        DebugValue;
+	char              DebugPath[HPSS_MAX_PATH_NAME];
+	hpss_authn_mech_t AuthnMech;
+} api_config_t;
+
+typedef struct {
+	char       Name[HPSS_MAX_FILE_NAME];
+	char       Directory[HPSS_MAX_PATH_NAME];
+	unsigned32 SecPWent_Uid;
+	unsigned32 SecPWent_Gid;
+} sec_cred_t;
+
+/*
+ * Files.
+ */
+int
+hpss_Open(const char                  * Path,
+          int                           Oflag,
+          mode_t                        Mode,
+          const hpss_cos_hints_t      * HintsIn,
+          const hpss_cos_priorities_t * HintsPri,
+          hpss_cos_hints_t            * HintsOut);
+
+int
+hpss_Close(int Fildes);
+
+int
+hpss_SetCOSByHints(int                           Fildes,
+                   unsigned32                    Flags,
+                   const hpss_cos_hints_t      * HintsPtr,
+                   const hpss_cos_priorities_t * PrioPtr,
+                   hpss_cos_md_t               * COSPtr);
+
+int
+hpss_Truncate(const char * Path, u_signed64 Length);
+
+/*
+ * Name space.
+ */
+int
+hpss_Stat(const char * Path, hpss_stat_t * Buf);
+
+int
+hpss_Lstat(const char * Path, hpss_stat_t * Buf);
+
+int
+hpss_FileGetAttributes(const char * Path, hpss_fileattr_t * AttrOut);
+
+int
+hpss_FileGetXAttributes(const char       * Path,
+                        unsigned32         Flags,
+                        unsigned32         StorageLevel,
+                        hpss_xfileattr_t * AttrOut);
+
+int
+hpss_FileGetXAttributesHandle(const ns_ObjHandle_t * ObjHandle,
+                              const char           * Path,
+                              const sec_cred_t     * Ucred,
+                              unsigned32             Flags,
+                              unsigned32             StorageLevel,
+                              hpss_xfileattr_t     * AttrOut);
+
+int
+hpss_FilesetGetAttributes(const char           * Name,
+                          const u_signed64     * FilesetId,
+                          const ns_ObjHandle_t * FilesetHandle,
+                          const void           * GatewayUUID,
+                          ns_FilesetAttrBits_t   FilesetAttrBits,
+                          ns_FilesetAttrs_t    * FilesetAttrs);
+
+/* Returns the number of entries read into DirentPtr. */
+int
+hpss_ReadAttrsHandle(const ns_ObjHandle_t * ObjHandle,
+                     u_signed64             OffsetIn,
+                     const sec_cred_t     * Ucred,
+                     unsigned32             BufferSize,
+                     unsigned32             GetAttributes,
+                     unsigned32           * End,
+                     u_signed64           * OffsetOut,
+                     ns_DirEntry_t        * DirentPtr);
+
+int
+hpss_Readlink(const char * Path, char * Contents, size_t BufferSize);
+
+int
+hpss_ReadlinkHandle(const ns_ObjHandle_t * ObjHandle,
+                    const char           * Path,
+                    char                 * Contents,
+                    size_t                 BufferSize,
+                    const sec_cred_t     * Ucred);
+
+int
+hpss_Mkdir(const char * Path, mode_t Mode);
+
+int
+hpss_Rmdir(const char * Path);
+
+int
+hpss_Unlink(const char * Path);
+
+int
+hpss_Rename(const char * Old, const char * New);
+
+int
+hpss_Symlink(const char * Contents, const char * Path);
+
+int
+hpss_Chmod(const char * Path, mode_t Mode);
+
+int
+hpss_Chown(const char * Path, uid_t Owner, gid_t Group);
+
+int
+hpss_Utime(const char * Path, const struct utimbuf * Times);
+
+mode_t
+hpss_Umask(mode_t CMask);
+
+/*
+ * User defined attributes.
+ */
+int
+hpss_UserAttrSetAttrs(const char           * Path,
+                      hpss_userattr_list_t * Attr,
+                      const char           * Schema);
+
+int
+hpss_UserAttrGetAttrs(const char           * Path,
+                      hpss_userattr_list_t * Attr,
+                      int                    XMLFlag);
+
+/*
+ * Staging.
+ */
+int
+hpss_StageCallBack(const char   * Path,
+                   u_signed64     Offset,
+                   u_signed64     Length,
+                   unsigned32     StorageLevel,
+                   void         * CallBackPtr,
+                   unsigned32     Flags,
+                   hpss_reqid_t * ReqID,
+                   hpssoid_t    * BitfileID);
+
+/*
+ * Parallel I/O.
+ */
+int
+hpss_PIOStart(hpss_pio_params_t * InputParams, hpss_pio_grp_t * StripeGroup);
+
+int
+hpss_PIOEnd(hpss_pio_grp_t StripeGroup);
+
+int
+hpss_PIOExportGrp(hpss_pio_grp_t    StripeGroup,
+                  void           ** Buffer,
+                  unsigned int    * BufLength);
+
+int
+hpss_PIOImportGrp(const void     * Buffer,
+                  unsigned int     BufLength,
+                  hpss_pio_grp_t * StripeGroup);
+
+int
+hpss_PIORegister(unsigned32       StripeElement,
+                 void           * DataNetSockAddr,
+                 void           * DataBuffer,
+                 unsigned32       DataBufLen,
+                 hpss_pio_grp_t   StripeGroup,
+                 hpss_pio_cb_t    IOCallback,
+                 void           * IOCallbackArg);
+
+int
+hpss_PIOExecute(int                  Fd,
+                u_signed64           FileOffset,
+                u_signed64           Size,
+                hpss_pio_grp_t       StripeGroup,
+                hpss_pio_gapinfo_t * GapInfo,
+                u_signed64         * BytesMoved);
+
+/*
+ * Client configuration and credentials.
+ */
+int
+hpss_GetConfiguration(api_config_t * ConfigOut);
+
+int
+hpss_SetConfiguration(const api_config_t * ConfigIn);
+
+int
+hpss_AuthnMechTypeFromString(const char * AuthnMechString, hpss_authn_mech_t * AuthnMech);
+
+int
+hpss_ParseAuthString(char                 * AuthString,
+                     hpss_authn_mech_t    * Mechanism,
+                     hpss_rpc_auth_type_t * AuthType,
+                     void                ** Authenticator);
+
+int
+hpss_SetLoginCred(char                 * PrincipalName,
+                  hpss_authn_mech_t      Mechanism,
+                  hpss_rpc_cred_type_t   CredType,
+                  hpss_rpc_auth_type_t   AuthType,
+                  void                 * Authenticator);
+
+int
+hpss_PurgeLoginCred(void);
+
+int
+hpss_GetThreadUcred(sec_cred_t * RetUcred);
+
+int
+hpss_LoadDefaultThreadState(uid_t UserID, mode_t Umask, char * ClientFullName);
+
+#endif /* HPSS_MOCK_HPSS_API_H */
@@ -0,0 +1,66 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_MOCK_HPSS_MECH_H
+#define HPSS_MOCK_HPSS_MECH_H
+
+typedef enum {
+	hpss_authn_mech_invalid = 0,
+	hpss_authn_mech_krb5,
+	hpss_authn_mech_unix,
+	hpss_authn_mech_gsi,
+} hpss_authn_mech_t;
+
+typedef enum {
+	hpss_rpc_auth_type_invalid = 0,
+	hpss_rpc_auth_type_none,
+	hpss_rpc_auth_type_keytab,
+	hpss_rpc_auth_type_keyfile,
+	hpss_rpc_auth_type_key,
+	hpss_rpc_auth_type_passwd,
+} hpss_rpc_auth_type_t;
+
+typedef enum {
+	hpss_rpc_cred_server = 1,
+	hpss_rpc_cred_client,
+	hpss_rpc_cred_both,
+} hpss_rpc_cred_type_t;
+
+#endif /* HPSS_MOCK_HPSS_MECH_H */
@@ -0,0 +1,74 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_MOCK_U_SIGNED64_H
+#define HPSS_MOCK_U_SIGNED64_H
+
+/*
+ * Stand-in for the HPSS client headers; see source/mock/README. Only what
+ * the DSI uses is provided.
+ */
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+typedef uint64_t u_signed64;
+typedef uint32_t unsigned32;
+typedef int32_t  signed32;
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+#define cast64m(a)        ((u_signed64)(a))
+#define cast32m(a)        ((unsigned32)(a))
+#define eqz64m(a)         ((a) == 0)
+#define neqz64m(a)        ((a) != 0)
+#define gt64(a,b)         ((a) > (b))
+#define add64m(a,b)       ((a) + (b))
+#define orbit64m(a,b)     ((u_signed64)(a) | ((u_signed64)1 << (b)))
+
+#define CONVERT_U64_TO_LONGLONG(a,b) ((b) = (a))
+#define CONVERT_LONGLONG_TO_U64(a,b) ((b) = (a))
+
+#endif /* HPSS_MOCK_U_SIGNED64_H */
@@ -0,0 +1,546 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * hpss_dsi_listbench measures the DSI's directory listing path, dsi_stat()
+ * through stat_directory_entries() and stat_translate_dir_entry() to the
+ * server's partial stat replies, against synthetic directories of any size.
+ *
+ * The HPSS calls the listing path makes (hpss_Lstat(), hpss_Stat(),
+ * hpss_FileGetAttributes(), hpss_ReadAttrsHandle() and hpss_ReadlinkHandle())
+ * are answered by the functions below, which take precedence over the HPSS
+ * library because this program exports them (-rdynamic). Entries are made up
+ * as they are read, a mix of files, directories and symlinks in the ratio
+ * given by -m, so a directory of 10M entries costs no memory of its own.
+ *
+ * For each directory size it reports:
+ *   entries/s      entries listed per second of wall time
+ *   dsi entries/s  the same, less the time spent making up entries
+ *   allocs/entry   malloc(), calloc() and realloc() calls per entry
+ *   peak RSS       high water mark of the process during the listing
+ *
+ * The entries are laid out by the HPSS headers this program is built with,
+ * so the DSI must be built against the same ones (ie the mock's).
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <time.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+
+#define LIST_DEFAULT_DSI  "libglobus_gridftp_server_hpss_real.so"
+#define LIST_DSI_IFACE    "hpss_local_dsi_iface"
+#define LIST_PATH         "/hpss_dsi_listbench"
+#define LIST_MAX_SIZES    16
+
+static struct {
+	/* Options */
+	char          * Library;
+	uint64_t        Sizes[LIST_MAX_SIZES];
+	int             SizeCount;
+	int             FileWeight;
+	int             DirWeight;
+	int             LinkWeight;
+
+	/* Current run */
+	uint64_t        Entries;     // In the synthetic directory
+	uint64_t        Replied;     // Entries handed to the server
+	uint64_t        Types[3];    // Replied files, directories and symlinks
+	uint64_t        HPSSTime;    // nsecs spent in the synthetic calls
+	int             Finished;
+	globus_result_t Result;
+
+	/* Allocation counting */
+	int             Counting;
+	uint64_t        Allocs;
+} list = {
+	.Library    = LIST_DEFAULT_DSI,
+	.FileWeight = 90,
+	.DirWeight  = 8,
+	.LinkWeight = 2,
+};
+
+static uint64_t
+list_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Allocation counting. These replace the C library's entry points for the
+ * whole process, the DSI and Globus included.
+ */
+
+extern void * __libc_malloc(size_t);
+extern void * __libc_calloc(size_t, size_t);
+extern void * __libc_realloc(void *, size_t);
+extern void   __libc_free(void *);
+
+void *
+malloc(size_t Size)
+{
+	if (list.Counting)
+		__sync_fetch_and_add(&list.Allocs, 1);
+	return __libc_malloc(Size);
+}
+
+void *
+calloc(size_t Count, size_t Size)
+{
+	if (list.Counting)
+		__sync_fetch_and_add(&list.Allocs, 1);
+	return __libc_calloc(Count, Size);
+}
+
+void *
+realloc(void * Ptr, size_t Size)
+{
+	if (list.Counting)
+		__sync_fetch_and_add(&list.Allocs, 1);
+	return __libc_realloc(Ptr, Size);
+}
+
+void
+free(void * Ptr)
+{
+	__libc_free(Ptr);
+}
+
+/*
+ * The synthetic directory.
+ */
+
+/* 0 = file, 1 = directory, 2 = symlink, spread evenly through the directory. */
+static int
+list_entry_type(uint64_t Index)
+{
+	int total  = list.FileWeight + list.DirWeight + list.LinkWeight;
+	int bucket = (Index * 37) % total;
+
+	if (bucket < list.FileWeight)
+		return 0;
+	if (bucket < list.FileWeight + list.DirWeight)
+		return 1;
+	return 2;
+}
+
+static void
+list_make_attrs(hpss_Attrs_t * Attrs, int Type, uint64_t Index)
+{
+	static const unsigned32 types[] = {
+		NS_OBJECT_TYPE_FILE,
+		NS_OBJECT_TYPE_DIRECTORY,
+		NS_OBJECT_TYPE_SYM_LINK,
+	};
+
+	memset(Attrs, 0, sizeof(hpss_Attrs_t));
+	Attrs->Type            = types[Type];
+	Attrs->UserPerms       = NS_PERMS_RD|NS_PERMS_WR|(Type ? NS_PERMS_XS : 0);
+	Attrs->GroupPerms      = NS_PERMS_RD|(Type ? NS_PERMS_XS : 0);
+	Attrs->OtherPerms      = NS_PERMS_RD|(Type ? NS_PERMS_XS : 0);
+	Attrs->LinkCount       = (Type == 1) ? 2 : 1;
+	Attrs->UID             = getuid();
+	Attrs->GID             = getgid();
+	Attrs->DataLength      = (Type == 0) ? (Index * 4099) % (1ULL << 34) : 512;
+	Attrs->TimeLastRead    = 1500000000 + Index;
+	Attrs->TimeLastWritten = 1500000000 + Index;
+	Attrs->TimeCreated     = 1500000000;
+	Attrs->TimeModified    = 1500000000 + Index;
+}
+
+static void
+list_make_stat(hpss_stat_t * Buf)
+{
+	memset(Buf, 0, sizeof(hpss_stat_t));
+	Buf->st_mode  = S_IFDIR|0755;
+	Buf->st_nlink = 2;
+	Buf->st_uid   = getuid();
+	Buf->st_gid   = getgid();
+	Buf->st_size  = 512;
+}
+
+int
+hpss_Stat(const char * Path, hpss_stat_t * Buf)
+{
+	list_make_stat(Buf);
+	return 0;
+}
+
+int
+hpss_Lstat(const char * Path, hpss_stat_t * Buf)
+{
+	list_make_stat(Buf);
+	return 0;
+}
+
+int
+hpss_FileGetAttributes(const char * Path, hpss_fileattr_t * AttrOut)
+{
+	memset(AttrOut, 0, sizeof(hpss_fileattr_t));
+	list_make_attrs(&AttrOut->Attrs, 1, 0);
+	return 0;
+}
+
+int
+hpss_ReadAttrsHandle(const ns_ObjHandle_t * ObjHandle,
+                     u_signed64             OffsetIn,
+                     const sec_cred_t     * Ucred,
+                     unsigned32             BufferSize,
+                     unsigned32             GetAttributes,
+                     unsigned32           * End,
+                     u_signed64           * OffsetOut,
+                     ns_DirEntry_t        * DirentPtr)
+{
+	uint64_t start     = list_now();
+	uint64_t index     = OffsetIn;
+	int      count     = 0;
+	int      max_count = BufferSize / sizeof(ns_DirEntry_t);
+
+	for (; count < max_count && index < list.Entries; count++, index++)
+	{
+		memset(&DirentPtr[count].ObjHandle, 0, sizeof(ns_ObjHandle_t));
+		snprintf(DirentPtr[count].Name, sizeof(DirentPtr[count].Name), "entry.%010"PRIu64, index);
+		list_make_attrs(&DirentPtr[count].Attrs, list_entry_type(index), index);
+	}
+
+	*End       = (index == list.Entries);
+	*OffsetOut = index;
+
+	list.HPSSTime += list_now() - start;
+	return count;
+}
+
+int
+hpss_ReadlinkHandle(const ns_ObjHandle_t * ObjHandle,
+                    const char           * Path,
+                    char                 * Contents,
+                    size_t                 BufferSize,
+                    const sec_cred_t     * Ucred)
+{
+	uint64_t start = list_now();
+	int      length;
+
+	length = snprintf(Contents, BufferSize, "../target/%s", Path);
+
+	list.HPSSTime += list_now() - start;
+	return length;
+}
+
+/*
+ * The server side of the DSI interface.
+ */
+
+void
+globus_gfs_log_message(globus_gfs_log_type_t Type, const char * Format, ...)
+{
+}
+
+void
+globus_gridftp_server_finished_stat_partial(globus_gfs_operation_t   Operation,
+                                            globus_result_t          Result,
+                                            globus_gfs_stat_t      * StatArray,
+                                            int                      StatCount)
+{
+	int i;
+
+	/* Look at each entry the way the server does to build its reply. */
+	for (i = 0; i < StatCount; i++)
+	{
+		if (S_ISDIR(StatArray[i].mode))
+			list.Types[1]++;
+		else if (S_ISLNK(StatArray[i].mode) && StatArray[i].symlink_target)
+			list.Types[2]++;
+		else if (S_ISREG(StatArray[i].mode) && StatArray[i].name[0])
+			list.Types[0]++;
+	}
+	list.Replied += StatCount;
+}
+
+void
+globus_gridftp_server_finished_stat(globus_gfs_operation_t   Operation,
+                                    globus_result_t          Result,
+                                    globus_gfs_stat_t      * StatArray,
+                                    int                      StatCount)
+{
+	list.Result   = Result;
+	list.Finished = 1;
+}
+
+/*
+ * Driver.
+ */
+
+/* Resets the high water mark of the process' RSS; 0 on success. */
+static int
+list_reset_peak_rss()
+{
+	int fd  = open("/proc/self/clear_refs", O_WRONLY);
+	int bad = 1;
+
+	if (fd != -1)
+	{
+		bad = (write(fd, "5", 1) != 1);
+		close(fd);
+	}
+	return bad;
+}
+
+/* VmHWM in kB. */
+static uint64_t
+list_peak_rss()
+{
+	char     line[256];
+	uint64_t peak = 0;
+	FILE   * file = fopen("/proc/self/status", "r");
+
+	if (!file)
+		return 0;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "VmHWM: %"SCNu64, &peak) == 1)
+			break;
+	}
+	fclose(file);
+	return peak;
+}
+
+static int
+list_run(globus_gfs_storage_iface_t * Iface, uint64_t Entries, int PeakReset)
+{
+	uint64_t               wall  = 0;
+	uint64_t               dsi   = 0;
+	uint64_t               allocs;
+	globus_gfs_stat_info_t stat_info;
+
+	memset(&stat_info, 0, sizeof(stat_info));
+	stat_info.pathname = LIST_PATH;
+
+	list.Entries  = Entries;
+	list.Replied  = 0;
+	list.HPSSTime = 0;
+	list.Finished = 0;
+	list.Result   = GLOBUS_SUCCESS;
+	memset(list.Types, 0, sizeof(list.Types));
+
+	if (PeakReset)
+		list_reset_peak_rss();
+
+	list.Allocs   = 0;
+	list.Counting = 1;
+	wall = list_now();
+
+	/* dsi_stat() replies before it returns. */
+	Iface->stat_func((globus_gfs_operation_t)&list, &stat_info, NULL);
+
+	wall = list_now() - wall;
+	list.Counting = 0;
+	allocs = list.Allocs;
+	dsi    = wall > list.HPSSTime ? wall - list.HPSSTime : 1;
+
+	if (!list.Finished || list.Result || list.Replied != Entries)
+	{
+		fprintf(stderr, "Listing %"PRIu64" entries failed after %"PRIu64"\n", Entries, list.Replied);
+		return 1;
+	}
+
+	printf("%9"PRIu64" %9"PRIu64" %8"PRIu64" %8"PRIu64" %8.3f %12.0f %12.0f %8.2f %10.1f\n",
+	       Entries,
+	       list.Types[0],
+	       list.Types[1],
+	       list.Types[2],
+	       wall / 1e9,
+	       Entries * 1e9 / wall,
+	       Entries * 1e9 / dsi,
+	       (double)allocs / Entries,
+	       list_peak_rss() / 1024.0);
+	fflush(stdout);
+	return 0;
+}
+
+static uint64_t
+list_parse_count(const char * Value)
+{
+	char   * end   = NULL;
+	uint64_t count = strtoull(Value, &end, 0);
+
+	switch (*end)
+	{
+	case 'g': case 'G': count *= 1000;
+	case 'm': case 'M': count *= 1000;
+	case 'k': case 'K': count *= 1000;
+	}
+	return count;
+}
+
+static int
+list_parse_sizes(char * Value)
+{
+	char * value   = NULL;
+	char * saveptr = NULL;
+
+	list.SizeCount = 0;
+	for (value = strtok_r(Value, ",", &saveptr); value; value = strtok_r(NULL, ",", &saveptr))
+	{
+		if (list.SizeCount == LIST_MAX_SIZES)
+			return 1;
+		list.Sizes[list.SizeCount] = list_parse_count(value);
+		if (list.Sizes[list.SizeCount] == 0)
+			return 1;
+		list.SizeCount++;
+	}
+	return list.SizeCount == 0;
+}
+
+static void
+list_usage(const char * Program)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  -L <library>   DSI library (default %s)\n"
+	        "  -n <sizes>     Entries per directory, comma separated, k/m suffixes\n"
+	        "                 are powers of 1000 (default 1k,10k,100k,1m,10m)\n"
+	        "  -m <f:d:l>     Ratio of files, directories and symlinks (default 90:8:2)\n",
+	        Program,
+	        LIST_DEFAULT_DSI);
+}
+
+int
+main(int argc, char * argv[])
+{
+	int                          opt;
+	int                          i;
+	int                          peak_reset = 0;
+	int                          retval     = 1;
+	void                       * handle     = NULL;
+	globus_gfs_storage_iface_t * iface      = NULL;
+	char                         default_sizes[] = "1k,10k,100k,1m,10m";
+
+	list_parse_sizes(default_sizes);
+
+	while ((opt = getopt(argc, argv, "L:n:m:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'L': list.Library = optarg; break;
+		case 'n':
+			if (list_parse_sizes(optarg))
+			{
+				list_usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'm':
+			if (sscanf(optarg, "%d:%d:%d", &list.FileWeight, &list.DirWeight, &list.LinkWeight) != 3 ||
+			    list.FileWeight < 0 || list.DirWeight < 0 || list.LinkWeight < 0 ||
+			    list.FileWeight + list.DirWeight + list.LinkWeight == 0)
+			{
+				list_usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			list_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (globus_module_activate(GLOBUS_COMMON_MODULE) != GLOBUS_SUCCESS)
+	{
+		fprintf(stderr, "Unable to activate globus_common\n");
+		return 1;
+	}
+
+	/* No RTLD_DEEPBIND; the DSI must bind to our HPSS and server functions. */
+	handle = dlopen(list.Library, RTLD_NOW|RTLD_GLOBAL);
+	if (!handle)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		goto cleanup;
+	}
+
+	iface = dlsym(handle, LIST_DSI_IFACE);
+	if (!iface)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		goto cleanup;
+	}
+
+	peak_reset = !list_reset_peak_rss();
+	if (!peak_reset)
+		fprintf(stderr, "Unable to reset the peak RSS; it covers the whole run\n");
+
+	printf("%9s %9s %8s %8s %8s %12s %12s %8s %10s\n",
+	       "entries", "files", "dirs", "links", "secs",
+	       "entries/s", "dsi ent/s", "allocs", "peak MB");
+
+	for (i = 0; i < list.SizeCount; i++)
+	{
+		if (list_run(iface, list.Sizes[i], peak_reset))
+			goto cleanup;
+	}
+
+	retval = 0;
+
+cleanup:
+	globus_module_deactivate(GLOBUS_COMMON_MODULE);
+	return retval;
+}
@@ -0,0 +1,808 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * hpss_dsi_microbench measures the DSI's transfer buffer management on its
+ * own: the STOR path that reassembles GridFTP buffers into PIO blocks
+ * (stor_collect_buffers(), stor_copy_out_buffers(), stor_launch_gridftp_reads())
+ * and the RETR path that recycles buffers from PIO to GridFTP
+ * (retr_get_free_buffer() and the free list).
+ *
+ * No HPSS calls are made. A thread stands in for the PIO thread and calls
+ * the DSI's PIO callouts block after block while a pool of network threads
+ * stands in for GridFTP, completing the reads and writes the DSI registers.
+ * A network thread takes up to -w requests at once and completes them
+ * newest first, so STOR sees buffers arrive out of order. As with the
+ * server, STOR's EOF is only delivered once all of the data has been.
+ *
+ * The callouts are looked up in the DSI library, which is loaded the same
+ * way hpss_dsi_bench loads it. Each combination of block size, OptConnCnt,
+ * network threads and reorder window is run once for STOR and once for
+ * RETR and reports:
+ *   ns/blk      wall time per GridFTP block
+ *   pio ns/blk  CPU time of the PIO thread per block, which is the DSI's
+ *               inner loop including the copy between buffers
+ *   net ns/blk  CPU time of the network threads per block
+ *   sleeps      per 1000 blocks, times the PIO thread blocked waiting for
+ *               GridFTP to hand back a buffer
+ *   wakeups     per 1000 blocks, times a network thread had to wake it
+ *   buffers     buffers the DSI allocated
+ *
+ * -H, -N and -p set BufferHugePages, BufferNUMANode and PinPIOThreads for
+ * the run; buffers then come from the DSI's allocator and the PIO loop is
+ * pinned like the PIO thread. Run with and without them to compare.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <dlfcn.h>
+#include <time.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "stor.h"
+#include "retr.h"
+
+#define MICRO_DEFAULT_DSI    "libglobus_gridftp_server_hpss_real.so"
+#define MICRO_MAX_THREADS    64
+#define MICRO_MAX_VALUES     16
+
+typedef int  (*micro_pio_callout_t)(char *, uint32_t *, uint64_t, void *);
+typedef void (*micro_stor_wait_t)(stor_info_t *);
+typedef void (*micro_retr_wait_t)(retr_info_t *);
+typedef void (*micro_handoff_destroy_t)(handoff_t *);
+typedef void (*micro_placement_init_t)(config_t *);
+typedef void (*micro_pin_thread_t)();
+typedef char * (*micro_get_buffer_t)(globus_size_t);
+typedef void (*micro_free_buffer_t)(char *, globus_size_t);
+
+/* A read or write the DSI registered with the data channel. */
+typedef struct micro_request {
+	struct micro_request            * Next;
+	globus_byte_t                   * Buffer;
+	globus_size_t                     Length;
+	globus_gridftp_server_read_cb_t   ReadCallback;  // NULL for writes
+	globus_gridftp_server_write_cb_t  WriteCallback;
+	void                            * Arg;
+
+	/* Filled in by the network thread for reads. */
+	globus_off_t                      Offset;
+	globus_bool_t                     Eof;
+} micro_request_t;
+
+/* A list of values to sweep. */
+typedef struct {
+	uint64_t Values[MICRO_MAX_VALUES];
+	int      Count;
+} micro_sweep_t;
+
+static struct {
+	/* Options */
+	char          * Library;
+	uint64_t        Size;
+	uint64_t        PIOBlockSize;  // 0 = the GridFTP block size
+	micro_sweep_t   BlockSizes;
+	micro_sweep_t   Conns;
+	micro_sweep_t   NetThreads;
+	micro_sweep_t   Windows;
+	config_t        Config;        // Placement options only
+
+	/* DSI */
+	micro_pio_callout_t     StorPIOCallout;
+	micro_pio_callout_t     RetrPIOCallout;
+	micro_stor_wait_t       StorWait;
+	micro_retr_wait_t       RetrWait;
+	micro_handoff_destroy_t HandoffDestroy; // NULL if the DSI predates it
+	micro_get_buffer_t      GetBuffer;      // NULL if the DSI predates its allocator
+	micro_free_buffer_t     FreeBuffer;
+
+	/* Current run */
+	int             OptConnCnt;
+	int             Window;
+	uint64_t        RecvOffset;    // STOR data handed out so far
+	uint64_t        RecvDone;      // STOR data delivered so far
+	micro_request_t * Parked;      // STOR EOFs waiting on RecvDone
+	uint64_t        NetCPU;        // nsecs, summed across network threads
+
+	/* Network threads */
+	pthread_mutex_t   Lock;
+	pthread_cond_t    Cond;
+	micro_request_t * Head;
+	micro_request_t * Tail;
+	int               Active;      // Threads serving the current run
+	int               Shutdown;
+	pthread_t         Threads[MICRO_MAX_THREADS];
+} micro = {
+	.Library      = MICRO_DEFAULT_DSI,
+	.Size         = 256*1024*1024,
+	.Lock         = PTHREAD_MUTEX_INITIALIZER,
+	.Cond         = PTHREAD_COND_INITIALIZER,
+	.Config       = { .BufferNUMANode = -1 },
+};
+
+static uint64_t
+micro_now(clockid_t Clock)
+{
+	struct timespec ts;
+	clock_gettime(Clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *
+micro_get_buffer(globus_size_t Size)
+{
+	if (micro.GetBuffer)
+		return micro.GetBuffer(Size);
+	return calloc(1, Size);
+}
+
+static void
+micro_free_buffer(char * Buffer, globus_size_t Size)
+{
+	if (micro.FreeBuffer)
+		micro.FreeBuffer(Buffer, Size);
+	else
+		free(Buffer);
+}
+
+/*
+ * Network threads.
+ */
+
+static void
+micro_complete(micro_request_t * Request)
+{
+	if (Request->ReadCallback)
+		Request->ReadCallback(NULL,
+		                      GLOBUS_SUCCESS,
+		                      Request->Buffer,
+		                      Request->Length,
+		                      Request->Offset,
+		                      Request->Eof,
+		                      Request->Arg);
+	else
+		Request->WriteCallback(NULL,
+		                       GLOBUS_SUCCESS,
+		                       Request->Buffer,
+		                       Request->Length,
+		                       Request->Arg);
+	free(Request);
+}
+
+/* Call locked. Takes what is waiting, up to the window, without waiting for more. */
+static int
+micro_take_batch(micro_request_t ** Batch)
+{
+	int               count   = 0;
+	micro_request_t * request = NULL;
+
+	while (count < micro.Window && micro.Head)
+	{
+		request    = micro.Head;
+		micro.Head = request->Next;
+		if (!micro.Head)
+			micro.Tail = NULL;
+
+		/* STOR data arrives in the order it was taken off the queue. */
+		if (request->ReadCallback)
+		{
+			if (request->Length > micro.Size - micro.RecvOffset)
+				request->Length = micro.Size - micro.RecvOffset;
+			request->Offset   = micro.RecvOffset;
+			request->Eof      = (request->Length == 0);
+			micro.RecvOffset += request->Length;
+
+			if (request->Eof && micro.RecvDone < micro.Size)
+			{
+				request->Next = micro.Parked;
+				micro.Parked  = request;
+				continue;
+			}
+		}
+		Batch[count++] = request;
+	}
+	return count;
+}
+
+static void *
+micro_net_thread(void * Arg)
+{
+	int               index = (intptr_t)Arg;
+	int               count = 0;
+	uint64_t          bytes = 0;
+	uint64_t          start = 0;
+	micro_request_t * batch[MICRO_MAX_THREADS];
+	micro_request_t * parked = NULL;
+	micro_request_t * next   = NULL;
+
+	pthread_mutex_lock(&micro.Lock);
+	while (1)
+	{
+		while (!micro.Shutdown && (index >= micro.Active || !micro.Head))
+			pthread_cond_wait(&micro.Cond, &micro.Lock);
+		if (micro.Shutdown)
+			break;
+
+		count = micro_take_batch(batch);
+		pthread_mutex_unlock(&micro.Lock);
+
+		start = micro_now(CLOCK_THREAD_CPUTIME_ID);
+		for (bytes = 0; count--; )
+		{
+			if (batch[count]->ReadCallback)
+				bytes += batch[count]->Length;
+			micro_complete(batch[count]);
+		}
+		__sync_fetch_and_add(&micro.NetCPU, micro_now(CLOCK_THREAD_CPUTIME_ID) - start);
+
+		pthread_mutex_lock(&micro.Lock);
+		micro.RecvDone += bytes;
+		if (bytes && micro.RecvDone == micro.Size)
+		{
+			parked       = micro.Parked;
+			micro.Parked = NULL;
+			pthread_mutex_unlock(&micro.Lock);
+
+			for (; parked; parked = next)
+			{
+				next = parked->Next;
+				micro_complete(parked);
+			}
+
+			pthread_mutex_lock(&micro.Lock);
+		}
+	}
+	pthread_mutex_unlock(&micro.Lock);
+	return NULL;
+}
+
+static globus_result_t
+micro_queue(globus_byte_t * Buffer,
+            globus_size_t   Length,
+            void          * ReadCallback,
+            void          * WriteCallback,
+            void          * Arg)
+{
+	micro_request_t * request = calloc(1, sizeof(micro_request_t));
+
+	if (!request)
+		return globus_error_put(globus_error_construct_string(NULL, NULL, "out of memory"));
+
+	request->Buffer        = Buffer;
+	request->Length        = Length;
+	request->ReadCallback  = ReadCallback;
+	request->WriteCallback = WriteCallback;
+	request->Arg           = Arg;
+
+	pthread_mutex_lock(&micro.Lock);
+	{
+		if (micro.Tail)
+			micro.Tail->Next = request;
+		else
+			micro.Head = request;
+		micro.Tail = request;
+		/* A signal could land on a thread sitting out this run. */
+		pthread_cond_broadcast(&micro.Cond);
+	}
+	pthread_mutex_unlock(&micro.Lock);
+	return GLOBUS_SUCCESS;
+}
+
+/*
+ * The server side of the calls the transfer paths make.
+ */
+
+void
+globus_gfs_log_message(globus_gfs_log_type_t Type, const char * Format, ...)
+{
+}
+
+void
+globus_gridftp_server_get_optimal_concurrency(globus_gfs_operation_t Operation, int * Count)
+{
+	*Count = micro.OptConnCnt;
+}
+
+void
+globus_gridftp_server_update_bytes_written(globus_gfs_operation_t Operation,
+                                           globus_off_t           Offset,
+                                           globus_off_t           Length)
+{
+}
+
+void
+globus_gridftp_server_update_bytes_recvd(globus_gfs_operation_t Operation, globus_off_t Length)
+{
+}
+
+void
+globus_gridftp_server_update_range_recvd(globus_gfs_operation_t Operation,
+                                         globus_off_t           Offset,
+                                         globus_off_t           Length)
+{
+}
+
+globus_result_t
+globus_gridftp_server_register_read(globus_gfs_operation_t            Operation,
+                                    globus_byte_t                   * Buffer,
+                                    globus_size_t                     Length,
+                                    globus_gridftp_server_read_cb_t   Callback,
+                                    void                            * UserArg)
+{
+	return micro_queue(Buffer, Length, Callback, NULL, UserArg);
+}
+
+globus_result_t
+globus_gridftp_server_register_write(globus_gfs_operation_t             Operation,
+                                     globus_byte_t                    * Buffer,
+                                     globus_size_t                      Length,
+                                     globus_off_t                       Offset,
+                                     int                                StripeIndex,
+                                     globus_gridftp_server_write_cb_t   Callback,
+                                     void                             * UserArg)
+{
+	return micro_queue(Buffer, Length, NULL, Callback, UserArg);
+}
+
+/*
+ * Driver.
+ */
+
+typedef struct {
+	uint64_t Blocks;     // GridFTP blocks moved
+	uint64_t Wall;       // nsecs
+	uint64_t PIOCPU;     // nsecs
+	uint64_t NetCPU;     // nsecs
+	uint64_t Sleeps;
+	uint64_t Wakeups;
+	int      Buffers;
+	int      Failed;
+} micro_result_t;
+
+static void
+micro_start_run(int OptConnCnt, int Threads, int Window)
+{
+	pthread_mutex_lock(&micro.Lock);
+	{
+		micro.OptConnCnt = OptConnCnt;
+		micro.Window     = Window;
+		micro.Active     = Threads;
+		micro.RecvOffset = 0;
+		micro.RecvDone   = 0;
+		micro.NetCPU     = 0;
+		pthread_cond_broadcast(&micro.Cond);
+	}
+	pthread_mutex_unlock(&micro.Lock);
+}
+
+/* Feeds PIO blocks through Callout; returns non zero if the DSI gave up. */
+static int
+micro_pio_loop(micro_pio_callout_t Callout, void * Info, char * Block, uint64_t BlockSize)
+{
+	uint64_t offset = 0;
+	uint32_t length = 0;
+
+	for (offset = 0; offset < micro.Size; offset += length)
+	{
+		length = BlockSize;
+		if (length > micro.Size - offset)
+			length = micro.Size - offset;
+
+		if (Callout(Block, &length, offset, Info))
+			return 1;
+	}
+	return 0;
+}
+
+static void
+micro_stor(globus_size_t BlockSize, char * Block, uint64_t PIOBlockSize, micro_result_t * Result)
+{
+	globus_list_t            * list = NULL;
+	stor_buffer_t            * stor_buffer = NULL;
+	stor_info_t                stor_info;
+	globus_gfs_transfer_info_t transfer_info;
+
+	memset(&stor_info, 0, sizeof(stor_info));
+	memset(&transfer_info, 0, sizeof(transfer_info));
+	transfer_info.alloc_size = micro.Size;
+	stor_info.TransferInfo   = &transfer_info;
+	stor_info.BlockSize      = BlockSize;
+	stor_info.RangeLength    = micro.Size;
+	stor_info.FileFD         = -1;
+
+	Result->Failed = micro_pio_loop(micro.StorPIOCallout, &stor_info, Block, PIOBlockSize);
+	micro.StorWait(&stor_info);
+	/* A network thread may still be leaving handoff_push(); stor_info is on our stack. */
+	if (micro.HandoffDestroy)
+		micro.HandoffDestroy(&stor_info.Returned);
+
+	Result->Sleeps  = stor_info.Returned.Sleeps;
+	Result->Wakeups = stor_info.Returned.Wakeups;
+	Result->Buffers = globus_list_size(stor_info.AllBufferList);
+
+	globus_list_free(stor_info.FreeBufferList);
+	globus_list_free(stor_info.ReadyBufferList);
+	for (list = stor_info.AllBufferList; !globus_list_empty(list); list = globus_list_rest(list))
+	{
+		stor_buffer = globus_list_first(list);
+		micro_free_buffer(stor_buffer->Buffer, BlockSize);
+		free(stor_buffer);
+	}
+	globus_list_free(stor_info.AllBufferList);
+}
+
+static void
+micro_retr(globus_size_t BlockSize, char * Block, uint64_t PIOBlockSize, micro_result_t * Result)
+{
+	globus_list_t * list        = NULL;
+	retr_buffer_t * retr_buffer = NULL;
+	retr_info_t     retr_info;
+
+	memset(&retr_info, 0, sizeof(retr_info));
+	retr_info.BlockSize   = BlockSize;
+	retr_info.FileSize    = micro.Size;
+	retr_info.RangeLength = micro.Size;
+	retr_info.FileFD      = -1;
+
+	/* RETR hands GridFTP one buffer per PIO block. */
+	Result->Failed = micro_pio_loop(micro.RetrPIOCallout, &retr_info, Block, PIOBlockSize);
+	micro.RetrWait(&retr_info);
+	if (micro.HandoffDestroy)
+		micro.HandoffDestroy(&retr_info.Returned);
+
+	Result->Sleeps  = retr_info.Returned.Sleeps;
+	Result->Wakeups = retr_info.Returned.Wakeups;
+	Result->Buffers = globus_list_size(retr_info.AllBufferList);
+
+	globus_list_free(retr_info.FreeBufferList);
+	for (list = retr_info.AllBufferList; !globus_list_empty(list); list = globus_list_rest(list))
+	{
+		retr_buffer = globus_list_first(list);
+		micro_free_buffer(retr_buffer->Buffer, BlockSize);
+		free(retr_buffer);
+	}
+	globus_list_free(retr_info.AllBufferList);
+}
+
+static void
+micro_run(int Stor, globus_size_t BlockSize, int OptConnCnt, int Threads, int Window)
+{
+	uint64_t       pio_block_size = micro.PIOBlockSize ? micro.PIOBlockSize : BlockSize;
+	uint64_t       wall           = 0;
+	uint64_t       cpu            = 0;
+	char         * block          = NULL;
+	micro_result_t result;
+
+	/* RETR's buffers are the PIO block size; GridFTP's does not apply. */
+	if (!Stor)
+		BlockSize = pio_block_size;
+
+	memset(&result, 0, sizeof(result));
+	block = micro_get_buffer(pio_block_size);
+	if (!block)
+	{
+		fprintf(stderr, "Unable to allocate the PIO block\n");
+		return;
+	}
+
+	micro_start_run(OptConnCnt, Threads, Window);
+
+	wall = micro_now(CLOCK_MONOTONIC);
+	cpu  = micro_now(CLOCK_THREAD_CPUTIME_ID);
+	if (Stor)
+		micro_stor(BlockSize, block, pio_block_size, &result);
+	else
+		micro_retr(BlockSize, block, pio_block_size, &result);
+	result.PIOCPU = micro_now(CLOCK_THREAD_CPUTIME_ID) - cpu;
+	result.Wall   = micro_now(CLOCK_MONOTONIC) - wall;
+
+	pthread_mutex_lock(&micro.Lock);
+	result.NetCPU = micro.NetCPU;
+	pthread_mutex_unlock(&micro.Lock);
+
+	micro_free_buffer(block, pio_block_size);
+
+	result.Blocks = (micro.Size + BlockSize - 1) / BlockSize;
+
+	printf("%-4s %8zu %5d %3d %3d %8"PRIu64" %9.0f %9.0f %9.0f %8.1f %8.1f %7d%s\n",
+	       Stor ? "stor" : "retr",
+	       (size_t)BlockSize,
+	       OptConnCnt,
+	       Threads,
+	       Window,
+	       result.Blocks,
+	       (double)result.Wall / result.Blocks,
+	       (double)result.PIOCPU / result.Blocks,
+	       (double)result.NetCPU / result.Blocks,
+	       result.Sleeps * 1000.0 / result.Blocks,
+	       result.Wakeups * 1000.0 / result.Blocks,
+	       result.Buffers,
+	       result.Failed ? " FAILED" : "");
+	fflush(stdout);
+}
+
+static uint64_t
+micro_parse_size(const char * Value)
+{
+	char   * end  = NULL;
+	uint64_t size = strtoull(Value, &end, 0);
+
+	switch (*end)
+	{
+	case 'g': case 'G': size *= 1024;
+	case 'm': case 'M': size *= 1024;
+	case 'k': case 'K': size *= 1024;
+	}
+	return size;
+}
+
+/* Parses a comma separated list of sizes; returns non zero if it is bad. */
+static int
+micro_parse_sweep(char * Value, micro_sweep_t * Sweep)
+{
+	char * value   = NULL;
+	char * saveptr = NULL;
+
+	Sweep->Count = 0;
+	for (value = strtok_r(Value, ",", &saveptr); value; value = strtok_r(NULL, ",", &saveptr))
+	{
+		if (Sweep->Count == MICRO_MAX_VALUES)
+			return 1;
+		Sweep->Values[Sweep->Count] = micro_parse_size(value);
+		if (Sweep->Values[Sweep->Count] == 0)
+			return 1;
+		Sweep->Count++;
+	}
+	return Sweep->Count == 0;
+}
+
+/* Returns non zero if placement was asked for but the DSI can not do it. */
+static int
+micro_setup_placement(void * Handle)
+{
+	micro_placement_init_t placement_init = dlsym(Handle, "placement_init");
+	micro_pin_thread_t     pin_thread     = dlsym(Handle, "placement_pin_thread");
+
+	micro.GetBuffer  = dlsym(Handle, "bufpool_get");
+	micro.FreeBuffer = dlsym(Handle, "bufpool_free");
+
+	if (!placement_init || !pin_thread || !micro.GetBuffer || !micro.FreeBuffer)
+	{
+		micro.GetBuffer  = NULL;
+		micro.FreeBuffer = NULL;
+
+		if (micro.Config.BufferHugePages || micro.Config.BufferNUMANode >= 0 || micro.Config.PinPIOThreads)
+		{
+			fprintf(stderr, "%s does not support buffer placement\n", micro.Library);
+			return 1;
+		}
+		return 0;
+	}
+
+	/* This thread runs the PIO loop. */
+	placement_init(&micro.Config);
+	pin_thread();
+
+	printf("# huge pages %s, NUMA node %d, PIO %s\n",
+	       micro.Config.BufferHugePages ? "on" : "off",
+	       micro.Config.BufferNUMANode,
+	       micro.Config.PinPIOThreads ? "pinned" : "not pinned");
+	return 0;
+}
+
+static void
+micro_usage(const char * Program)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  -L <library>   DSI library (default %s)\n"
+	        "  -s <size>      Bytes per run, k/m/g suffixes allowed (default 256m)\n"
+	        "  -b <sizes>     GridFTP block sizes (default 64k,1m,4m)\n"
+	        "  -P <size>      PIO block size (default the GridFTP block size)\n"
+	        "  -c <counts>    OptConnCnt values (default 1,2,4,8,16,32,64)\n"
+	        "  -t <counts>    Network threads (default 1,2,4,8)\n"
+	        "  -w <counts>    Requests a network thread completes newest first;\n"
+	        "                 1 is in order (default 1,8)\n"
+	        "  -H             Back buffers with huge pages (BufferHugePages)\n"
+	        "  -N <node>      Put buffers on this NUMA node (BufferNUMANode)\n"
+	        "  -p             Pin the PIO loop to that node's CPUs (PinPIOThreads)\n"
+	        "Lists are comma separated; every combination is run.\n",
+	        Program,
+	        MICRO_DEFAULT_DSI);
+}
+
+int
+main(int argc, char * argv[])
+{
+	int    opt;
+	int    b, c, t, w;
+	int    i;
+	int    threads = 0;
+	int    retval  = 1;
+	void * handle  = NULL;
+	char   default_blocks[]  = "64k,1m,4m";
+	char   default_conns[]   = "1,2,4,8,16,32,64";
+	char   default_threads[] = "1,2,4,8";
+	char   default_windows[] = "1,8";
+
+	micro_parse_sweep(default_blocks,  &micro.BlockSizes);
+	micro_parse_sweep(default_conns,   &micro.Conns);
+	micro_parse_sweep(default_threads, &micro.NetThreads);
+	micro_parse_sweep(default_windows, &micro.Windows);
+
+	while ((opt = getopt(argc, argv, "L:s:b:P:c:t:w:HN:ph")) != -1)
+	{
+		switch (opt)
+		{
+		case 'H': micro.Config.BufferHugePages = 1; break;
+		case 'N': micro.Config.BufferNUMANode  = atoi(optarg); break;
+		case 'p': micro.Config.PinPIOThreads   = 1; break;
+		case 'L': micro.Library      = optarg; break;
+		case 's': micro.Size         = micro_parse_size(optarg); break;
+		case 'P': micro.PIOBlockSize = micro_parse_size(optarg); break;
+		case 'b':
+		case 'c':
+		case 't':
+		case 'w':
+			if (micro_parse_sweep(optarg,
+			                      opt == 'b' ? &micro.BlockSizes :
+			                      opt == 'c' ? &micro.Conns :
+			                      opt == 't' ? &micro.NetThreads : &micro.Windows))
+			{
+				micro_usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			micro_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (micro.Size == 0 || micro.PIOBlockSize > UINT32_MAX)
+	{
+		micro_usage(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < micro.NetThreads.Count; i++)
+	{
+		if (micro.NetThreads.Values[i] > MICRO_MAX_THREADS)
+		{
+			micro_usage(argv[0]);
+			return 1;
+		}
+		if (micro.NetThreads.Values[i] > threads)
+			threads = micro.NetThreads.Values[i];
+	}
+
+	for (i = 0; i < micro.Windows.Count; i++)
+	{
+		if (micro.Windows.Values[i] > MICRO_MAX_THREADS)
+		{
+			micro_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (globus_module_activate(GLOBUS_COMMON_MODULE) != GLOBUS_SUCCESS)
+	{
+		fprintf(stderr, "Unable to activate globus_common\n");
+		return 1;
+	}
+
+	/* No RTLD_DEEPBIND; the DSI must bind to our server functions. */
+	handle = dlopen(micro.Library, RTLD_NOW|RTLD_GLOBAL);
+	if (!handle)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		goto cleanup;
+	}
+
+	micro.StorPIOCallout = dlsym(handle, "stor_pio_callout");
+	micro.RetrPIOCallout = dlsym(handle, "retr_pio_callout");
+	micro.StorWait       = dlsym(handle, "stor_wait_for_gridftp");
+	micro.RetrWait       = dlsym(handle, "retr_wait_for_gridftp");
+	micro.HandoffDestroy = dlsym(handle, "handoff_destroy");
+	if (!micro.StorPIOCallout || !micro.RetrPIOCallout || !micro.StorWait || !micro.RetrWait)
+	{
+		fprintf(stderr, "%s does not export the transfer callouts\n", micro.Library);
+		goto cleanup;
+	}
+
+	if (micro_setup_placement(handle))
+		goto cleanup;
+
+	for (i = 0; i < threads; i++)
+	{
+		if (pthread_create(&micro.Threads[i], NULL, micro_net_thread, (void *)(intptr_t)i))
+		{
+			fprintf(stderr, "Unable to start the network threads\n");
+			threads = i;
+			goto cleanup;
+		}
+	}
+
+	printf("%-4s %8s %5s %3s %3s %8s %9s %9s %9s %8s %8s %7s\n",
+	       "op", "block", "conns", "thr", "win", "blocks",
+	       "ns/blk", "pio ns", "net ns", "sleeps", "wakeups", "buffers");
+
+	for (b = 0; b < micro.BlockSizes.Count; b++)
+	for (c = 0; c < micro.Conns.Count; c++)
+	for (t = 0; t < micro.NetThreads.Count; t++)
+	for (w = 0; w < micro.Windows.Count; w++)
+	{
+		micro_run(1, micro.BlockSizes.Values[b], micro.Conns.Values[c],
+		          micro.NetThreads.Values[t], micro.Windows.Values[w]);
+		micro_run(0, micro.BlockSizes.Values[b], micro.Conns.Values[c],
+		          micro.NetThreads.Values[t], micro.Windows.Values[w]);
+	}
+
+	retval = 0;
+
+cleanup:
+	pthread_mutex_lock(&micro.Lock);
+	micro.Shutdown = 1;
+	pthread_cond_broadcast(&micro.Cond);
+	pthread_mutex_unlock(&micro.Lock);
+
+	for (i = 0; i < threads; i++)
+	{
+		pthread_join(micro.Threads[i], NULL);
+	}
+
+	globus_module_deactivate(GLOBUS_COMMON_MODULE);
+	return retval;
+}
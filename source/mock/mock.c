@@ -0,0 +1,183 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/xattr.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+/*
+ * Local includes
+ */
+#include "mock.h"
+
+static pthread_once_t _config_once = PTHREAD_ONCE_INIT;
+static mock_config_t  _config;
+
+static uint64_t
+mock_getenv_u64(const char * Name, uint64_t Default)
+{
+	char * value = getenv(Name);
+
+	if (!value || !*value)
+		return Default;
+	return strtoull(value, NULL, 10);
+}
+
+static void
+mock_config_init()
+{
+	_config.Root = getenv("HPSS_MOCK_ROOT");
+	if (!_config.Root || !*_config.Root)
+		_config.Root = "/tmp/hpss_mock";
+
+	_config.Home = getenv("HPSS_MOCK_HOME");
+	if (!_config.Home || !*_config.Home)
+		_config.Home = "/";
+
+	_config.StripeWidth    = mock_getenv_u64("HPSS_MOCK_STRIPE_WIDTH", 1);
+	_config.MoverLatency   = mock_getenv_u64("HPSS_MOCK_MOVER_LATENCY", 0);
+	_config.MoverBandwidth = mock_getenv_u64("HPSS_MOCK_MOVER_BANDWIDTH", 0) * 1024 * 1024;
+	_config.StageDelay     = mock_getenv_u64("HPSS_MOCK_STAGE_DELAY", 5);
+	_config.MoverFaults    = mock_getenv_u64("HPSS_MOCK_MOVER_FAULTS", 0) * 1024 * 1024;
+
+	_config.Replay = getenv("HPSS_MOCK_REPLAY");
+	if (_config.Replay && !*_config.Replay)
+		_config.Replay = NULL;
+
+	if (_config.StripeWidth < 1)
+		_config.StripeWidth = 1;
+}
+
+const mock_config_t *
+mock_config()
+{
+	pthread_once(&_config_once, mock_config_init);
+	return &_config;
+}
+
+int
+mock_local_path(const char * Path, char * LocalPath, size_t Length)
+{
+	const mock_config_t * config = mock_config();
+	int                   length = 0;
+
+	if (Path[0] == '/')
+		length = snprintf(LocalPath, Length, "%s%s", config->Root, Path);
+	else
+		length = snprintf(LocalPath, Length, "%s%s/%s", config->Root, config->Home, Path);
+
+	if (length >= Length)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+int
+mock_local_path_handle(const ns_ObjHandle_t * ObjHandle,
+                       const char           * Path,
+                       char                 * LocalPath,
+                       size_t                 Length)
+{
+	char path[HPSS_MAX_PATH_NAME];
+
+	if (!ObjHandle || !Path || Path[0] == '/')
+		return mock_local_path(Path ? Path : ObjHandle->Path, LocalPath, Length);
+
+	if (snprintf(path, sizeof(path), "%s/%s", ObjHandle->Path, Path) >= sizeof(path))
+		return -ENAMETOOLONG;
+	return mock_local_path(path, LocalPath, Length);
+}
+
+uint64_t
+mock_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void
+mock_sleep_until(uint64_t Deadline)
+{
+	uint64_t        now = mock_now();
+	struct timespec ts;
+
+	if (Deadline <= now)
+		return;
+
+	ts.tv_sec  = (Deadline - now) / 1000000;
+	ts.tv_nsec = ((Deadline - now) % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+mock_residency_t
+mock_get_residency(const char * LocalPath)
+{
+	char    value[32];
+	ssize_t length = getxattr(LocalPath, MOCK_XATTR_RESIDENCY, value, sizeof(value) - 1);
+
+	if (length <= 0)
+		return MOCK_RESIDENT;
+	value[length] = '\0';
+
+	if (strcmp(value, "archived") == 0)
+		return MOCK_ARCHIVED;
+	if (strcmp(value, "tape-only") == 0)
+		return MOCK_TAPE_ONLY;
+	return MOCK_RESIDENT;
+}
+
+void
+mock_stage(const char * LocalPath)
+{
+	if (mock_get_residency(LocalPath) == MOCK_RESIDENT)
+		return;
+
+	mock_sleep_until(mock_now() + mock_config()->StageDelay * 1000000ULL);
+	removexattr(LocalPath, MOCK_XATTR_RESIDENCY);
+}
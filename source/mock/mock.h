@@ -0,0 +1,137 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_MOCK_MOCK_H
+#define HPSS_MOCK_MOCK_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Local includes
+ */
+#include "hpss_api.h"
+
+/*
+ * Settings, read once from the environment. See README.
+ */
+typedef struct {
+	char     * Root;           // HPSS_MOCK_ROOT, backs the name space
+	char     * Home;           // HPSS_MOCK_HOME, the user's HPSS directory
+	int        StripeWidth;    // HPSS_MOCK_STRIPE_WIDTH
+	uint64_t   MoverLatency;   // HPSS_MOCK_MOVER_LATENCY, usecs per block
+	uint64_t   MoverBandwidth; // HPSS_MOCK_MOVER_BANDWIDTH, bytes/sec per stripe
+	int        StageDelay;     // HPSS_MOCK_STAGE_DELAY, seconds
+	uint64_t   MoverFaults;    // HPSS_MOCK_MOVER_FAULTS, bytes between mover faults
+	char     * Replay;         // HPSS_MOCK_REPLAY, call trace to replay
+} mock_config_t;
+
+const mock_config_t *
+mock_config();
+
+/*
+ * Maps the HPSS path Path to the backing file in LocalPath. Relative paths
+ * are taken from the user's home directory. Returns 0 or -ENAMETOOLONG.
+ */
+int
+mock_local_path(const char * Path, char * LocalPath, size_t Length);
+
+/* Same as mock_local_path() for Path relative to a directory handle. */
+int
+mock_local_path_handle(const ns_ObjHandle_t * ObjHandle,
+                       const char           * Path,
+                       char                 * LocalPath,
+                       size_t                 Length);
+
+uint64_t
+mock_now();
+
+/* Sleeps until usecs Deadline on the mock_now() clock. */
+void
+mock_sleep_until(uint64_t Deadline);
+
+/*
+ * Residency of a file, kept in the backing file's extended attributes so
+ * that tests can archive files with setfattr(1).
+ */
+#define MOCK_XATTR_RESIDENCY "user.hpss_mock.residency"
+#define MOCK_XATTR_UDA       "user.hpss_mock.uda"
+
+typedef enum {
+	MOCK_RESIDENT,  // On disk with a copy on tape
+	MOCK_ARCHIVED,  // Purged from disk, only on tape
+	MOCK_TAPE_ONLY, // Tape only class of service
+} mock_residency_t;
+
+mock_residency_t
+mock_get_residency(const char * LocalPath);
+
+/* Blocks for the stage delay and then marks LocalPath resident. */
+void
+mock_stage(const char * LocalPath);
+
+/*
+ * Replay of a DSI call trace; see replay.c. mock_replay_find() takes the
+ * next recorded call matching Call and Path (which may be NULL) and returns
+ * 1 if there was one. Args, if not NULL, receives the record's two
+ * arguments. mock_replay() also waits out the recorded duration and returns
+ * the recorded error, or 0.
+ */
+int
+mock_replay_find(const char * Call,
+                 const char * Path,
+                 uint64_t   * Duration,
+                 int32_t    * ReturnValue,
+                 uint64_t   * Args);
+
+int
+mock_replay(const char * Call, const char * Path);
+
+/* Fails the calling HPSS function if the replayed call failed. */
+#define MOCK_REPLAY(Call, Path)                 \
+	do {                                        \
+		int _rc = mock_replay(Call, Path);      \
+		if (_rc < 0)                            \
+			return _rc;                         \
+	} while (0)
+
+#endif /* HPSS_MOCK_MOCK_H */
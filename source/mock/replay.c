@@ -0,0 +1,338 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * Call trace replay. With HPSS_MOCK_REPLAY set to a trace written by the DSI
+ * (CallTraceDir), each call first takes the recorded duration of a matching
+ * call from the trace and, if the recorded call failed, fails the same way
+ * without doing the work. A call matches the oldest unused record of the
+ * same call name and, if both have one, the same path; calls with no match
+ * run at mock speed. PIOExecute spreads its recorded duration over the
+ * blocks it moves instead (see hpss_pio.c).
+ *
+ * Before the first call, every file and directory the trace saw stat'ed
+ * successfully is created under HPSS_MOCK_ROOT, files as sparse files of
+ * the recorded size, unless something already exists there.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/*
+ * Local includes
+ */
+#include "calltrace.h"
+#include "mock.h"
+
+typedef struct {
+	calltrace_record_t Record;
+	char             * Path;   // NULL if the call had none
+	int                Used;
+} mock_replay_entry_t;
+
+typedef struct {
+	char                 Name[64];
+	mock_replay_entry_t ** Entries;
+	size_t               Count;
+	size_t               Capacity;
+	size_t               Next;   // Entries before this one are used
+} mock_replay_call_t;
+
+static pthread_once_t       mock_replay_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t      mock_replay_lock = PTHREAD_MUTEX_INITIALIZER;
+static mock_replay_call_t * mock_replay_calls = NULL;
+static uint32_t             mock_replay_call_count = 0;
+
+/* Creates the parents of LocalPath. */
+static void
+mock_replay_mkdirs(char * LocalPath)
+{
+	char * slash = LocalPath + strlen(mock_config()->Root);
+
+	while ((slash = strchr(slash + 1, '/')))
+	{
+		*slash = '\0';
+		mkdir(LocalPath, 0755);
+		*slash = '/';
+	}
+}
+
+static void
+mock_replay_create(const char * Path, uint64_t Size, uint64_t Mode)
+{
+	int         fd;
+	struct stat local;
+	char        local_path[HPSS_MAX_PATH_NAME * 2];
+
+	if (mock_local_path(Path, local_path, sizeof(local_path)))
+		return;
+	if (lstat(local_path, &local) == 0)
+		return;
+
+	mock_replay_mkdirs(local_path);
+
+	if (S_ISDIR(Mode))
+	{
+		mkdir(local_path, 0755);
+	} else if (S_ISREG(Mode))
+	{
+		fd = open(local_path, O_WRONLY|O_CREAT|O_EXCL, 0644);
+		if (fd == -1)
+			return;
+		if (ftruncate(fd, Size))
+			fprintf(stderr, "hpss mock: unable to size %s: %s\n", local_path, strerror(errno));
+		close(fd);
+	}
+}
+
+static int
+mock_replay_read(FILE * File, void * Buffer, size_t Length)
+{
+	return Length == 0 || fread(Buffer, Length, 1, File) == 1;
+}
+
+static int
+mock_replay_add(mock_replay_call_t * Call, mock_replay_entry_t * Entry)
+{
+	mock_replay_entry_t ** entries = NULL;
+
+	if (Call->Count == Call->Capacity)
+	{
+		entries = realloc(Call->Entries, sizeof(*entries) * (Call->Capacity ? Call->Capacity * 2 : 16));
+		if (!entries)
+			return ENOMEM;
+		Call->Entries   = entries;
+		Call->Capacity *= 2;
+		if (!Call->Capacity)
+			Call->Capacity = 16;
+	}
+
+	Call->Entries[Call->Count++] = Entry;
+	return 0;
+}
+
+static void
+mock_replay_load()
+{
+	uint32_t              i;
+	uint8_t               length = 0;
+	uint64_t              count  = 0;
+	FILE                * file   = NULL;
+	mock_replay_entry_t * entry  = NULL;
+	mock_replay_call_t  * call   = NULL;
+	const char          * path   = mock_config()->Replay;
+	calltrace_header_t    header;
+
+	file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "hpss mock: unable to open %s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	if (!mock_replay_read(file, &header, sizeof(header)) || header.Magic != CALLTRACE_MAGIC)
+	{
+		fprintf(stderr, "hpss mock: %s is not a call trace\n", path);
+		goto cleanup;
+	}
+
+	if (header.Version != CALLTRACE_VERSION)
+	{
+		fprintf(stderr, "hpss mock: %s is a version %u call trace, expected %u\n",
+		        path, header.Version, CALLTRACE_VERSION);
+		goto cleanup;
+	}
+
+	mock_replay_calls = calloc(header.CallCount, sizeof(mock_replay_call_t));
+	if (!mock_replay_calls)
+		goto cleanup;
+	mock_replay_call_count = header.CallCount;
+
+	for (i = 0; i < header.CallCount; i++)
+	{
+		if (!mock_replay_read(file, &length, 1) ||
+		    !mock_replay_read(file, mock_replay_calls[i].Name, length))
+			goto truncated;
+	}
+
+	/* Operation names only matter to hpss_dsi_bench. */
+	for (i = 0; i < header.OpCount; i++)
+	{
+		char name[256];
+		if (!mock_replay_read(file, &length, 1) || !mock_replay_read(file, name, length))
+			goto truncated;
+	}
+
+	while (1)
+	{
+		entry = calloc(1, sizeof(mock_replay_entry_t));
+		if (!entry)
+			break;
+
+		if (!mock_replay_read(file, &entry->Record, sizeof(calltrace_record_t)))
+		{
+			free(entry);
+			break;
+		}
+
+		if (entry->Record.PathLength)
+		{
+			entry->Path = calloc(1, entry->Record.PathLength + 1);
+			if (!entry->Path || !mock_replay_read(file, entry->Path, entry->Record.PathLength))
+			{
+				free(entry->Path);
+				free(entry);
+				goto truncated;
+			}
+		}
+
+		if (entry->Record.Call >= header.CallCount)
+		{
+			free(entry->Path);
+			free(entry);
+			continue;
+		}
+		call = &mock_replay_calls[entry->Record.Call];
+
+		/* Stats and attribute lookups show what the name space held. */
+		if (entry->Path && entry->Record.Return >= 0 &&
+		    (strcmp(call->Name, "hpss_Stat") == 0 ||
+		     strcmp(call->Name, "hpss_Lstat") == 0 ||
+		     strcmp(call->Name, "hpss_FileGetAttributes") == 0))
+		{
+			mock_replay_create(entry->Path, entry->Record.Args[0], entry->Record.Args[1]);
+		}
+
+		if (mock_replay_add(call, entry))
+		{
+			free(entry->Path);
+			free(entry);
+			break;
+		}
+		count++;
+	}
+
+	fprintf(stderr, "hpss mock: replaying %llu calls from %s\n", (unsigned long long)count, path);
+	goto cleanup;
+
+truncated:
+	fprintf(stderr, "hpss mock: %s is truncated\n", path);
+cleanup:
+	fclose(file);
+}
+
+int
+mock_replay_find(const char * Call,
+                 const char * Path,
+                 uint64_t   * Duration,
+                 int32_t    * ReturnValue,
+                 uint64_t   * Args)
+{
+	uint32_t              i;
+	size_t                j;
+	int                   found = 0;
+	mock_replay_call_t  * call  = NULL;
+	mock_replay_entry_t * entry = NULL;
+
+	if (!mock_config()->Replay)
+		return 0;
+
+	pthread_once(&mock_replay_once, mock_replay_load);
+
+	for (i = 0; i < mock_replay_call_count; i++)
+	{
+		if (strcmp(mock_replay_calls[i].Name, Call) == 0)
+		{
+			call = &mock_replay_calls[i];
+			break;
+		}
+	}
+	if (!call)
+		return 0;
+
+	pthread_mutex_lock(&mock_replay_lock);
+	{
+		for (j = call->Next; j < call->Count; j++)
+		{
+			entry = call->Entries[j];
+			if (entry->Used)
+				continue;
+			if (Path && entry->Path && strcmp(Path, entry->Path))
+				continue;
+
+			entry->Used  = 1;
+			found        = 1;
+			*Duration    = entry->Record.Duration;
+			*ReturnValue = entry->Record.Return;
+			if (Args)
+				memcpy(Args, entry->Record.Args, sizeof(entry->Record.Args));
+			break;
+		}
+
+		while (call->Next < call->Count && call->Entries[call->Next]->Used)
+			call->Next++;
+	}
+	pthread_mutex_unlock(&mock_replay_lock);
+
+	return found;
+}
+
+int
+mock_replay(const char * Call, const char * Path)
+{
+	uint64_t duration = 0;
+	int32_t  retval   = 0;
+
+	if (!mock_replay_find(Call, Path, &duration, &retval, NULL))
+		return 0;
+
+	mock_sleep_until(mock_now() + duration);
+	return retval < 0 ? retval : 0;
+}
@@ -43,7 +43,9 @@
  * System includes.
  */
 #include <sys/types.h>
-#include <pwd.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
 
 /*
  * Globus includes
@@ -62,62 +64,70 @@
  * Local includes
  */
 #include "authenticate.h"
+#include "histogram.h"
+#include "idcache.h"
+#include "rpcstats.h"
 
+/*
+ * The parsed authenticator and the login credential acquired with it are
+ * kept for the life of the process. Parsing reads the keytab and logging in
+ * costs a round trip to the KDC (krb5), so neither should be repeated for
+ * every session when the config has not changed.
+ */
+static pthread_mutex_t authenticate_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	/* The config values the cached state was built from. */
+	char               * AuthenticationMech;
+	char               * Authenticator;
 
-globus_result_t
-authenticate_get_uid(char * UserName, int * Uid)
-{
-	struct passwd * passwd = NULL;
-	struct passwd   passwd_buf;
-	char            buffer[1024];
-	int             retval = 0;
-
-	GlobusGFSName(authenticate_get_uid);
-
-	/* Find the passwd entry. */
-	retval = getpwnam_r(UserName,
-	                    &passwd_buf,
-	                    buffer,
-	                    sizeof(buffer),
-	                    &passwd);
-	if (retval != 0)
-		return GlobusGFSErrorSystemError("getpwnam_r", errno);
-
-	if (passwd == NULL)
-		return GlobusGFSErrorGeneric("Account not found");
+	hpss_authn_mech_t    AuthnMech;
+	hpss_rpc_auth_type_t AuthType;
+	void               * ParsedAuthenticator;
 
-	/* Copy out the uid */
-	*Uid = passwd->pw_uid;
+	char               * LoginName; // NULL until logged in
+	uint64_t             LoginTime; // histogram_now() at login
+} authenticate_cache;
 
-	return GLOBUS_SUCCESS;
+static int
+authenticate_same(char * Cached, char * Current)
+{
+	if (!Cached || !Current)
+		return Cached == Current;
+	return strcmp(Cached, Current) == 0;
 }
 
-globus_result_t
-authenticate(char * LoginName,
-             char * AuthenticationMech,
-             char * Authenticator,
-             char * UserName)
+/* Call with authenticate_lock held. */
+static globus_result_t
+authenticate_parse(config_t * Config)
 {
-	int                  uid           = -1;
+	int                  retval        = 0;
 	char               * authenticator = NULL;
-	globus_result_t      result        = GLOBUS_SUCCESS;
+	char               * mech_copy     = NULL;
+	char               * auth_copy     = NULL;
 	hpss_rpc_auth_type_t auth_type;
 	api_config_t         api_config;
 
-	GlobusGFSName(authenticate);
+	GlobusGFSName(authenticate_parse);
+
+	if (authenticate_cache.ParsedAuthenticator &&
+	    authenticate_same(authenticate_cache.AuthenticationMech, Config->AuthenticationMech) &&
+	    authenticate_same(authenticate_cache.Authenticator, Config->Authenticator))
+	{
+		return GLOBUS_SUCCESS;
+	}
 
 	/* Get the current HPSS client configuration. */
-	int retval = hpss_GetConfiguration(&api_config);
+	retval = hpss_GetConfiguration(&api_config);
 	if (retval != HPSS_E_NOERROR)
 		return GlobusGFSErrorSystemError("hpss_GetConfiguration", -retval);
 
 	/* Translate the authentication mechanism. */
-	retval = hpss_AuthnMechTypeFromString(AuthenticationMech, &api_config.AuthnMech);
+	retval = hpss_AuthnMechTypeFromString(Config->AuthenticationMech, &api_config.AuthnMech);
 	if (retval != HPSS_E_NOERROR)
 		return GlobusGFSErrorSystemError("hpss_AuthnMechTypeFromString()", -retval);
 
 	/* Parse the authenticator. */
-	retval = hpss_ParseAuthString(Authenticator,
+	retval = hpss_ParseAuthString(Config->Authenticator,
 	                              &api_config.AuthnMech,
 	                              &auth_type,
 	                              (void **)&authenticator);
@@ -130,17 +140,116 @@ authenticate(char * LoginName,
 //	if (retval != HPSS_E_NOERROR)
 //		return GlobusGFSErrorSystemError("hpss_SetConfiguration()", -retval);
 
+	mech_copy = strdup(Config->AuthenticationMech);
+	auth_copy = strdup(Config->Authenticator);
+	if (!mech_copy || !auth_copy)
+	{
+		free(mech_copy);
+		free(auth_copy);
+		return GlobusGFSErrorMemory("authenticator");
+	}
+
+	/*
+	 * The previous parsed authenticator is dropped rather than freed; the
+	 * HPSS API has no call to release it and this only happens when the
+	 * config changes.
+	 */
+	free(authenticate_cache.AuthenticationMech);
+	free(authenticate_cache.Authenticator);
+	authenticate_cache.AuthenticationMech  = mech_copy;
+	authenticate_cache.Authenticator       = auth_copy;
+	authenticate_cache.AuthnMech           = api_config.AuthnMech;
+	authenticate_cache.AuthType            = auth_type;
+	authenticate_cache.ParsedAuthenticator = authenticator;
+
+	/* A new authenticator means a new login. */
+	free(authenticate_cache.LoginName);
+	authenticate_cache.LoginName = NULL;
+
+	return GLOBUS_SUCCESS;
+}
+
+/* Call with authenticate_lock held. */
+static globus_result_t
+authenticate_login(config_t * Config)
+{
+	int      retval = 0;
+	uint64_t now    = histogram_now();
+	char   * login  = NULL;
+
+	GlobusGFSName(authenticate_login);
+
+	/*
+	 * Reuse the credential until it is LoginCredRefresh seconds old. That is
+	 * meant to be set below the credential's lifetime so that it is renewed
+	 * before it can expire underneath a session.
+	 */
+	if (authenticate_cache.LoginName &&
+	    Config->LoginCredRefresh > 0 &&
+	    strcmp(authenticate_cache.LoginName, Config->LoginName) == 0 &&
+	    now - authenticate_cache.LoginTime < (uint64_t)Config->LoginCredRefresh * 1000000)
+	{
+		return GLOBUS_SUCCESS;
+	}
+
+	login = strdup(Config->LoginName);
+	if (!login)
+		return GlobusGFSErrorMemory("login name");
+
 	/* Now log into HPSS using our configured 'super user' */
-	retval = hpss_SetLoginCred(LoginName,
-	                           api_config.AuthnMech,
+	retval = hpss_SetLoginCred(Config->LoginName,
+	                           authenticate_cache.AuthnMech,
 	                           hpss_rpc_cred_client,
-	                           auth_type,
-	                           authenticator);
+	                           authenticate_cache.AuthType,
+	                           authenticate_cache.ParsedAuthenticator);
 	if (retval != HPSS_E_NOERROR)
+	{
+		free(login);
 		return GlobusGFSErrorSystemError("hpss_SetLoginCred()", -retval);
+	}
+
+	free(authenticate_cache.LoginName);
+	authenticate_cache.LoginName = login;
+	authenticate_cache.LoginTime = now;
+
+	return GLOBUS_SUCCESS;
+}
+
+globus_result_t
+authenticate_prepare(config_t * Config)
+{
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	pthread_mutex_lock(&authenticate_lock);
+	{
+		result = authenticate_parse(Config);
+	}
+	pthread_mutex_unlock(&authenticate_lock);
+
+	return result;
+}
+
+globus_result_t
+authenticate(config_t * Config, char * UserName)
+{
+	int             uid    = -1;
+	int             retval = 0;
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(authenticate);
+
+	pthread_mutex_lock(&authenticate_lock);
+	{
+		result = authenticate_parse(Config);
+		if (!result)
+			result = authenticate_login(Config);
+	}
+	pthread_mutex_unlock(&authenticate_lock);
 
+	if (result)
+		return result;
 
-	result = authenticate_get_uid(UserName, &uid);
+	result = idcache_get_uid(UserName, &uid);
 	if (result) return result;
 
 	/*
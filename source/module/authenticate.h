@@ -46,10 +46,25 @@
  */
 #include <globus_gridftp_server.h>
 
+/*
+ * Local includes
+ */
+#include "config.h"
+
+/*
+ * Parses the configured authenticator (reading the keytab, if any) without
+ * logging in. Safe to call before fork(); the result is reused by
+ * authenticate().
+ */
+globus_result_t
+authenticate_prepare(config_t * Config);
+
+/*
+ * Logs in as Config->LoginName, reusing this process's existing login when
+ * it is younger than Config->LoginCredRefresh, then switches the default
+ * thread state to UserName.
+ */
 globus_result_t
-authenticate(char * LoginName,
-             char * AuthenticationMech,
-             char * Authenticator,
-             char * UserName);
+authenticate(config_t * Config, char * UserName);
 
 #endif /* HPSS_DSI_AUTHENTICATE_H */
@@ -0,0 +1,529 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/* For strptime() and timegm(). */
+#define _GNU_SOURCE
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "batch.h"
+#include "commands.h"
+#include "rpcstats.h"
+
+enum {
+	BATCH_ITEM_WAITING = 0,
+	BATCH_ITEM_RUNNING,
+	BATCH_ITEM_DONE,
+};
+
+typedef struct {
+	char                      * Op;
+	char                      * Path;   // Base joined with the item's path
+	int                         State;
+	globus_gfs_command_info_t   CommandInfo;
+	globus_result_t             Result;
+} batch_item_t;
+
+typedef struct {
+	pthread_mutex_t          Lock;
+	pthread_cond_t           Cond;     // Signalled as each item finishes
+	int                      Workers;  // References held by batch_worker()s
+	globus_gfs_operation_t   Operation;
+	config_t               * Config;
+	commands_callback        Callback;
+	int                      Count;
+	batch_item_t             Items[BATCH_MAX_ITEMS];
+} batch_t;
+
+static struct {
+	const char * Op;
+	int          Command;
+	int          HasArg;
+} batch_ops[] = {
+	{"mkdir", GLOBUS_GFS_CMD_MKD,        0},
+	{"rmdir", GLOBUS_GFS_CMD_RMD,        0},
+	{"dele",  GLOBUS_GFS_CMD_DELE,       0},
+	{"chmod", GLOBUS_GFS_CMD_SITE_CHMOD, 1},
+	{"chgrp", GLOBUS_GFS_CMD_SITE_CHGRP, 1},
+	{"utime", GLOBUS_GFS_CMD_SITE_UTIME, 1},
+};
+
+#define BATCH_OPS_COUNT (sizeof(batch_ops)/sizeof(batch_ops[0]))
+
+static int
+batch_hex_value(char Hex)
+{
+	if (Hex >= '0' && Hex <= '9')
+		return Hex - '0';
+	if (Hex >= 'a' && Hex <= 'f')
+		return Hex - 'a' + 10;
+	if (Hex >= 'A' && Hex <= 'F')
+		return Hex - 'A' + 10;
+	return -1;
+}
+
+/* Decodes %XX escapes in place. Returns non zero on a malformed escape. */
+static int
+batch_decode_path(char * Path)
+{
+	char * in  = Path;
+	char * out = Path;
+	int    hi  = 0;
+	int    lo  = 0;
+
+	while (*in)
+	{
+		if (*in != '%')
+		{
+			*out++ = *in++;
+			continue;
+		}
+
+		hi = batch_hex_value(in[1]);
+		lo = hi < 0 ? -1 : batch_hex_value(in[2]);
+		if (hi < 0 || lo < 0 || (hi == 0 && lo == 0))
+			return 1;
+
+		*out++ = (hi << 4) | lo;
+		in += 3;
+	}
+	*out = '\0';
+	return 0;
+}
+
+/*
+ * Returns non zero unless Path is relative and free of empty, '.' and '..'
+ * components, so that joined to the base it names something beneath it.
+ */
+static int
+batch_check_path(char * Path)
+{
+	char * component = Path;
+	char * end       = NULL;
+	size_t length    = 0;
+
+	if (*Path == '/')
+		return 1;
+
+	while (1)
+	{
+		end    = strchr(component, '/');
+		length = end ? end - component : strlen(component);
+
+		if (length == 0 ||
+		    (length == 1 && component[0] == '.') ||
+		    (length == 2 && component[0] == '.' && component[1] == '.'))
+		{
+			return 1;
+		}
+
+		if (!end)
+			return 0;
+		component = end + 1;
+	}
+}
+
+/*
+ * Splits op:arg:path in place and fills in the item's command info the way
+ * the server would for the equivalent single command. path is taken
+ * relative to Base, the command's own (server checked) path.
+ */
+static globus_result_t
+batch_parse_item(char * Item, char * Base, batch_item_t * BatchItem)
+{
+	char      * arg    = NULL;
+	char      * path   = NULL;
+	char      * endptr = NULL;
+	int         i      = 0;
+	struct tm   tm;
+
+	GlobusGFSName(batch_parse_item);
+
+	memset(BatchItem, 0, sizeof(batch_item_t));
+	BatchItem->Op    = Item;
+	BatchItem->State = BATCH_ITEM_DONE; // Until it parses
+
+	arg = strchr(Item, ':');
+	if (!arg)
+		return GlobusGFSErrorGeneric("Batch item is not op:arg:path");
+	*arg++ = '\0';
+
+	path = strchr(arg, ':');
+	if (!path)
+		return GlobusGFSErrorGeneric("Batch item is not op:arg:path");
+	*path++ = '\0';
+
+	for (i = 0; i < BATCH_OPS_COUNT; i++)
+	{
+		if (strcasecmp(Item, batch_ops[i].Op) == 0)
+			break;
+	}
+	if (i == BATCH_OPS_COUNT)
+		return GlobusGFSErrorGeneric("Unknown batch op");
+
+	if (batch_ops[i].HasArg != (*arg != '\0'))
+		return GlobusGFSErrorGeneric("Wrong argument for batch op");
+
+	/* Checked after decoding so an encoded '/' can't sneak in a '..'. */
+	if (batch_decode_path(path) || batch_check_path(path))
+		return GlobusGFSErrorGeneric("Batch paths must be relative to the base, without . or .., and percent encoded");
+
+	BatchItem->Path = globus_common_create_string("%s%s%s",
+	                                              Base,
+	                                              Base[strlen(Base) - 1] == '/' ? "" : "/",
+	                                              path);
+	if (!BatchItem->Path)
+		return GlobusGFSErrorMemory("batch path");
+
+	BatchItem->CommandInfo.command  = batch_ops[i].Command;
+	BatchItem->CommandInfo.pathname = BatchItem->Path;
+
+	switch (batch_ops[i].Command)
+	{
+	case GLOBUS_GFS_CMD_SITE_CHMOD:
+		BatchItem->CommandInfo.chmod_mode = strtol(arg, &endptr, 8);
+		if (*endptr != '\0')
+			return GlobusGFSErrorGeneric("Illegal mode");
+		break;
+
+	case GLOBUS_GFS_CMD_SITE_CHGRP:
+		BatchItem->CommandInfo.chgrp_group = arg;
+		break;
+
+	case GLOBUS_GFS_CMD_SITE_UTIME:
+		memset(&tm, 0, sizeof(tm));
+		endptr = strptime(arg, "%Y%m%d%H%M%S", &tm);
+		if (!endptr || *endptr != '\0')
+			return GlobusGFSErrorGeneric("Illegal time");
+		BatchItem->CommandInfo.utime_time = timegm(&tm);
+		break;
+	}
+
+	BatchItem->State = BATCH_ITEM_WAITING;
+	return GLOBUS_SUCCESS;
+}
+
+/* Returns 1 if A and B are the same path or one is beneath the other. */
+static int
+batch_paths_related(const char * A, const char * B)
+{
+	size_t a_length = strlen(A);
+	size_t b_length = strlen(B);
+
+	if (a_length > b_length)
+		return batch_paths_related(B, A);
+
+	return (strncmp(A, B, a_length) == 0 && (B[a_length] == '\0' || B[a_length] == '/'));
+}
+
+/*
+ * Call with the batch locked. Returns the first waiting item that no
+ * unfinished earlier item touches the path (or an ancestor or descendant)
+ * of, or -1. *Waiting is set if any item has yet to start.
+ */
+static int
+batch_next_item(batch_t * Batch, int * Waiting)
+{
+	int i = 0;
+	int j = 0;
+
+	*Waiting = 0;
+
+	for (i = 0; i < Batch->Count; i++)
+	{
+		if (Batch->Items[i].State != BATCH_ITEM_WAITING)
+			continue;
+		*Waiting = 1;
+
+		for (j = 0; j < i; j++)
+		{
+			if (Batch->Items[j].State != BATCH_ITEM_DONE &&
+			    batch_paths_related(Batch->Items[j].Path, Batch->Items[i].Path))
+			{
+				break;
+			}
+		}
+
+		if (j == i)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Items run in the order given except that unrelated paths may overlap,
+ * so 'mkdir::a mkdir::a/b' or 'mkdir::a chmod:755:a' behave as if run one
+ * after the other while a run of utimes on different files is spread out.
+ */
+static void
+batch_run_items(batch_t * Batch)
+{
+	int             index   = 0;
+	int             waiting = 0;
+	globus_result_t result  = GLOBUS_SUCCESS;
+
+	pthread_mutex_lock(&Batch->Lock);
+	while (1)
+	{
+		index = batch_next_item(Batch, &waiting);
+		if (index < 0)
+		{
+			if (!waiting)
+				break;
+			pthread_cond_wait(&Batch->Cond, &Batch->Lock);
+			continue;
+		}
+
+		Batch->Items[index].State = BATCH_ITEM_RUNNING;
+		pthread_mutex_unlock(&Batch->Lock);
+
+		result = commands_execute(&Batch->Items[index].CommandInfo, Batch->Config);
+
+		pthread_mutex_lock(&Batch->Lock);
+		Batch->Items[index].Result = result;
+		Batch->Items[index].State  = BATCH_ITEM_DONE;
+		pthread_cond_broadcast(&Batch->Cond);
+	}
+	pthread_mutex_unlock(&Batch->Lock);
+}
+
+/*
+ * Returns a single line description of Result and releases the error.
+ */
+static char *
+batch_result_string(globus_result_t Result)
+{
+	char * message = NULL;
+	char * c       = NULL;
+
+	if (Result == GLOBUS_SUCCESS)
+		return globus_libc_strdup("OK");
+
+	message = globus_error_print_friendly(globus_error_peek(Result));
+	globus_object_free(globus_error_get(Result));
+
+	if (!message)
+		return globus_libc_strdup("Failed");
+
+	for (c = message; *c; c++)
+	{
+		if (*c == '\r' || *c == '\n')
+			*c = ' ';
+	}
+	return message;
+}
+
+/* Replies with the status of each item and frees the batch. */
+static void
+batch_finish(batch_t * Batch)
+{
+	int               i              = 0;
+	int               failures       = 0;
+	char            * status         = NULL;
+	char            * command_output = NULL;
+	char            * tmp            = NULL;
+	globus_result_t   result         = GLOBUS_SUCCESS;
+
+	GlobusGFSName(batch_finish);
+
+	/* One reply, one line per item, in the order given. */
+	command_output = globus_libc_strdup("");
+	for (i = 0; i < Batch->Count && command_output; i++)
+	{
+		if (Batch->Items[i].Result != GLOBUS_SUCCESS)
+			failures++;
+
+		status = batch_result_string(Batch->Items[i].Result);
+		tmp = globus_common_create_string("%s250-%d %s %s\r\n",
+		                                  command_output,
+		                                  i + 1,
+		                                  Batch->Items[i].Op,
+		                                  status ? status : "Failed");
+		if (status)
+			free(status);
+		globus_free(command_output);
+		command_output = tmp;
+	}
+
+	if (command_output)
+	{
+		tmp = globus_common_create_string("%s250 %d items, %d failed.\r\n",
+		                                  command_output,
+		                                  Batch->Count,
+		                                  failures);
+		globus_free(command_output);
+		command_output = tmp;
+	}
+
+	if (!command_output)
+		result = GlobusGFSErrorMemory("batch reply");
+
+	Batch->Callback(Batch->Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+
+	for (i = 0; i < Batch->Count; i++)
+	{
+		if (Batch->Items[i].Path)
+			globus_free(Batch->Items[i].Path);
+	}
+	pthread_cond_destroy(&Batch->Cond);
+	pthread_mutex_destroy(&Batch->Lock);
+	free(Batch);
+}
+
+/* Drops a reference to the batch; the last one out replies. */
+static void
+batch_release(batch_t * Batch)
+{
+	int workers = 0;
+
+	pthread_mutex_lock(&Batch->Lock);
+	workers = --Batch->Workers;
+	pthread_mutex_unlock(&Batch->Lock);
+
+	if (workers == 0)
+		batch_finish(Batch);
+}
+
+/* Command pool job. */
+static void
+batch_worker(void * Arg)
+{
+	batch_t * batch = Arg;
+
+	rpcstats_set_op(RPCSTATS_OP_COMMAND);
+	batch_run_items(batch);
+	batch_release(batch);
+}
+
+void
+batch(globus_gfs_operation_t      Operation,
+      globus_gfs_command_info_t * CommandInfo,
+      config_t                  * Config,
+      commands_callback           Callback)
+{
+	int               i         = 0;
+	int               submitted = 0;
+	char           ** argv      = NULL;
+	int               argc      = 0;
+	batch_t         * batch     = NULL;
+	globus_result_t   result    = GLOBUS_SUCCESS;
+
+	GlobusGFSName(batch);
+
+	/* Get the command arguments. */
+	result = globus_gridftp_server_query_op_info(Operation,
+	                                             CommandInfo->op_info,
+	                                             GLOBUS_GFS_OP_INFO_CMD_ARGS,
+	                                             &argv,
+	                                             &argc);
+	if (result)
+		return Callback(Operation, GlobusGFSErrorWrapFailed("Unable to get command args", result), NULL);
+
+	/* The last argument is the base directory, CommandInfo->pathname. */
+	if (argc - 3 > BATCH_MAX_ITEMS)
+		return Callback(Operation, GlobusGFSErrorGeneric("Too many batch items"), NULL);
+
+	batch = malloc(sizeof(batch_t));
+	if (!batch)
+		return Callback(Operation, GlobusGFSErrorMemory("batch_t"), NULL);
+
+	pthread_mutex_init(&batch->Lock, NULL);
+	pthread_cond_init(&batch->Cond, NULL);
+	batch->Workers   = 1; // Ours, until the workers are queued
+	batch->Operation = Operation;
+	batch->Config    = Config;
+	batch->Callback  = Callback;
+	batch->Count     = 0;
+
+	/*
+	 * A bad item fails on its own; the rest of the batch still runs. Items
+	 * are parsed in place so argv must outlive the batch, which it does
+	 * until we reply.
+	 */
+	for (i = 2; i < argc - 1; i++)
+	{
+		result = batch_parse_item(argv[i], CommandInfo->pathname, &batch->Items[batch->Count]);
+		batch->Items[batch->Count].Result = result;
+		batch->Count++;
+	}
+
+	/*
+	 * The items run on the command pool so that the callback thread is
+	 * free. If the pool is off or backed up, run them here.
+	 */
+	for (i = 0; i < BATCH_THREADS && i < batch->Count; i++)
+	{
+		pthread_mutex_lock(&batch->Lock);
+		batch->Workers++;
+		pthread_mutex_unlock(&batch->Lock);
+
+		if (commands_submit(batch_worker, batch) != GLOBUS_SUCCESS)
+		{
+			pthread_mutex_lock(&batch->Lock);
+			batch->Workers--;
+			pthread_mutex_unlock(&batch->Lock);
+			break;
+		}
+		submitted++;
+	}
+
+	if (submitted == 0)
+		batch_run_items(batch);
+
+	batch_release(batch);
+}
@@ -0,0 +1,86 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_BATCH_H
+#define HPSS_DSI_BATCH_H
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "commands.h"
+#include "config.h"
+
+/* Most items accepted in one SITE BATCH. */
+#define BATCH_MAX_ITEMS 64
+
+/* Command pool threads one SITE BATCH runs its items on. */
+#define BATCH_THREADS 8
+
+/*
+ * SITE BATCH <sp> item [<sp> item ...] <sp> base
+ *
+ * Runs up to BATCH_MAX_ITEMS namespace operations in one round trip, ie the
+ * UTIME/CHMOD/CHGRP that follow each file of a 'preserve' transfer. Each
+ * item is op:arg:path where op is one of mkdir, rmdir, dele, chmod (arg is
+ * the octal mode), chgrp (arg is a group name or gid) or utime (arg is
+ * YYYYMMDDHHMMSS, UTC). arg is empty for ops that take none. path is
+ * relative to base, may not contain '.' or '..' components and is percent
+ * encoded (%20 for a space, %3A for ':', %25 for '%').
+ *
+ * The server applies its path restrictions and access checks to base, as
+ * for writing to it; items can only name paths beneath it. Items on the
+ * same path, or one beneath another, run in the order given. Items run on
+ * the command pool and the reply is sent from there.
+ *
+ * The reply carries one line per item, in order, with its status. Only
+ * registered when BatchCommandSupport is on.
+ */
+void
+batch(globus_gfs_operation_t      Operation,
+      globus_gfs_command_info_t * CommandInfo,
+      config_t                  * Config,
+      commands_callback           Callback);
+
+#endif /* HPSS_DSI_BATCH_H */
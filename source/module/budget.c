@@ -0,0 +1,387 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "budget.h"
+
+/*
+ * Each process accounts for its reservations in its own slot so that a
+ * session that dies without cleaning up only leaks until its slot is
+ * reclaimed. Pid is 0 for a free slot and -1 while a slot is reclaimed.
+ */
+typedef struct {
+	volatile pid_t   Pid;
+	volatile int64_t Bytes;
+	volatile int32_t Transfers;
+} budget_slot_t;
+
+typedef struct {
+	volatile int64_t  Peak;
+	volatile uint64_t Denied;
+	volatile uint64_t Forced;
+	budget_slot_t     Slots[BUDGET_SLOTS];
+} budget_table_t;
+
+static pthread_mutex_t   budget_lock    = PTHREAD_MUTEX_INITIALIZER;
+static budget_table_t  * budget_table   = NULL;
+static budget_slot_t   * budget_slot    = NULL;
+static pid_t             budget_pid     = 0;
+static int64_t           budget_limit   = 0;
+static int               budget_shared  = 0;
+static budget_reclaim_t  budget_reclaim = NULL;
+
+static budget_table_t *
+budget_map_shared()
+{
+	int         fd    = -1;
+	void      * table = NULL;
+	struct stat stat_buf;
+
+	fd = shm_open(BUDGET_SHM_NAME, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+	if (fd < 0)
+		return NULL;
+
+	/* Others could fill the slots and starve every transfer on the host. */
+	if (fstat(fd, &stat_buf) || stat_buf.st_uid != geteuid() || (stat_buf.st_mode & (S_IRWXG|S_IRWXO)))
+	{
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "Shared buffer budget %s is not owned by us with mode 0600\n",
+		                       BUDGET_SHM_NAME);
+		close(fd);
+		return NULL;
+	}
+
+	/* A zero filled table is a valid empty one so racing creators are harmless. */
+	if (ftruncate(fd, sizeof(budget_table_t)) == 0)
+		table = mmap(NULL, sizeof(budget_table_t), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return (table == MAP_FAILED) ? NULL : table;
+}
+
+/* Frees the slots of sessions that exited without releasing them. */
+static void
+budget_reclaim_slots()
+{
+	int   i   = 0;
+	pid_t pid = 0;
+
+	for (i = 0; i < BUDGET_SLOTS; i++)
+	{
+		pid = budget_table->Slots[i].Pid;
+		if (pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH)
+			continue;
+
+		/* Only the winner clears it. */
+		if (!__sync_bool_compare_and_swap(&budget_table->Slots[i].Pid, pid, -1))
+			continue;
+
+		budget_table->Slots[i].Bytes     = 0;
+		budget_table->Slots[i].Transfers = 0;
+		__sync_synchronize();
+		budget_table->Slots[i].Pid = 0;
+	}
+}
+
+/* Returns this process's slot, claiming one after a fork. NULL if none. */
+static budget_slot_t *
+budget_get_slot()
+{
+	int   i   = 0;
+	pid_t pid = getpid();
+
+	if (!budget_table)
+		return NULL;
+
+	if (budget_pid == pid)
+		return budget_slot;
+
+	pthread_mutex_lock(&budget_lock);
+	{
+		if (budget_pid != pid)
+		{
+			/* A private table copied by fork() describes our parent. */
+			if (!budget_shared)
+				memset(budget_table, 0, sizeof(budget_table_t));
+
+			budget_slot = NULL;
+			for (i = 0; i < BUDGET_SLOTS && !budget_slot; i++)
+			{
+				if (__sync_bool_compare_and_swap(&budget_table->Slots[i].Pid, 0, pid))
+					budget_slot = &budget_table->Slots[i];
+			}
+
+			if (!budget_slot)
+				globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+				                       "No free buffer budget slots, buffers are not limited\n");
+			budget_pid = pid;
+		}
+	}
+	pthread_mutex_unlock(&budget_lock);
+
+	return budget_slot;
+}
+
+static void
+budget_sum(int64_t * InUse, int * Transfers)
+{
+	int i = 0;
+
+	*InUse     = 0;
+	*Transfers = 0;
+
+	for (i = 0; i < BUDGET_SLOTS; i++)
+	{
+		if (budget_table->Slots[i].Pid <= 0)
+			continue;
+
+		*InUse     += budget_table->Slots[i].Bytes;
+		*Transfers += budget_table->Slots[i].Transfers;
+	}
+}
+
+static int64_t
+budget_share(int Transfers)
+{
+	return budget_limit / (Transfers > 0 ? Transfers : 1);
+}
+
+/* Returns 1 if reserving Bytes for Budget would break the limit or its share. */
+static int
+budget_over(budget_t * Budget, int64_t Bytes, int64_t InUse, int Transfers)
+{
+	return (InUse + Bytes > budget_limit ||
+	        (Budget->Joined && Budget->Held + Bytes > budget_share(Transfers)));
+}
+
+globus_result_t
+budget_init(config_t * Config)
+{
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(budget_init);
+
+	pthread_mutex_lock(&budget_lock);
+	{
+		budget_limit = (int64_t)Config->BufferMemoryLimit * 1024 * 1024;
+
+		if (!budget_table)
+		{
+			if (Config->BufferMemoryShared)
+			{
+				budget_table = budget_map_shared();
+				if (budget_table)
+					budget_shared = 1;
+				else
+					globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+					                       "Unable to map shared buffer budget, using a process wide one\n");
+			}
+
+			if (!budget_table)
+			{
+				budget_table = calloc(1, sizeof(budget_table_t));
+				if (!budget_table)
+					result = GlobusGFSErrorMemory("budget_table_t");
+			}
+		}
+
+		if (budget_shared)
+			budget_reclaim_slots();
+	}
+	pthread_mutex_unlock(&budget_lock);
+
+	return result;
+}
+
+void
+budget_join(budget_t * Budget)
+{
+	budget_slot_t * slot = budget_get_slot();
+
+	if (!slot || Budget->Joined)
+		return;
+
+	__sync_fetch_and_add(&slot->Transfers, 1);
+	Budget->Joined = 1;
+}
+
+int
+budget_reserve(budget_t * Budget, int64_t Bytes, int Force)
+{
+	int             transfers = 0;
+	int64_t         in_use    = 0;
+	int64_t         peak      = 0;
+	budget_slot_t * slot      = budget_get_slot();
+
+	if (!slot)
+		return 1;
+
+	budget_sum(&in_use, &transfers);
+
+	/*
+	 * Racing reservations can overshoot the limit a little; it bounds
+	 * memory, it does not need to be exact.
+	 */
+	if (budget_limit > 0)
+	{
+		/* Idle memory elsewhere in this process may cover it. */
+		if (in_use + Bytes > budget_limit && budget_reclaim && budget_reclaim() > 0)
+			budget_sum(&in_use, &transfers);
+
+		if (budget_over(Budget, Bytes, in_use, transfers))
+		{
+			if (!Force)
+			{
+				__sync_fetch_and_add(&budget_table->Denied, 1);
+				return 0;
+			}
+			__sync_fetch_and_add(&budget_table->Forced, 1);
+		}
+	}
+
+	__sync_fetch_and_add(&slot->Bytes, Bytes);
+	Budget->Held += Bytes;
+
+	in_use += Bytes;
+	while ((peak = budget_table->Peak) < in_use)
+	{
+		if (__sync_bool_compare_and_swap(&budget_table->Peak, peak, in_use))
+			break;
+	}
+
+	return 1;
+}
+
+void
+budget_hold(budget_t * Budget, int64_t Bytes)
+{
+	budget_slot_t * slot = budget_get_slot();
+
+	if (!slot)
+		return;
+
+	__sync_fetch_and_add(&slot->Bytes, Bytes);
+	Budget->Held += Bytes;
+}
+
+void
+budget_release(budget_t * Budget, int64_t Bytes)
+{
+	budget_slot_t * slot = budget_get_slot();
+
+	if (!slot)
+		return;
+
+	__sync_fetch_and_sub(&slot->Bytes, Bytes);
+	Budget->Held -= Bytes;
+}
+
+int
+budget_over_share(budget_t * Budget)
+{
+	int     transfers = 0;
+	int64_t in_use    = 0;
+
+	if (!budget_get_slot() || budget_limit <= 0 || !Budget->Joined)
+		return 0;
+
+	budget_sum(&in_use, &transfers);
+	return (Budget->Held > budget_share(transfers));
+}
+
+void
+budget_leave(budget_t * Budget)
+{
+	budget_slot_t * slot = budget_get_slot();
+
+	if (!slot)
+		return;
+
+	if (Budget->Held)
+		budget_release(Budget, Budget->Held);
+
+	if (Budget->Joined)
+		__sync_fetch_and_sub(&slot->Transfers, 1);
+	Budget->Joined = 0;
+}
+
+void
+budget_get_stats(budget_stats_t * Stats)
+{
+	memset(Stats, 0, sizeof(budget_stats_t));
+
+	Stats->Limit  = budget_limit;
+	Stats->Shared = budget_shared;
+
+	if (!budget_table)
+		return;
+
+	budget_sum(&Stats->InUse, &Stats->Transfers);
+	Stats->Peak   = budget_table->Peak;
+	Stats->Denied = budget_table->Denied;
+	Stats->Forced = budget_table->Forced;
+}
+
+void
+budget_set_reclaim(budget_reclaim_t Reclaim)
+{
+	budget_reclaim = Reclaim;
+}
@@ -0,0 +1,141 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_BUDGET_H
+#define HPSS_DSI_BUDGET_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "config.h"
+
+/* Name of the shared memory table when BufferMemoryShared is on. */
+#define BUDGET_SHM_NAME "/hpss_dsi_budget"
+
+/* Processes that can share the table. */
+#define BUDGET_SLOTS 1024
+
+/*
+ * Per transfer share of the buffer budget. Zero it before use. Only the
+ * PIO thread (and the transfer's start and end) touch it.
+ */
+typedef struct {
+	int     Joined;
+	int64_t Held; // Bytes reserved by this transfer
+} budget_t;
+
+typedef struct {
+	int64_t  Limit;     // Bytes; 0 is no limit
+	int64_t  InUse;
+	int64_t  Peak;
+	int      Transfers;
+	int      Shared;
+	uint64_t Denied;    // Reservations turned down
+	uint64_t Forced;    // Granted over the limit so a transfer could progress
+} budget_stats_t;
+
+/*
+ * Sets up accounting of transfer buffer memory. Reservations are limited
+ * to Config->BufferMemoryLimit MB in total, 0 for no limit. With
+ * Config->BufferMemoryShared the accounting lives in shared memory so the
+ * limit applies to all sessions on the host. Falls back to a process wide
+ * budget if the shared one can not be mapped or is not owned by us with
+ * mode 0600.
+ */
+globus_result_t
+budget_init(config_t * Config);
+
+/* Counts Budget as an active transfer for fair shares. */
+void
+budget_join(budget_t * Budget);
+
+/*
+ * Reserves Bytes if that keeps both the total within the limit and the
+ * transfer within its fair share (the limit over active transfers).
+ * Returns 1 if granted. With Force the reservation is always granted;
+ * callers force when they have nothing in flight so that they degrade to
+ * one buffer rather than stall.
+ */
+int
+budget_reserve(budget_t * Budget, int64_t Bytes, int Force);
+
+/*
+ * Accounts Bytes to Budget without checking the limit, reclaiming or
+ * counting toward Forced and Peak. For memory that already exists and is
+ * only changing hands, so it is safe to call with the reclaim hook's locks
+ * held.
+ */
+void
+budget_hold(budget_t * Budget, int64_t Bytes);
+
+void
+budget_release(budget_t * Budget, int64_t Bytes);
+
+/* Returns 1 if Budget holds more than its fair share. */
+int
+budget_over_share(budget_t * Budget);
+
+/* Releases what Budget still holds and stops counting it. */
+void
+budget_leave(budget_t * Budget);
+
+void
+budget_get_stats(budget_stats_t * Stats);
+
+/*
+ * Called when a reservation would be denied, before denying it. Returns
+ * the bytes it gave back.
+ */
+typedef int64_t (*budget_reclaim_t)();
+
+void
+budget_set_reclaim(budget_reclaim_t Reclaim);
+
+#endif /* HPSS_DSI_BUDGET_H */
@@ -0,0 +1,268 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "budget.h"
+#include "bufpool.h"
+#include "placement.h"
+
+/*
+ * Idle buffers are kept on a stack, most recently used first, so the
+ * oldest are always at the end. The links live in the idle buffers
+ * themselves.
+ */
+typedef struct bufpool_entry {
+	struct bufpool_entry * Next;
+	globus_size_t          Size;
+	time_t                 Idle; // When it was handed back
+} bufpool_entry_t;
+
+static pthread_mutex_t          bufpool_lock      = PTHREAD_MUTEX_INITIALIZER;
+static bufpool_entry_t        * bufpool_head      = NULL;
+static int                      bufpool_idle_time = 0;
+static int64_t                  bufpool_max       = 0;
+static budget_t                 bufpool_budget;   // Idle bytes
+static bufpool_stats_t          bufpool_stats;
+static pid_t                    bufpool_timer_pid = 0;
+static globus_callback_handle_t bufpool_timer;
+
+/* Caller holds bufpool_lock. Detaches *Link and everything after it. */
+static bufpool_entry_t *
+bufpool_detach(bufpool_entry_t ** Link)
+{
+	bufpool_entry_t * list  = *Link;
+	bufpool_entry_t * entry = NULL;
+
+	*Link = NULL;
+
+	for (entry = list; entry; entry = entry->Next)
+	{
+		bufpool_stats.IdleBytes -= entry->Size;
+		bufpool_stats.Trimmed++;
+		budget_release(&bufpool_budget, entry->Size);
+	}
+
+	return list;
+}
+
+static int64_t
+bufpool_free_list(bufpool_entry_t * List)
+{
+	int64_t           freed = 0;
+	bufpool_entry_t * next  = NULL;
+
+	for (; List; List = next)
+	{
+		next   = List->Next;
+		freed += List->Size;
+		placement_free((char *)List, List->Size);
+	}
+
+	return freed;
+}
+
+static void
+bufpool_trim_idle(void * UserArg)
+{
+	time_t             cutoff = time(NULL) - bufpool_idle_time;
+	bufpool_entry_t  * list   = NULL;
+	bufpool_entry_t ** link   = NULL;
+
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		link = &bufpool_head;
+		while (*link && (*link)->Idle > cutoff)
+			link = &(*link)->Next;
+
+		list = bufpool_detach(link);
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+
+	bufpool_free_list(list);
+}
+
+void
+bufpool_init(config_t * Config)
+{
+	globus_reltime_t delay;
+
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		bufpool_idle_time = Config->BufferPoolIdle;
+		bufpool_max       = (int64_t)Config->BufferPoolMax * 1024 * 1024;
+
+		if (bufpool_idle_time > 0 && bufpool_timer_pid != getpid())
+		{
+			GlobusTimeReltimeSet(delay, bufpool_idle_time, 0);
+			/* Without the timer, idle buffers are only freed under pressure. */
+			if (globus_callback_register_periodic(&bufpool_timer,
+			                                      &delay,
+			                                      &delay,
+			                                      bufpool_trim_idle,
+			                                      NULL) == GLOBUS_SUCCESS)
+			{
+				bufpool_timer_pid = getpid();
+			} else
+			{
+				globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+				                       "Unable to start the buffer pool idle timer\n");
+			}
+		}
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+
+	budget_set_reclaim(bufpool_trim);
+}
+
+char *
+bufpool_get(globus_size_t Size)
+{
+	bufpool_entry_t  * entry = NULL;
+	bufpool_entry_t ** link  = NULL;
+
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		bufpool_stats.Gets++;
+
+		link = &bufpool_head;
+		while (*link && (*link)->Size != Size)
+			link = &(*link)->Next;
+
+		entry = *link;
+		if (entry)
+		{
+			*link = entry->Next;
+			bufpool_stats.Reused++;
+			bufpool_stats.IdleBytes -= Size;
+			budget_release(&bufpool_budget, Size);
+		}
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+
+	if (entry)
+		return (char *)entry;
+
+	return placement_alloc(Size);
+}
+
+void
+bufpool_put(char * Buffer, globus_size_t Size)
+{
+	bufpool_entry_t * entry = (bufpool_entry_t *)Buffer;
+
+	if (!Buffer)
+		return;
+
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		if (bufpool_idle_time > 0                            &&
+		    Size >= sizeof(bufpool_entry_t)                  &&
+		    bufpool_stats.IdleBytes + (int64_t)Size <= bufpool_max)
+		{
+			entry->Next  = bufpool_head;
+			entry->Size  = Size;
+			entry->Idle  = time(NULL);
+			bufpool_head = entry;
+
+			bufpool_stats.IdleBytes += Size;
+			if (bufpool_stats.IdleBytes > bufpool_stats.PeakIdleBytes)
+				bufpool_stats.PeakIdleBytes = bufpool_stats.IdleBytes;
+
+			/*
+			 * The caller just released it, so this only moves the bytes.
+			 * A reservation could call bufpool_trim() and deadlock on
+			 * bufpool_lock.
+			 */
+			budget_hold(&bufpool_budget, Size);
+			entry = NULL;
+		}
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+
+	if (entry)
+		placement_free(Buffer, Size);
+}
+
+void
+bufpool_free(char * Buffer, globus_size_t Size)
+{
+	placement_free(Buffer, Size);
+}
+
+int64_t
+bufpool_trim()
+{
+	bufpool_entry_t * list = NULL;
+
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		list = bufpool_detach(&bufpool_head);
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+
+	return bufpool_free_list(list);
+}
+
+void
+bufpool_get_stats(bufpool_stats_t * Stats)
+{
+	pthread_mutex_lock(&bufpool_lock);
+	{
+		*Stats = bufpool_stats;
+	}
+	pthread_mutex_unlock(&bufpool_lock);
+}
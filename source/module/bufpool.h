@@ -0,0 +1,102 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_BUFPOOL_H
+#define HPSS_DSI_BUFPOOL_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "config.h"
+
+typedef struct {
+	uint64_t Gets;
+	uint64_t Reused;    // Gets served from the pool; allocations avoided
+	uint64_t Trimmed;   // Idle buffers freed
+	int64_t  IdleBytes;
+	int64_t  PeakIdleBytes;
+} bufpool_stats_t;
+
+/*
+ * Sets up the process wide pool of transfer buffers, shared by RETR, STOR
+ * and CKSM across the transfers of a session. Buffers idle for
+ * Config->BufferPoolIdle seconds are freed; 0 disables the pool. At most
+ * Config->BufferPoolMax MB are kept idle. Idle buffers count against the
+ * buffer budget and are given up when it runs short.
+ */
+void
+bufpool_init(config_t * Config);
+
+/*
+ * Returns a buffer of Size bytes, reusing an idle one if possible. The
+ * caller reserves Size in its budget first. NULL if out of memory.
+ */
+char *
+bufpool_get(globus_size_t Size);
+
+/*
+ * Hands Buffer back for reuse. The caller releases Size from its budget
+ * first so that the memory is not counted twice.
+ */
+void
+bufpool_put(char * Buffer, globus_size_t Size);
+
+/* Frees Buffer outright, for when memory is short. */
+void
+bufpool_free(char * Buffer, globus_size_t Size);
+
+/* Frees all idle buffers. Returns the bytes freed. */
+int64_t
+bufpool_trim();
+
+void
+bufpool_get_stats(bufpool_stats_t * Stats);
+
+#endif /* HPSS_DSI_BUFPOOL_H */
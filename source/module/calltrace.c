@@ -0,0 +1,282 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "calltrace.h"
+#include "histogram.h"
+
+int calltrace_enabled = 0;
+
+static pthread_mutex_t calltrace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+	char         * Directory;
+	const char  ** CallNames;
+	int            CallCount;
+	const char  ** OpNames;
+	int            OpCount;
+	pid_t          Pid;       // Process the file belongs to
+	int            FD;
+	uint64_t       StartTime;
+} calltrace = {
+	.FD = -1,
+};
+
+static uint32_t         calltrace_next_thread = 0;
+static __thread uint8_t calltrace_thread      = 0;
+
+int
+calltrace_init(const char  * Directory,
+               const char ** CallNames,
+               int           CallCount,
+               const char ** OpNames,
+               int           OpCount)
+{
+	char * directory = NULL;
+
+	if (Directory)
+	{
+		directory = strdup(Directory);
+		if (!directory)
+			return ENOMEM;
+	}
+
+	pthread_mutex_lock(&calltrace_lock);
+	{
+		/* Keep writing to the same file if the directory did not change. */
+		if (!directory || !calltrace.Directory || strcmp(directory, calltrace.Directory))
+		{
+			if (calltrace.FD != -1)
+				close(calltrace.FD);
+			calltrace.FD  = -1;
+			calltrace.Pid = 0;
+		}
+
+		free(calltrace.Directory);
+		calltrace.Directory = directory;
+		calltrace.CallNames = CallNames;
+		calltrace.CallCount = CallCount;
+		calltrace.OpNames   = OpNames;
+		calltrace.OpCount   = OpCount;
+		calltrace_enabled   = (directory != NULL);
+	}
+	pthread_mutex_unlock(&calltrace_lock);
+
+	return 0;
+}
+
+/* Appends a name table entry to Buffer at Length. */
+static size_t
+calltrace_add_name(char * Buffer, size_t Length, const char * Name)
+{
+	size_t name_length = strlen(Name);
+	if (name_length > 63)
+		name_length = 63;
+
+	Buffer[Length++] = name_length;
+	memcpy(Buffer + Length, Name, name_length);
+	return Length + name_length;
+}
+
+/* Call with calltrace_lock held. Writes the header and name tables. */
+static int
+calltrace_open()
+{
+	int                i;
+	int                fd;
+	size_t             length = 0;
+	char               path[1024];
+	char               buffer[sizeof(calltrace_header_t) + 256 * 64];
+	calltrace_header_t header;
+
+	/* A file inherited across fork() belongs to the parent. */
+	if (calltrace.FD != -1)
+		close(calltrace.FD);
+	calltrace.FD  = -1;
+	calltrace.Pid = getpid();
+
+	snprintf(path, sizeof(path), "%s/hpss_dsi_calls.%d.bin", calltrace.Directory, calltrace.Pid);
+
+	/* Traces hold path names; keep them private, never via a link. */
+	fd = open(path, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW|O_APPEND, 0600);
+	if (fd == -1)
+		return errno;
+
+	header.Magic     = CALLTRACE_MAGIC;
+	header.Version   = CALLTRACE_VERSION;
+	header.CallCount = calltrace.CallCount;
+	header.OpCount   = calltrace.OpCount;
+	header.Pid       = calltrace.Pid;
+	memcpy(buffer, &header, sizeof(header));
+	length = sizeof(header);
+
+	for (i = 0; i < calltrace.CallCount; i++)
+	{
+		length = calltrace_add_name(buffer, length, calltrace.CallNames[i]);
+	}
+
+	for (i = 0; i < calltrace.OpCount; i++)
+	{
+		length = calltrace_add_name(buffer, length, calltrace.OpNames[i]);
+	}
+
+	if (write(fd, buffer, length) != length)
+	{
+		close(fd);
+		unlink(path);
+		return EIO;
+	}
+
+	calltrace.FD        = fd;
+	calltrace.StartTime = histogram_now();
+	return 0;
+}
+
+static void
+calltrace_write(calltrace_record_t * Record, const char * Path)
+{
+	int      error  = 0;
+	size_t   length = sizeof(calltrace_record_t);
+	char     buffer[sizeof(calltrace_record_t) + CALLTRACE_MAX_PATH];
+	uint64_t now    = histogram_now();
+
+	if (!calltrace_thread)
+		calltrace_thread = __sync_add_and_fetch(&calltrace_next_thread, 1) % 255 + 1;
+
+	Record->Thread     = calltrace_thread;
+	Record->PathLength = Path ? strnlen(Path, CALLTRACE_MAX_PATH) : 0;
+	memset(Record->Reserved, 0, sizeof(Record->Reserved));
+
+	if (Record->PathLength)
+		memcpy(buffer + length, Path, Record->PathLength);
+	length += Record->PathLength;
+
+	pthread_mutex_lock(&calltrace_lock);
+	{
+		if (!calltrace_enabled)
+			goto unlock;
+
+		if (calltrace.Pid != getpid())
+		{
+			error = calltrace_open();
+			if (error)
+			{
+				calltrace_enabled = 0;
+				goto unlock;
+			}
+		}
+
+		/* Calls started before the file was opened start at 0. */
+		Record->Start = now - Record->Duration;
+		Record->Start = Record->Start > calltrace.StartTime ? Record->Start - calltrace.StartTime : 0;
+		memcpy(buffer, Record, sizeof(calltrace_record_t));
+
+		/* One write per record; O_APPEND keeps records whole. */
+		if (write(calltrace.FD, buffer, length) != length)
+		{
+			error = errno ? errno : EIO;
+			calltrace_enabled = 0;
+		}
+	}
+unlock:
+	pthread_mutex_unlock(&calltrace_lock);
+
+	if (error)
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "HPSS DSI call trace stopped: %s\n",
+		                       strerror(error));
+}
+
+void
+calltrace_record(int          Call,
+                 int          Op,
+                 uint64_t     StartTime,
+                 int          ReturnValue,
+                 const char * Path,
+                 uint64_t     Arg0,
+                 uint64_t     Arg1)
+{
+	calltrace_record_t record;
+
+	record.Duration = histogram_now() - StartTime;
+	record.Return   = ReturnValue;
+	record.Call     = Call;
+	record.Op       = Op;
+	record.Args[0]  = Arg0;
+	record.Args[1]  = Arg1;
+
+	calltrace_write(&record, Path);
+}
+
+void
+calltrace_operation(int Op, const char * Path, uint64_t Arg0)
+{
+	calltrace_record_t record;
+
+	if (!calltrace_enabled)
+		return;
+
+	record.Duration = 0;
+	record.Return   = 0;
+	record.Call     = CALLTRACE_OPERATION;
+	record.Op       = Op;
+	record.Args[0]  = Arg0;
+	record.Args[1]  = 0;
+
+	calltrace_write(&record, Path);
+}
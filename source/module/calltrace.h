@@ -0,0 +1,136 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_CALLTRACE_H
+#define HPSS_DSI_CALLTRACE_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Binary trace of every HPSS client call a session makes: the call, two
+ * call specific arguments, the path if it has one, return value, start and
+ * duration. It is written when CallTraceDir is set, one file per session
+ * process named <CallTraceDir>/hpss_dsi_calls.<pid>.bin, and is replayed
+ * with the mock HPSS library and hpss_dsi_bench (see source/mock/README).
+ *
+ * Calls are captured by the RPCSTATS_CALL() wrappers; rpcstats.h lists the
+ * arguments kept for each call. CALLTRACE_OPERATION records mark the start
+ * of each DSI operation so that replay can issue the same operations.
+ *
+ * The file is in native byte order:
+ *   calltrace_header_t
+ *   CallCount call names, each a uint8_t length followed by the name
+ *   OpCount operation names, in the same form
+ *   calltrace_record_t, each followed by PathLength bytes of path, to EOF
+ *
+ * Records refer to calls and operations by their index in the file's own
+ * name tables so a trace can be replayed by a build whose lists differ.
+ *
+ * This header is shared with source/mock and must only depend on libc.
+ */
+
+#define CALLTRACE_MAGIC     0x54434448 // "HDCT"
+#define CALLTRACE_VERSION   2
+#define CALLTRACE_OPERATION 0xFFFF     // Call of an operation marker
+#define CALLTRACE_MAX_PATH  4096       // Longer paths are truncated
+
+/* Args[0] of STAT operation markers. */
+#define CALLTRACE_STAT_FILE_ONLY 0x01
+#define CALLTRACE_STAT_SYMLINK   0x02
+
+typedef struct {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t CallCount;
+	uint32_t OpCount;
+	uint32_t Pid;
+} calltrace_header_t;
+
+typedef struct {
+	uint64_t Start;      // usecs since the trace was opened
+	uint64_t Args[2];    // See RPCSTATS_ARGS_*; operation markers use Args[0]
+	uint64_t Duration;   // usecs; a PIO execute can run for hours
+	int32_t  Return;
+	uint16_t Call;       // Index into the name table, or CALLTRACE_OPERATION
+	uint8_t  Op;         // Operation of the calling thread
+	uint8_t  Thread;     // Calling thread, numbered in order of first use
+	uint16_t PathLength;
+	uint16_t Reserved[3];
+} calltrace_record_t;
+
+/* Set by calltrace_init(); read on every call. */
+extern int calltrace_enabled;
+
+/*
+ * Starts (Directory != NULL) or stops tracing for this process. CallNames
+ * and OpNames must stay valid. The file is opened on the first record so
+ * that a trace started before fork() is written by each child to its own
+ * file; a process whose file already exists is not traced. Returns 0 or an
+ * errno.
+ */
+int
+calltrace_init(const char  * Directory,
+               const char ** CallNames,
+               int           CallCount,
+               const char ** OpNames,
+               int           OpCount);
+
+/* StartTime is histogram_now() when the call was made. Path may be NULL. */
+void
+calltrace_record(int          Call,
+                 int          Op,
+                 uint64_t     StartTime,
+                 int          ReturnValue,
+                 const char * Path,
+                 uint64_t     Arg0,
+                 uint64_t     Arg1);
+
+/*
+ * Marks the start of an operation. Arg0 is the allocation size for STOR,
+ * the command code for commands and the CALLTRACE_STAT_* flags for STAT.
+ * Path is the user for SESSION.
+ */
+void
+calltrace_operation(int Op, const char * Path, uint64_t Arg0);
+
+#endif /* HPSS_DSI_CALLTRACE_H */
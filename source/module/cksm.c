@@ -50,6 +50,8 @@
 #include "cksm.h"
 #include "stat.h"
 #include "pio.h"
+#include "rpcstats.h"
+#include "trace.h"
 
 int
 cksm_pio_callout(char     * Buffer,
@@ -188,20 +190,34 @@ cksm_pio_callout(char     * Buffer,
                  void     * CallbackArg)
 {
 	int           rc        = 0;
+	uint32_t      length    = *Length;
 	cksm_info_t * cksm_info = CallbackArg;
 
 	GlobusGFSName(cksm_pio_callout);
 
 assert(*Length <= cksm_info->BlockSize);
 
-	rc = MD5_Update(&cksm_info->MD5Context, Buffer, *Length);
+	/* After a PIO retry, skip what has already been summed. */
+	if (Offset < cksm_info->CurrentOffset)
+	{
+		if (Offset + length <= cksm_info->CurrentOffset)
+			return 0;
+
+		length -= cksm_info->CurrentOffset - Offset;
+		Buffer += cksm_info->CurrentOffset - Offset;
+	}
+
+	TRACE_BEGIN("md5");
+	rc = MD5_Update(&cksm_info->MD5Context, Buffer, length);
+	TRACE_END("md5");
 	if (rc != 1)
 	{
 		cksm_info->Result = GlobusGFSErrorGeneric("MD5_Update() failed");
 		return 1;
 	}
 
-	cksm_update_markers(cksm_info->Marker, *Length);
+	cksm_info->CurrentOffset += length;
+	cksm_update_markers(cksm_info->Marker, length);
 
 	return 0;
 }
@@ -238,7 +254,9 @@ cksm_transfer_complete_callback(globus_result_t Result, void * UserArg)
 	if (cksm_info->Result)
 		result = cksm_info->Result;
 
+	TRACE_BEGIN("close");
 	rc = hpss_Close(cksm_info->FileFD);
+	TRACE_END("close");
 	if (rc && !result)
 		result = GlobusGFSErrorSystemError("hpss_Close", -rc);
 
@@ -266,6 +284,8 @@ cksm_transfer_complete_callback(globus_result_t Result, void * UserArg)
 
 	free(cksm_info->Pathname);
 	free(cksm_info);
+
+	TRACE_TRANSFER_END();
 }
 
 void
@@ -283,20 +303,28 @@ cksm(globus_gfs_operation_t      Operation,
 
 	GlobusGFSName(cksm);
 
+	TRACE_TRANSFER_BEGIN("CKSM", CommandInfo->pathname);
+
 	if (CommandInfo->cksm_offset == 0 && CommandInfo->cksm_length == -1)
 	{
+		TRACE_BEGIN("get_checksum");
 		result = checksum_get_file_sum(CommandInfo->pathname, Config, &checksum_string);
+		TRACE_END("get_checksum");
 		if (result || checksum_string)
 		{
+			TRACE_TRANSFER_END();
 			Callback(Operation, result, result ? NULL : checksum_string);
 			if (checksum_string) free(checksum_string);
 			return;
 		}
 	}
 
+	TRACE_BEGIN("stat");
 	rc = hpss_Stat(CommandInfo->pathname, &hpss_stat_buf);
+	TRACE_END("stat");
 	if (rc)
 	{
+		TRACE_TRANSFER_END();
 		result = GlobusGFSErrorSystemError("hpss_Stat", -rc);
 		Callback(Operation, result, NULL);
 		return;
@@ -318,6 +346,7 @@ cksm(globus_gfs_operation_t      Operation,
 	cksm_info->RangeLength = CommandInfo->cksm_length;
 	if (cksm_info->RangeLength == -1)
 		cksm_info->RangeLength  = hpss_stat_buf.st_size - CommandInfo->cksm_offset;
+	cksm_info->CurrentOffset = CommandInfo->cksm_offset;
 
 	rc = MD5_Init(&cksm_info->MD5Context);
 	if (rc != 1)
@@ -331,9 +360,11 @@ cksm(globus_gfs_operation_t      Operation,
 	/*
 	 * Open the file.
 	 */
+	TRACE_BEGIN("open");
 	result = cksm_open_for_reading(CommandInfo->pathname,
 	                               &cksm_info->FileFD,
 	                               &file_stripe_width);
+	TRACE_END("open");
 	if (result) goto cleanup;
 
 	result = cksm_start_markers(&cksm_info->Marker, Operation);
@@ -343,6 +374,7 @@ cksm(globus_gfs_operation_t      Operation,
 	/*
 	 * Setup PIO
 	 */
+	TRACE_BEGIN("pio_start");
 	result = pio_start(HPSS_PIO_READ,
 	                   cksm_info->FileFD,
 	                   file_stripe_width,
@@ -353,10 +385,12 @@ cksm(globus_gfs_operation_t      Operation,
 	                   cksm_range_complete_callback,
 	                   cksm_transfer_complete_callback,
 	                   cksm_info);
+	TRACE_END("pio_start");
 
 cleanup:
 	if (result)
 	{
+		TRACE_TRANSFER_END();
 		if (cksm_info)
 		{
 			if (cksm_info->FileFD != -1)
@@ -80,6 +80,7 @@ typedef struct {
 	int                         FileFD;
 	globus_size_t               BlockSize;
 	globus_off_t                RangeLength;
+	globus_off_t                CurrentOffset; // Next offset to sum
 	cksm_marker_t             * Marker;
 } cksm_info_t;
 
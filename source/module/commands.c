@@ -43,8 +43,9 @@
  * System includes
  */
 #include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
-#include <grp.h>
 
 /*
  * Globus includes
@@ -59,17 +60,84 @@
 /*
  * Local includes
  */
+#include "batch.h"
+#include "budget.h"
+#include "bufpool.h"
 #include "commands.h"
 #include "config.h"
+#include "du.h"
+#include "histogram.h"
+#include "idcache.h"
+#include "journal.h"
+#include "listing.h"
+#include "pool.h"
+#include "rdel.h"
 #include "stage.h"
 #include "cksm.h"
+#include "rpcstats.h"
+
+/*
+ * Namespace commands are each a single blocking HPSS RPC (or a few). They run
+ * on this process-wide pool so that a slow core server does not hold up the
+ * server's callback thread, which also drives the data channels.
+ */
+static pthread_mutex_t commands_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pool_t        * commands_pool      = NULL;
+
+static struct {
+	int          Command;
+	const char * Name;
+	histogram_t  Latency;
+} commands_stats[] = {
+	{GLOBUS_GFS_CMD_MKD,          "MKD"},
+	{GLOBUS_GFS_CMD_RMD,          "RMD"},
+	{GLOBUS_GFS_CMD_DELE,         "DELE"},
+	{GLOBUS_GFS_CMD_RNTO,         "RNTO"},
+	{GLOBUS_GFS_CMD_SITE_CHMOD,   "SITE_CHMOD"},
+	{GLOBUS_GFS_CMD_SITE_CHGRP,   "SITE_CHGRP"},
+	{GLOBUS_GFS_CMD_SITE_UTIME,   "SITE_UTIME"},
+	{GLOBUS_GFS_CMD_SITE_SYMLINK, "SITE_SYMLINK"},
+	{GLOBUS_GFS_CMD_TRNC,         "TRNC"},
+};
+
+#define COMMANDS_STATS_COUNT (sizeof(commands_stats)/sizeof(commands_stats[0]))
+
+typedef struct {
+	globus_gfs_operation_t      Operation;
+	globus_gfs_command_info_t * CommandInfo;
+	config_t                  * Config;
+	commands_callback           Callback;
+	commands_func_t             Func;     // NULL for commands_execute()
+} commands_job_t;
+
+static globus_result_t
+commands_init_pool(config_t * Config)
+{
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	if (Config->CommandThreads == 0)
+		return GLOBUS_SUCCESS;
+
+	pthread_mutex_lock(&commands_pool_lock);
+	{
+		if (!commands_pool)
+			result = pool_init(&commands_pool, Config->CommandThreads, Config->CommandQueueDepth);
+	}
+	pthread_mutex_unlock(&commands_pool_lock);
+
+	return result;
+}
 
 globus_result_t
-commands_init(globus_gfs_operation_t Operation)
+commands_init(globus_gfs_operation_t Operation, config_t * Config)
 {
 	GlobusGFSName(commands_init);
 
-	globus_result_t result = globus_gridftp_server_add_command(
+	globus_result_t result = commands_init_pool(Config);
+	if (result != GLOBUS_SUCCESS)
+		return GlobusGFSErrorWrapFailed("Failed to start the command pool", result);
+
+	result = globus_gridftp_server_add_command(
 	                 Operation,
 	                 "SITE STAGE",
 	                 GLOBUS_GFS_HPSS_CMD_SITE_STAGE,
@@ -82,13 +150,95 @@ commands_init(globus_gfs_operation_t Operation)
 	if (result != GLOBUS_SUCCESS)
 		return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE STAGE' command", result);
 
+	result = globus_gridftp_server_add_command(
+	                 Operation,
+	                 "SITE LSFACTS",
+	                 GLOBUS_GFS_HPSS_CMD_SITE_LSFACTS,
+	                 4,
+	                 4,
+	                 "SITE LSFACTS <sp> facts <sp> path",
+	                 GLOBUS_TRUE,
+	                 GFS_ACL_ACTION_LOOKUP);
+
+	if (result != GLOBUS_SUCCESS)
+		return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE LSFACTS' command", result);
+
+	result = globus_gridftp_server_add_command(
+	                 Operation,
+	                 "SITE RLIST",
+	                 GLOBUS_GFS_HPSS_CMD_SITE_RLIST,
+	                 5,
+	                 5,
+	                 "SITE RLIST <sp> depth <sp> facts <sp> path",
+	                 GLOBUS_TRUE,
+	                 GFS_ACL_ACTION_LOOKUP);
+
+	if (result != GLOBUS_SUCCESS)
+		return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE RLIST' command", result);
+
+	result = globus_gridftp_server_add_command(
+	                 Operation,
+	                 "SITE DU",
+	                 GLOBUS_GFS_HPSS_CMD_SITE_DU,
+	                 4,
+	                 4,
+	                 "SITE DU <sp> breakdown <sp> path",
+	                 GLOBUS_TRUE,
+	                 GFS_ACL_ACTION_LOOKUP);
+
+	if (result != GLOBUS_SUCCESS)
+		return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE DU' command", result);
+
+	result = globus_gridftp_server_add_command(
+	                 Operation,
+	                 "SITE HPSSSTATS",
+	                 GLOBUS_GFS_HPSS_CMD_SITE_HPSSSTATS,
+	                 2,
+	                 2,
+	                 "SITE HPSSSTATS",
+	                 GLOBUS_FALSE,
+	                 0);
+
+	if (result != GLOBUS_SUCCESS)
+		return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE HPSSSTATS' command", result);
+
+	if (Config->BatchCommandSupport)
+	{
+		result = globus_gridftp_server_add_command(
+		                 Operation,
+		                 "SITE BATCH",
+		                 GLOBUS_GFS_HPSS_CMD_SITE_BATCH,
+		                 4,
+		                 3 + BATCH_MAX_ITEMS,
+		                 "SITE BATCH <sp> op:arg:path [<sp> op:arg:path ...] <sp> base",
+		                 GLOBUS_TRUE,
+		                 GFS_ACL_ACTION_WRITE);
+
+		if (result != GLOBUS_SUCCESS)
+			return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE BATCH' command", result);
+	}
+
+	if (Config->StorJournalSupport)
+	{
+		result = globus_gridftp_server_add_command(
+		                 Operation,
+		                 "SITE STORJOURNAL",
+		                 GLOBUS_GFS_HPSS_CMD_SITE_STORJOURNAL,
+		                 3,
+		                 3,
+		                 "SITE STORJOURNAL <sp> path",
+		                 GLOBUS_TRUE,
+		                 GFS_ACL_ACTION_LOOKUP);
+
+		if (result != GLOBUS_SUCCESS)
+			return GlobusGFSErrorWrapFailed("Failed to add custom 'SITE STORJOURNAL' command", result);
+	}
+
 	return GLOBUS_SUCCESS;
 }
 
-void
-commands_mkdir(globus_gfs_operation_t      Operation,
-               globus_gfs_command_info_t * CommandInfo,
-               commands_callback           Callback)
+static globus_result_t
+commands_mkdir(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -98,13 +248,11 @@ commands_mkdir(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Mkdir", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_rmdir(globus_gfs_operation_t      Operation,
-               globus_gfs_command_info_t * CommandInfo,
-               commands_callback           Callback)
+static globus_result_t
+commands_rmdir(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -114,13 +262,11 @@ commands_rmdir(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Rmdir", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_unlink(globus_gfs_operation_t      Operation,
-                globus_gfs_command_info_t * CommandInfo,
-                commands_callback           Callback)
+static globus_result_t
+commands_unlink(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -130,14 +276,12 @@ commands_unlink(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Unlink", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_rename(globus_gfs_operation_t      Operation,
-                globus_gfs_command_info_t * CommandInfo,
-                config_t                  * Config,
-                commands_callback           Callback)
+static globus_result_t
+commands_rename(globus_gfs_command_info_t * CommandInfo,
+                config_t                  * Config)
 {
 	int             retval = 0;
 	globus_result_t result = GLOBUS_SUCCESS;
@@ -173,13 +317,11 @@ commands_rename(globus_gfs_operation_t      Operation,
 		result = GlobusGFSErrorSystemError("hpss_Rename", -retval);
 
 cleanup:
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_chmod(globus_gfs_operation_t      Operation,
-               globus_gfs_command_info_t * CommandInfo,
-               commands_callback           Callback)
+static globus_result_t
+commands_chmod(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -189,41 +331,11 @@ commands_chmod(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Chmod", -retval);
 
-	Callback(Operation, result, NULL);
-}
-
-globus_result_t
-session_get_gid(char * GroupName, int * Gid)
-{
-    struct group * group = NULL;
-    struct group   group_buf;
-    char           buffer[1024];
-    int            retval = 0;
-
-    GlobusGFSName(session_get_gid);
-
-    /* Find the passwd entry. */
-    retval = getgrnam_r(GroupName,
-                        &group_buf,
-                        buffer,
-                        sizeof(buffer),
-                        &group);
-    if (retval != 0)
-        return GlobusGFSErrorSystemError("getgrnam_r", errno);
-
-    if (group == NULL)
-        return GlobusGFSErrorGeneric("Group not found");
-
-    /* Copy out the gid */
-    *Gid = group->gr_gid;
-
-    return GLOBUS_SUCCESS;
+	return result;
 }
 
-void
-commands_chgrp(globus_gfs_operation_t      Operation,
-               globus_gfs_command_info_t * CommandInfo,
-               commands_callback           Callback)
+static globus_result_t
+commands_chgrp(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 	int gid;
@@ -235,17 +347,15 @@ commands_chgrp(globus_gfs_operation_t      Operation,
 	if (retval)
 	{
 		result = GlobusGFSErrorSystemError("hpss_Stat", -retval);
-		Callback(Operation, result, NULL);
-		return;
+		return result;
 	}
 
 	if (!isdigit(*CommandInfo->chgrp_group))
 	{
-		result = session_get_gid(CommandInfo->chgrp_group, &gid);
+		result = idcache_get_gid(CommandInfo->chgrp_group, &gid);
 		if (result != GLOBUS_SUCCESS)
 		{
-			Callback(Operation, result, NULL);
-			return;
+			return result;
 		}
 	} else
 	{
@@ -256,13 +366,11 @@ commands_chgrp(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Chgrp", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_utime(globus_gfs_operation_t      Operation,
-               globus_gfs_command_info_t * CommandInfo,
-               commands_callback           Callback)
+static globus_result_t
+commands_utime(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -276,13 +384,11 @@ commands_utime(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Utime", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_symlink(globus_gfs_operation_t      Operation,
-                 globus_gfs_command_info_t * CommandInfo,
-                 commands_callback           Callback)
+static globus_result_t
+commands_symlink(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -292,13 +398,11 @@ commands_symlink(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Symlink", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_truncate(globus_gfs_operation_t      Operation,
-                  globus_gfs_command_info_t * CommandInfo,
-                  commands_callback           Callback)
+static globus_result_t
+commands_truncate(globus_gfs_command_info_t * CommandInfo)
 {
 	globus_result_t result = GLOBUS_SUCCESS;
 
@@ -308,46 +412,265 @@ commands_truncate(globus_gfs_operation_t      Operation,
 	if (retval)
 		result = GlobusGFSErrorSystemError("hpss_Truncate", -retval);
 
-	Callback(Operation, result, NULL);
+	return result;
 }
 
-void
-commands_run(globus_gfs_operation_t      Operation,
-             globus_gfs_command_info_t * CommandInfo,
-             config_t                  * Config,
-             commands_callback           Callback)
+/*
+ * SITE HPSSSTATS
+ *
+ * Reports the command pool's queue, the latency of each namespace
+ * command and transfer buffer memory, one intermediate reply per line.
+ */
+static void
+commands_send_rpcstats(const char * Line, void * Arg)
 {
-	GlobusGFSName(commands_run);
+	globus_gridftp_server_intermediate_command(Arg, GLOBUS_SUCCESS, (char *)Line);
+}
+
+static void
+commands_send_stats(globus_gfs_operation_t      Operation,
+                    globus_gfs_command_info_t * CommandInfo,
+                    commands_callback           Callback)
+{
+	int               i    = 0;
+	char            * line = NULL;
+	pool_stats_t      pool_stats;
+	idcache_stats_t   idcache_stats;
+	budget_stats_t    budget_stats;
+	bufpool_stats_t   bufpool_stats;
+
+	if (commands_pool)
+	{
+		pool_get_stats(commands_pool, &pool_stats);
+
+		line = globus_common_create_string("pool threads=%d busy=%d queued=%d peak=%d max=%d "
+		                                   "submitted=%"PRIu64" rejected=%"PRIu64,
+		                                   pool_stats.Threads,
+		                                   pool_stats.Busy,
+		                                   pool_stats.QueueDepth,
+		                                   pool_stats.PeakQueueDepth,
+		                                   pool_stats.MaxQueueDepth,
+		                                   pool_stats.Submitted,
+		                                   pool_stats.Rejected);
+		if (line)
+		{
+			globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+			globus_free(line);
+		}
+
+		line = histogram_format(&pool_stats.QueueWait, "queue-wait");
+		if (line)
+		{
+			globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+			globus_free(line);
+		}
+	} else
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, "pool disabled");
+	}
+
+	for (i = 0; i < COMMANDS_STATS_COUNT; i++)
+	{
+		line = histogram_format(&commands_stats[i].Latency, commands_stats[i].Name);
+		if (line)
+		{
+			globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+			globus_free(line);
+		}
+	}
+
+	idcache_get_stats(&idcache_stats);
+
+	line = globus_common_create_string("idcache hits=%"PRIu64" misses=%"PRIu64,
+	                                   idcache_stats.Hits,
+	                                   idcache_stats.Misses);
+	if (line)
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+		globus_free(line);
+	}
+
+	line = histogram_format(&idcache_stats.Lookups, "idcache-lookup");
+	if (line)
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+		globus_free(line);
+	}
+
+	budget_get_stats(&budget_stats);
+
+	line = globus_common_create_string("buffers limit=%"PRId64" inuse=%"PRId64" peak=%"PRId64" "
+	                                   "transfers=%d denied=%"PRIu64" forced=%"PRIu64" shared=%d",
+	                                   budget_stats.Limit,
+	                                   budget_stats.InUse,
+	                                   budget_stats.Peak,
+	                                   budget_stats.Transfers,
+	                                   budget_stats.Denied,
+	                                   budget_stats.Forced,
+	                                   budget_stats.Shared);
+	if (line)
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+		globus_free(line);
+	}
+
+	bufpool_get_stats(&bufpool_stats);
+
+	line = globus_common_create_string("bufpool gets=%"PRIu64" reused=%"PRIu64" trimmed=%"PRIu64" "
+	                                   "idle=%"PRId64" peak-idle=%"PRId64,
+	                                   bufpool_stats.Gets,
+	                                   bufpool_stats.Reused,
+	                                   bufpool_stats.Trimmed,
+	                                   bufpool_stats.IdleBytes,
+	                                   bufpool_stats.PeakIdleBytes);
+	if (line)
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+		globus_free(line);
+	}
+
+	rpcstats_report(commands_send_rpcstats, Operation);
+
+	Callback(Operation, GLOBUS_SUCCESS, "250 End of statistics.\r\n");
+}
+
+static int
+commands_stats_index(int Command)
+{
+	int i;
+
+	for (i = 0; i < COMMANDS_STATS_COUNT; i++)
+	{
+		if (commands_stats[i].Command == Command)
+			return i;
+	}
+	return -1;
+}
+
+globus_result_t
+commands_execute(globus_gfs_command_info_t * CommandInfo,
+                 config_t                  * Config)
+{
+	int             stats_index = 0;
+	uint64_t        start_time  = 0;
+	globus_result_t result      = GLOBUS_SUCCESS;
+
+	GlobusGFSName(commands_execute);
+
+	stats_index = commands_stats_index(CommandInfo->command);
+	if (stats_index < 0)
+		return GlobusGFSErrorGeneric("Not Supported");
+
+	start_time = histogram_now();
 
 	switch (CommandInfo->command)
 	{
 	case GLOBUS_GFS_CMD_MKD:
-		commands_mkdir(Operation, CommandInfo, Callback);
+		result = commands_mkdir(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_RMD:
-		commands_rmdir(Operation, CommandInfo, Callback);
+		result = commands_rmdir(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_DELE:
-		commands_unlink(Operation, CommandInfo, Callback);
+		result = commands_unlink(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_RNTO:
-		commands_rename(Operation, CommandInfo, Config, Callback);
-		break;
-	case GLOBUS_GFS_CMD_RNFR:
+		result = commands_rename(CommandInfo, Config);
 		break;
 	case GLOBUS_GFS_CMD_SITE_CHMOD:
-		commands_chmod(Operation, CommandInfo, Callback);
+		result = commands_chmod(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_SITE_CHGRP:
-		commands_chgrp(Operation, CommandInfo, Callback);
+		result = commands_chgrp(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_SITE_UTIME:
-		commands_utime(Operation, CommandInfo, Callback);
-		break;
-	case GLOBUS_GFS_CMD_SITE_SYMLINKFROM:
+		result = commands_utime(CommandInfo);
 		break;
 	case GLOBUS_GFS_CMD_SITE_SYMLINK:
-		commands_symlink(Operation, CommandInfo, Callback);
+		result = commands_symlink(CommandInfo);
+		break;
+	case GLOBUS_GFS_CMD_TRNC:
+		result = commands_truncate(CommandInfo);
+		break;
+	}
+
+	histogram_record(&commands_stats[stats_index].Latency, histogram_now() - start_time);
+	return result;
+}
+
+static void
+commands_run_job(void * Arg)
+{
+	commands_job_t * job    = Arg;
+	globus_result_t  result = GLOBUS_SUCCESS;
+
+	rpcstats_set_op(RPCSTATS_OP_COMMAND);
+	if (job->Func)
+	{
+		job->Func(job->Operation, job->CommandInfo, job->Config, job->Callback);
+	} else
+	{
+		result = commands_execute(job->CommandInfo, job->Config);
+		job->Callback(job->Operation, result, NULL);
+	}
+	free(job);
+}
+
+globus_result_t
+commands_submit(pool_func_t Func, void * Arg)
+{
+	GlobusGFSName(commands_submit);
+
+	if (!commands_pool)
+		return GlobusGFSErrorGeneric("The command pool is off");
+
+	return pool_submit(commands_pool, Func, Arg);
+}
+
+/* Runs Func, or commands_execute() if it is NULL, on the command pool. */
+static void
+commands_queue(globus_gfs_operation_t      Operation,
+               globus_gfs_command_info_t * CommandInfo,
+               config_t                  * Config,
+               commands_callback           Callback,
+               commands_func_t             Func)
+{
+	commands_job_t * job = NULL;
+
+	GlobusGFSName(commands_queue);
+
+	job = malloc(sizeof(commands_job_t));
+	if (!job)
+		return Callback(Operation, GlobusGFSErrorMemory("commands_job_t"), NULL);
+
+	job->Operation   = Operation;
+	job->CommandInfo = CommandInfo;
+	job->Config      = Config;
+	job->Callback    = Callback;
+	job->Func        = Func;
+
+	/*
+	 * The server allows the command to finish from another thread. If
+	 * the pool is off or backed up, fall back to running it here.
+	 */
+	if (commands_submit(commands_run_job, job) != GLOBUS_SUCCESS)
+		commands_run_job(job);
+}
+
+void
+commands_run(globus_gfs_operation_t      Operation,
+             globus_gfs_command_info_t * CommandInfo,
+             config_t                  * Config,
+             commands_callback           Callback)
+{
+	if (commands_stats_index(CommandInfo->command) >= 0)
+		return commands_queue(Operation, CommandInfo, Config, Callback, NULL);
+
+	switch (CommandInfo->command)
+	{
+	case GLOBUS_GFS_CMD_RNFR:
+		break;
+	case GLOBUS_GFS_CMD_SITE_SYMLINKFROM:
 		break;
 	case GLOBUS_GFS_CMD_CKSM:
 		cksm(Operation, CommandInfo, Config, Callback);
@@ -355,12 +678,30 @@ commands_run(globus_gfs_operation_t      Operation,
 	case GLOBUS_GFS_HPSS_CMD_SITE_STAGE:
 		stage(Operation, CommandInfo, Callback);
 		break;
-	case GLOBUS_GFS_CMD_TRNC:
-		commands_truncate(Operation, CommandInfo, Callback);
+	case GLOBUS_GFS_HPSS_CMD_SITE_LSFACTS:
+		listing(Operation, CommandInfo, Config, Callback);
+		break;
+	case GLOBUS_GFS_HPSS_CMD_SITE_RLIST:
+		commands_queue(Operation, CommandInfo, Config, Callback, listing_recursive);
+		break;
+	case GLOBUS_GFS_HPSS_CMD_SITE_DU:
+		commands_queue(Operation, CommandInfo, Config, Callback, du);
+		break;
+	case GLOBUS_GFS_HPSS_CMD_SITE_HPSSSTATS:
+		commands_send_stats(Operation, CommandInfo, Callback);
+		break;
+	case GLOBUS_GFS_HPSS_CMD_SITE_BATCH:
+		batch(Operation, CommandInfo, Config, Callback);
+		break;
+	case GLOBUS_GFS_HPSS_CMD_SITE_STORJOURNAL:
+		journal_command(Operation, CommandInfo, Config, Callback);
+		break;
+	case GLOBUS_GFS_CMD_SITE_RDEL:
+		/* Removing a large tree takes hours. */
+		commands_queue(Operation, CommandInfo, Config, Callback, rdel);
 		break;
 
 	case GLOBUS_GFS_CMD_SITE_AUTHZ_ASSERT:
-	case GLOBUS_GFS_CMD_SITE_RDEL:
 	case GLOBUS_GFS_CMD_SITE_DSI:
 	case GLOBUS_GFS_CMD_SITE_SETNETSTACK:
 	case GLOBUS_GFS_CMD_SITE_SETDISKSTACK:
@@ -50,18 +50,48 @@
  * Local includes
  */
 #include "config.h"
+#include "pool.h"
 
 enum {
 	GLOBUS_GFS_HPSS_CMD_SITE_STAGE = GLOBUS_GFS_MIN_CUSTOM_CMD,
+	GLOBUS_GFS_HPSS_CMD_SITE_LSFACTS,
+	GLOBUS_GFS_HPSS_CMD_SITE_RLIST,
+	GLOBUS_GFS_HPSS_CMD_SITE_DU,
+	GLOBUS_GFS_HPSS_CMD_SITE_HPSSSTATS,
+	GLOBUS_GFS_HPSS_CMD_SITE_BATCH,
+	GLOBUS_GFS_HPSS_CMD_SITE_STORJOURNAL,
 };
 
 globus_result_t
-commands_init(globus_gfs_operation_t Operation);
+commands_init(globus_gfs_operation_t Operation, config_t * Config);
 
 typedef void (*commands_callback)(globus_gfs_operation_t  Operation,
                                   globus_result_t         Result,
                                   char                  * CommandResponse);
 
+/*
+ * Runs one namespace command (MKD, RMD, DELE, RNTO, SITE CHMOD, SITE CHGRP,
+ * SITE UTIME, SITE SYMLINK or SITE TRNC) on the calling thread and records
+ * its latency.
+ */
+globus_result_t
+commands_execute(globus_gfs_command_info_t * CommandInfo,
+                 config_t                  * Config);
+
+/* A command that finishes by calling Callback, ie rdel(). */
+typedef void (*commands_func_t)(globus_gfs_operation_t      Operation,
+                                globus_gfs_command_info_t * CommandInfo,
+                                config_t                  * Config,
+                                commands_callback           Callback);
+
+/*
+ * Queues Func(Arg) on the command pool. Fails, without running Func, if the
+ * pool is off (CommandThreads 0) or backed up; the caller then runs it
+ * inline.
+ */
+globus_result_t
+commands_submit(pool_func_t Func, void * Arg);
+
 void
 commands_run(globus_gfs_operation_t      Operation,
              globus_gfs_command_info_t * CommandInfo,
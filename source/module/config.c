@@ -42,6 +42,9 @@
 /*
  * System includes
  */
+#include <sys/stat.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
 
 /*
@@ -218,6 +221,31 @@ config_get_bool_value(char * Value, int ValueLength)
 	return 0;
 }
 
+static globus_result_t
+config_get_int_value(char * Value, int ValueLength, int Min, int * Result)
+{
+	char * copy   = NULL;
+	char * endptr = NULL;
+	long   value  = 0;
+
+	GlobusGFSName(config_get_int_value);
+
+	copy = strndup(Value, ValueLength);
+	if (!copy)
+		return GlobusGFSErrorMemory("config value");
+
+	value = strtol(copy, &endptr, 10);
+	if (*endptr != '\0' || value < Min || value > INT_MAX)
+	{
+		free(copy);
+		return GlobusGFSErrorGeneric("Illegal numeric value");
+	}
+
+	free(copy);
+	*Result = value;
+	return GLOBUS_SUCCESS;
+}
+
 static globus_result_t
 config_parse_file(char     * ConfigFilePath,
                   config_t * Config)
@@ -281,12 +309,143 @@ config_parse_file(char     * ConfigFilePath,
 		} else if (key_length == strlen("Authenticator") && strncasecmp(key, "Authenticator", key_length) == 0)
 		{
 			Config->Authenticator = strndup(value, value_length);
+		} else if (key_length == strlen("LoginCredRefresh") && strncasecmp(key, "LoginCredRefresh", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->LoginCredRefresh);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
 		} else if (key_length == strlen("QuotaSupport") && strncasecmp(key, "QuotaSupport", key_length) == 0)
 		{
 			Config->QuotaSupport = config_get_bool_value(value, value_length);
 		} else if (key_length == strlen("UDAChecksumSupport") && strncasecmp(key, "UDAChecksumSupport", key_length) == 0)
 		{
 			Config->UDAChecksumSupport = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("ListingChecksumSupport") && strncasecmp(key, "ListingChecksumSupport", key_length) == 0)
+		{
+			Config->ListingChecksumSupport = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("BatchCommandSupport") && strncasecmp(key, "BatchCommandSupport", key_length) == 0)
+		{
+			Config->BatchCommandSupport = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("RPCStatsSupport") && strncasecmp(key, "RPCStatsSupport", key_length) == 0)
+		{
+			Config->RPCStatsSupport = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("CallTraceDir") && strncasecmp(key, "CallTraceDir", key_length) == 0)
+		{
+			Config->CallTraceDir = strndup(value, value_length);
+		} else if (key_length == strlen("PIORetries") && strncasecmp(key, "PIORetries", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->PIORetries);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("PIORetryDelay") && strncasecmp(key, "PIORetryDelay", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->PIORetryDelay);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("StorJournalSupport") && strncasecmp(key, "StorJournalSupport", key_length) == 0)
+		{
+			Config->StorJournalSupport = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("StorJournalInterval") && strncasecmp(key, "StorJournalInterval", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 1, &Config->StorJournalInterval);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("BufferMemoryLimit") && strncasecmp(key, "BufferMemoryLimit", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->BufferMemoryLimit);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("BufferMemoryShared") && strncasecmp(key, "BufferMemoryShared", key_length) == 0)
+		{
+			Config->BufferMemoryShared = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("BufferPoolIdle") && strncasecmp(key, "BufferPoolIdle", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->BufferPoolIdle);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("BufferPoolMax") && strncasecmp(key, "BufferPoolMax", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->BufferPoolMax);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("BufferHugePages") && strncasecmp(key, "BufferHugePages", key_length) == 0)
+		{
+			Config->BufferHugePages = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("BufferNUMANode") && strncasecmp(key, "BufferNUMANode", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, -1, &Config->BufferNUMANode);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("PinPIOThreads") && strncasecmp(key, "PinPIOThreads", key_length) == 0)
+		{
+			Config->PinPIOThreads = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("IDCacheTTL") && strncasecmp(key, "IDCacheTTL", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->IDCacheTTL);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("IDCacheShared") && strncasecmp(key, "IDCacheShared", key_length) == 0)
+		{
+			Config->IDCacheShared = config_get_bool_value(value, value_length);
+		} else if (key_length == strlen("WalkThreads") && strncasecmp(key, "WalkThreads", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 1, &Config->WalkThreads);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("DeleteThreads") && strncasecmp(key, "DeleteThreads", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 1, &Config->DeleteThreads);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("CommandThreads") && strncasecmp(key, "CommandThreads", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 0, &Config->CommandThreads);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
+		} else if (key_length == strlen("CommandQueueDepth") && strncasecmp(key, "CommandQueueDepth", key_length) == 0)
+		{
+			result = config_get_int_value(value, value_length, 1, &Config->CommandQueueDepth);
+			if (result)
+			{
+				result = GlobusGFSErrorWrapFailed("Parsing config options", result);
+				goto cleanup;
+			}
 		} else
 		{
 			result = GlobusGFSErrorWrapFailed("Parsing config options", GlobusGFSErrorGeneric(buffer));
@@ -336,13 +495,25 @@ config_process_env()
 	return GLOBUS_SUCCESS;
 }
 
-globus_result_t
-config_init(config_t ** Config)
+static void
+config_free(config_t * Config);
+
+/*
+ * The config is parsed once per process and shared, read only, by every
+ * session. A session holds a reference for its lifetime so a reload never
+ * changes the config out from under it.
+ */
+static pthread_mutex_t   config_lock    = PTHREAD_MUTEX_INITIALIZER;
+static config_t        * config_current = NULL;
+
+static globus_result_t
+config_load(config_t ** Config)
 {
 	char          * config_file_path = NULL;
 	globus_result_t result = GLOBUS_SUCCESS;
+	struct stat     stat_buf;
 
-	GlobusGFSName(config_init);
+	GlobusGFSName(config_load);
 
 	*Config = NULL;
 
@@ -359,35 +530,130 @@ config_init(config_t ** Config)
 		goto cleanup;
 	}
 	memset(*Config, 0, sizeof(config_t));
+	(*Config)->WalkThreads         = DEFAULT_WALK_THREADS;
+	(*Config)->DeleteThreads       = DEFAULT_DELETE_THREADS;
+	(*Config)->CommandThreads      = DEFAULT_COMMAND_THREADS;
+	(*Config)->CommandQueueDepth   = DEFAULT_COMMAND_QUEUE_DEPTH;
+	(*Config)->IDCacheTTL          = DEFAULT_IDCACHE_TTL;
+	(*Config)->LoginCredRefresh    = DEFAULT_LOGIN_CRED_REFRESH;
+	(*Config)->PIORetries          = DEFAULT_PIO_RETRIES;
+	(*Config)->PIORetryDelay       = DEFAULT_PIO_RETRY_DELAY;
+	(*Config)->StorJournalInterval = DEFAULT_STOR_JOURNAL_INTERVAL;
+	(*Config)->BufferPoolIdle      = DEFAULT_BUFFER_POOL_IDLE;
+	(*Config)->BufferPoolMax       = DEFAULT_BUFFER_POOL_MAX;
+	(*Config)->BufferNUMANode      = DEFAULT_BUFFER_NUMA_NODE;
+	(*Config)->RefCount            = 1;
+
+	/* Take the file's identity before reading so a racing edit forces a reload. */
+	if (stat(config_file_path, &stat_buf))
+	{
+		result = GlobusGFSErrorSystemError("stat() of config file", errno);
+		goto cleanup;
+	}
+	(*Config)->FileIno   = stat_buf.st_ino;
+	(*Config)->FileMTime = stat_buf.st_mtime;
+	(*Config)->FileSize  = stat_buf.st_size;
 
 	result = config_parse_file(config_file_path, *Config);
 	if (result)
 		goto cleanup;
 
 	result = config_process_env();
+	if (result)
+		goto cleanup;
+
+	(*Config)->FilePath = config_file_path;
+	config_file_path = NULL;
 
 cleanup:
 	if (config_file_path)
 		free(config_file_path);
 	if (result)
 	{
-		config_destroy(*Config);
+		config_free(*Config);
 		*Config = NULL;
 	}
 	return result;
 }
 
+/* Returns true if the file Config was read from has since changed. */
+static int
+config_changed(config_t * Config)
+{
+	struct stat stat_buf;
+
+	if (stat(Config->FilePath, &stat_buf))
+		return 1;
+
+	return (stat_buf.st_ino   != Config->FileIno   ||
+	        stat_buf.st_mtime != Config->FileMTime ||
+	        stat_buf.st_size  != Config->FileSize);
+}
+
+globus_result_t
+config_init(config_t ** Config)
+{
+	config_t      * config = NULL;
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(config_init);
+
+	*Config = NULL;
+
+	pthread_mutex_lock(&config_lock);
+	{
+		if (!config_current || config_changed(config_current))
+		{
+			result = config_load(&config);
+			if (result == GLOBUS_SUCCESS)
+			{
+				/* Sessions still using the old one keep their reference. */
+				if (config_current)
+					config_release(config_current);
+				config_current = config;
+			}
+		}
+
+		if (result == GLOBUS_SUCCESS)
+		{
+			/* config_release() drops references without the lock. */
+			__sync_add_and_fetch(&config_current->RefCount, 1);
+			*Config = config_current;
+		}
+	}
+	pthread_mutex_unlock(&config_lock);
+
+	return result;
+}
+
 void
-config_destroy(config_t * Config)
+config_release(config_t * Config)
+{
+	int ref_count = 0;
+
+	if (!Config)
+		return;
+
+	ref_count = __sync_sub_and_fetch(&Config->RefCount, 1);
+	if (ref_count == 0)
+		config_free(Config);
+}
+
+static void
+config_free(config_t * Config)
 {
 	if (Config)
 	{
+		if (Config->FilePath)
+			free(Config->FilePath);
 		if (Config->LoginName)
 			free(Config->LoginName);
 		if (Config->AuthenticationMech)
 			free(Config->AuthenticationMech);
 		if (Config->Authenticator)
 			free(Config->Authenticator);
+		if (Config->CallTraceDir)
+			free(Config->CallTraceDir);
 
 		free(Config);
 	}
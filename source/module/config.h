@@ -41,25 +41,77 @@
 #ifndef HPSS_DSI_CONFIG_H
 #define HPSS_DSI_CONFIG_H
 
+/*
+ * System includes
+ */
+#include <sys/types.h>
+#include <time.h>
+
 /*
  * Globus includes
  */
 #include <globus_gridftp_server.h>
 
-#define DEFAULT_CONFIG_FILE   "/var/hpss/etc/gridftp.conf"
+#define DEFAULT_CONFIG_FILE           "/var/hpss/etc/gridftp.conf"
+#define DEFAULT_WALK_THREADS          8
+#define DEFAULT_DELETE_THREADS        8
+#define DEFAULT_COMMAND_THREADS       4
+#define DEFAULT_COMMAND_QUEUE_DEPTH   64
+#define DEFAULT_IDCACHE_TTL           300
+#define DEFAULT_LOGIN_CRED_REFRESH    3600
+#define DEFAULT_PIO_RETRIES           3
+#define DEFAULT_PIO_RETRY_DELAY       1000
+#define DEFAULT_STOR_JOURNAL_INTERVAL 1024
+#define DEFAULT_BUFFER_POOL_IDLE      30
+#define DEFAULT_BUFFER_POOL_MAX       256
+#define DEFAULT_BUFFER_NUMA_NODE      -1
 
 typedef struct config {
 	char * LoginName;
 	char * AuthenticationMech;
 	char * Authenticator;
+	int    LoginCredRefresh;
 	int    QuotaSupport;
 	int    UDAChecksumSupport;
+	int    ListingChecksumSupport;
+	int    BatchCommandSupport;
+	int    RPCStatsSupport;
+	char * CallTraceDir;
+	int    IDCacheTTL;
+	int    IDCacheShared;
+	int    WalkThreads;
+	int    DeleteThreads;
+	int    CommandThreads;
+	int    CommandQueueDepth;
+	int    PIORetries;
+	int    PIORetryDelay; // Milliseconds
+	int    StorJournalSupport;
+	int    StorJournalInterval; // MB
+	int    BufferMemoryLimit;   // MB
+	int    BufferMemoryShared;
+	int    BufferPoolIdle;      // Seconds
+	int    BufferPoolMax;       // MB
+	int    BufferHugePages;
+	int    BufferNUMANode;      // -1 for none
+	int    PinPIOThreads;
+
+	/* Private to config.c */
+	int    RefCount;
+	char * FilePath;
+	ino_t  FileIno;
+	time_t FileMTime;
+	off_t  FileSize;
 } config_t;
 
+/*
+ * Returns a reference to the process wide config, which must not be
+ * modified. The file is only parsed on first use and again after it changes;
+ * otherwise this costs one stat(). Release with config_release().
+ */
 globus_result_t
 config_init(config_t ** Config);
 
 void
-config_destroy(config_t * Config);
+config_release(config_t * Config);
 
 #endif /* HPSS_DSI_CONFIG_H */
@@ -42,6 +42,7 @@
 /*
  * System includes
  */
+#include <inttypes.h>
 #include <string.h>
 
 /*
@@ -58,12 +59,68 @@
  * Local includes
  */
 #include "authenticate.h"
+#include "budget.h"
+#include "bufpool.h"
 #include "commands.h"
 #include "markers.h"
 #include "config.h"
+#include "histogram.h"
+#include "idcache.h"
+#include "journal.h"
+#include "pio.h"
+#include "placement.h"
 #include "stat.h"
 #include "stor.h"
 #include "retr.h"
+#include "rpcstats.h"
+
+/*
+ * Called by the loader in the server's parent process, before sessions are
+ * forked, when HPSS_DSI_PREFORK_WARMUP is set in the environment. Everything
+ * done here is inherited by each session. It deliberately stops short of
+ * logging in or contacting HPSS; connections and client threads do not
+ * survive fork(). Returns non zero on failure, in which case sessions simply
+ * do the work themselves.
+ */
+int
+dsi_warmup()
+{
+	config_t      * config = NULL;
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	/*
+	 * Parses the config and initializes the HPSS client library with it.
+	 * The reference is never released so the parsed config stays current
+	 * for the children.
+	 */
+	result = config_init(&config);
+	if (result)
+		return 1;
+
+	result = idcache_init(config);
+	if (result)
+		return 1;
+
+	result = rpcstats_init(config);
+	if (result)
+		return 1;
+
+	/* Reads the keytab; logging in is left to each session. */
+	result = authenticate_prepare(config);
+	if (result)
+		return 1;
+
+	return 0;
+}
+
+/* Session start phases, timed and logged by dsi_init(). */
+enum {
+	DSI_INIT_CONFIG,
+	DSI_INIT_AUTHENTICATE,
+	DSI_INIT_UCRED,
+	DSI_INIT_COMMANDS,
+	DSI_INIT_PHASES,
+};
 
 void
 dsi_init(globus_gfs_operation_t      Operation,
@@ -72,10 +129,15 @@ dsi_init(globus_gfs_operation_t      Operation,
 	globus_result_t result = GLOBUS_SUCCESS;
 	config_t      * config = NULL;
 	char          * home   = NULL;
+	uint64_t        start  = histogram_now();
+	uint64_t        phases[DSI_INIT_PHASES] = {0};
+	uint64_t        mark   = start;
 	sec_cred_t      user_cred;
 
 	GlobusGFSName(dsi_init);
 
+	rpcstats_set_op(RPCSTATS_OP_SESSION);
+
 	/*
 	 * Read in the config.
 	 */
@@ -83,14 +145,36 @@ dsi_init(globus_gfs_operation_t      Operation,
 	if (result)
 		goto cleanup;
 
+	result = idcache_init(config);
+	if (result)
+		goto cleanup;
+
+	result = budget_init(config);
+	if (result)
+		goto cleanup;
+
+	placement_init(config);
+	bufpool_init(config);
+
+	result = rpcstats_init(config);
+	if (result)
+		goto cleanup;
+
+	pio_init(config);
+
+	calltrace_operation(RPCSTATS_OP_SESSION, SessionInfo->username, 0);
+
+	phases[DSI_INIT_CONFIG] = histogram_now() - mark;
+	mark = histogram_now();
+
 	/* Now authenticate. */
-	result = authenticate(config->LoginName,
-	                      config->AuthenticationMech,
-	                      config->Authenticator,
-	                      SessionInfo->username);
+	result = authenticate(config, SessionInfo->username);
 	if (result != GLOBUS_SUCCESS)
 		goto cleanup;
 
+	phases[DSI_INIT_AUTHENTICATE] = histogram_now() - mark;
+	mark = histogram_now();
+
 	/*
 	 * Pulling the HPSS directory from the user's credential will support
 	 * sites that use HPSS LDAP.
@@ -106,9 +190,24 @@ dsi_init(globus_gfs_operation_t      Operation,
 		goto cleanup;
 	}
 
-	result = commands_init(Operation);
+	phases[DSI_INIT_UCRED] = histogram_now() - mark;
+	mark = histogram_now();
+
+	result = commands_init(Operation, config);
+
+	phases[DSI_INIT_COMMANDS] = histogram_now() - mark;
 
 cleanup:
+	globus_gfs_log_message(GLOBUS_GFS_LOG_INFO,
+	                       "HPSS DSI session start for %s: config=%"PRIu64"us authenticate=%"PRIu64"us "
+	                       "ucred=%"PRIu64"us commands=%"PRIu64"us total=%"PRIu64"us%s\n",
+	                       SessionInfo->username,
+	                       phases[DSI_INIT_CONFIG],
+	                       phases[DSI_INIT_AUTHENTICATE],
+	                       phases[DSI_INIT_UCRED],
+	                       phases[DSI_INIT_COMMANDS],
+	                       histogram_now() - start,
+	                       result ? " (failed)" : "");
 
 	/*
 	 * Inform the server that we are done. If we do not pass in a username, the
@@ -125,16 +224,46 @@ cleanup:
 	                                             NULL,  // username
 	                                             result ? NULL : home);
 
-	if (result) config_destroy(config);
+	if (result) config_release(config);
 	if (result && home) free(home);
 }
 
 
+static void
+dsi_log_rpcstats(const char * Line, void * Arg)
+{
+	globus_gfs_log_message(GLOBUS_GFS_LOG_INFO, "HPSS RPC %s\n", Line);
+}
+
 void
 dsi_destroy(void * Arg)
 {
+	budget_stats_t  budget_stats;
+	bufpool_stats_t bufpool_stats;
+
+	rpcstats_report(dsi_log_rpcstats, NULL);
+
+	budget_get_stats(&budget_stats);
+	globus_gfs_log_message(GLOBUS_GFS_LOG_INFO,
+	                       "HPSS DSI buffer budget: limit=%"PRId64"MB peak=%"PRId64"MB "
+	                       "denied=%"PRIu64" forced=%"PRIu64"%s\n",
+	                       budget_stats.Limit / (1024*1024),
+	                       budget_stats.Peak / (1024*1024),
+	                       budget_stats.Denied,
+	                       budget_stats.Forced,
+	                       budget_stats.Shared ? " (host wide)" : "");
+
+	bufpool_get_stats(&bufpool_stats);
+	globus_gfs_log_message(GLOBUS_GFS_LOG_INFO,
+	                       "HPSS DSI buffer pool: gets=%"PRIu64" reused=%"PRIu64" trimmed=%"PRIu64" "
+	                       "peak idle=%"PRId64"MB\n",
+	                       bufpool_stats.Gets,
+	                       bufpool_stats.Reused,
+	                       bufpool_stats.Trimmed,
+	                       bufpool_stats.PeakIdleBytes / (1024*1024));
+
 	if (Arg)
-		config_destroy(Arg);
+		config_release(Arg);
 }
 
 int
@@ -159,6 +288,8 @@ dsi_send(globus_gfs_operation_t       Operation,
 
 	GlobusGFSName(dsi_send);
 
+	rpcstats_set_op(RPCSTATS_OP_RETR);
+	calltrace_operation(RPCSTATS_OP_RETR, TransferInfo->pathname, 0);
 	retr(Operation, TransferInfo);
 }
 
@@ -171,7 +302,16 @@ dsi_recv(globus_gfs_operation_t       Operation,
 
 	GlobusGFSName(dsi_recv);
 
-	if (dsi_restart_transfer(TransferInfo) && !markers_restart_supported())
+	rpcstats_set_op(RPCSTATS_OP_STOR);
+	calltrace_operation(RPCSTATS_OP_STOR, TransferInfo->pathname, TransferInfo->alloc_size);
+
+	/*
+	 * Without restart markers from the server, we can still restart from
+	 * what the STOR journal says is in HPSS.
+	 */
+	if (dsi_restart_transfer(TransferInfo) &&
+	    !markers_restart_supported() &&
+	    !journal_restart_allowed(TransferInfo->pathname, TransferInfo->range_list, UserArg))
 	{
 		result = GlobusGFSErrorGeneric("Restarts are not supported");
 		globus_gridftp_server_finished_transfer(Operation, result);
@@ -186,6 +326,13 @@ dsi_command(globus_gfs_operation_t      Operation,
             globus_gfs_command_info_t * CommandInfo,
             void                      * UserArg)
 {
+	if (CommandInfo->command == GLOBUS_GFS_CMD_CKSM)
+		rpcstats_set_op(RPCSTATS_OP_CKSM);
+	else
+		rpcstats_set_op(RPCSTATS_OP_COMMAND);
+
+	calltrace_operation(rpcstats_get_op(), CommandInfo->pathname, CommandInfo->command);
+
 	commands_run(Operation, CommandInfo, UserArg, globus_gridftp_server_finished_command);
 }
 
@@ -199,6 +346,12 @@ dsi_stat(globus_gfs_operation_t   Operation,
 	globus_result_t   result = GLOBUS_SUCCESS;
 	globus_gfs_stat_t gfs_stat;
 
+	rpcstats_set_op(RPCSTATS_OP_STAT);
+	calltrace_operation(RPCSTATS_OP_STAT,
+	                    StatInfo->pathname,
+	                    (StatInfo->file_only ? CALLTRACE_STAT_FILE_ONLY : 0) |
+	                    (StatInfo->use_symlink_info ? CALLTRACE_STAT_SYMLINK : 0));
+
 	switch (StatInfo->use_symlink_info)
 	{
 	case 0:
@@ -246,6 +399,7 @@ dsi_stat(globus_gfs_operation_t   Operation,
 		                                &end,
 		                                &offset,
 		                                gfs_stat_array,
+		                                NULL,
 		                                &count_out);
 		if (result)
 			break;
@@ -0,0 +1,335 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "du.h"
+#include "listing.h"
+#include "stage.h"
+#include "stat.h"
+#include "walk.h"
+
+/* Residency buckets; entries whose residency could not be read are unknown. */
+enum {
+	DU_RESIDENT,
+	DU_ARCHIVED,
+	DU_TAPE_ONLY,
+	DU_UNKNOWN,
+	DU_BUCKETS,
+};
+
+typedef struct {
+	pthread_mutex_t            Lock;
+	pthread_cond_t             Cond;
+	config_t                 * Config;
+	int                        Residency;
+
+	globus_gfs_operation_t     Operation;
+	globus_callback_handle_t   CallbackHandle;
+	int                        MarkersRunning;
+
+	uint64_t                   Files;
+	uint64_t                   Dirs;
+	uint64_t                   Bytes;
+	uint64_t                   BucketFiles[DU_BUCKETS];
+	uint64_t                   BucketBytes[DU_BUCKETS];
+} du_t;
+
+static char *
+du_format_totals(du_t * Du)
+{
+	if (!Du->Residency)
+		return globus_common_create_string("files=%"PRIu64";dirs=%"PRIu64";bytes=%"PRIu64";",
+		                                   Du->Files,
+		                                   Du->Dirs,
+		                                   Du->Bytes);
+
+	return globus_common_create_string("files=%"PRIu64";dirs=%"PRIu64";bytes=%"PRIu64";"
+	                                   "x.hpss.resident=%"PRIu64"/%"PRIu64";"
+	                                   "x.hpss.archived=%"PRIu64"/%"PRIu64";"
+	                                   "x.hpss.tape-only=%"PRIu64"/%"PRIu64";"
+	                                   "x.hpss.unknown=%"PRIu64"/%"PRIu64";",
+	                                   Du->Files,
+	                                   Du->Dirs,
+	                                   Du->Bytes,
+	                                   Du->BucketFiles[DU_RESIDENT],  Du->BucketBytes[DU_RESIDENT],
+	                                   Du->BucketFiles[DU_ARCHIVED],  Du->BucketBytes[DU_ARCHIVED],
+	                                   Du->BucketFiles[DU_TAPE_ONLY], Du->BucketBytes[DU_TAPE_ONLY],
+	                                   Du->BucketFiles[DU_UNKNOWN],   Du->BucketBytes[DU_UNKNOWN]);
+}
+
+static void
+du_send_markers(void * UserArg)
+{
+	du_t * du     = UserArg;
+	char * totals = NULL;
+
+	pthread_mutex_lock(&du->Lock);
+	{
+		totals = du_format_totals(du);
+		if (totals)
+		{
+			globus_gridftp_server_intermediate_command(du->Operation, GLOBUS_SUCCESS, totals);
+			globus_free(totals);
+		}
+	}
+	pthread_mutex_unlock(&du->Lock);
+}
+
+static void
+du_start_markers(du_t * Du)
+{
+	int              marker_freq = 0;
+	globus_reltime_t delay;
+
+	/* Get the frequency for maker updates. */
+	globus_gridftp_server_get_update_interval(Du->Operation, &marker_freq);
+
+	if (marker_freq > 0)
+	{
+		GlobusTimeReltimeSet(delay, marker_freq, 0);
+		if (globus_callback_register_periodic(&Du->CallbackHandle,
+		                                      &delay,
+		                                      &delay,
+		                                      du_send_markers,
+		                                      Du) == GLOBUS_SUCCESS)
+		{
+			Du->MarkersRunning = 1;
+		}
+	}
+}
+
+static void
+du_markers_stopped(void * UserArg)
+{
+	du_t * du = UserArg;
+
+	pthread_mutex_lock(&du->Lock);
+	{
+		du->MarkersRunning = 0;
+		pthread_cond_broadcast(&du->Cond);
+	}
+	pthread_mutex_unlock(&du->Lock);
+}
+
+static void
+du_stop_markers(du_t * Du)
+{
+	if (!Du->MarkersRunning)
+		return;
+
+	globus_callback_unregister(Du->CallbackHandle, du_markers_stopped, Du, NULL);
+
+	pthread_mutex_lock(&Du->Lock);
+	{
+		while (Du->MarkersRunning)
+			pthread_cond_wait(&Du->Cond, &Du->Lock);
+	}
+	pthread_mutex_unlock(&Du->Lock);
+}
+
+static int
+du_bucket(listing_facts_t * Facts)
+{
+	if (!Facts->Valid)
+		return DU_UNKNOWN;
+
+	switch (Facts->Residency)
+	{
+	case STAGE_FILE_RESIDENT:
+		return DU_RESIDENT;
+	case STAGE_FILE_ARCHIVED:
+		return DU_ARCHIVED;
+	case STAGE_FILE_TAPE_ONLY:
+		return DU_TAPE_ONLY;
+	}
+	return DU_UNKNOWN;
+}
+
+static globus_result_t
+du_entries(walk_dir_t        * Dir,
+           globus_gfs_stat_t * GFSStatArray,
+           uint32_t            Count,
+           void              * UserArg)
+{
+	du_t            * du          = UserArg;
+	listing_facts_t * facts_array = NULL;
+	uint32_t          i           = 0;
+	int               bucket      = 0;
+
+	GlobusGFSName(du_entries);
+
+	if (du->Residency)
+	{
+		facts_array = malloc(sizeof(listing_facts_t) * Count);
+		if (!facts_array)
+			return GlobusGFSErrorMemory("listing_facts_t array");
+
+		listing_get_facts(&Dir->ObjHandle,
+		                  Dir->Path,
+		                  du->Config,
+		                  GFSStatArray,
+		                  Count,
+		                  LISTING_FACT_RESIDENCY,
+		                  facts_array);
+	}
+
+	pthread_mutex_lock(&du->Lock);
+	{
+		for (i = 0; i < Count; i++)
+		{
+			if (S_ISDIR(GFSStatArray[i].mode))
+			{
+				du->Dirs++;
+				continue;
+			}
+
+			du->Files++;
+			if (!S_ISREG(GFSStatArray[i].mode))
+				continue;
+
+			du->Bytes += GFSStatArray[i].size;
+
+			if (facts_array)
+			{
+				bucket = du_bucket(&facts_array[i]);
+				du->BucketFiles[bucket]++;
+				du->BucketBytes[bucket] += GFSStatArray[i].size;
+			}
+		}
+	}
+	pthread_mutex_unlock(&du->Lock);
+
+	if (facts_array)
+	{
+		listing_destroy_facts(facts_array, Count);
+		free(facts_array);
+	}
+	return GLOBUS_SUCCESS;
+}
+
+void
+du(globus_gfs_operation_t      Operation,
+   globus_gfs_command_info_t * CommandInfo,
+   config_t                  * Config,
+   commands_callback           Callback)
+{
+	char           ** argv           = NULL;
+	int               argc           = 0;
+	char            * totals         = NULL;
+	char            * command_output = NULL;
+	globus_result_t   result         = GLOBUS_SUCCESS;
+	du_t              du;
+
+	GlobusGFSName(du);
+
+	memset(&du, 0, sizeof(du));
+	pthread_mutex_init(&du.Lock, NULL);
+	pthread_cond_init(&du.Cond, NULL);
+	du.Config    = Config;
+	du.Operation = Operation;
+
+	/* Get the command arguments. */
+	result = globus_gridftp_server_query_op_info(Operation,
+	                                             CommandInfo->op_info,
+	                                             GLOBUS_GFS_OP_INFO_CMD_ARGS,
+	                                             &argv,
+	                                             &argc);
+	if (result)
+	{
+		result = GlobusGFSErrorWrapFailed("Unable to get command args", result);
+		goto cleanup;
+	}
+
+	if (strcasecmp(argv[2], "residency") == 0)
+		du.Residency = 1;
+	else if (strcasecmp(argv[2], "none") != 0)
+	{
+		result = GlobusGFSErrorGeneric("Unknown breakdown; use 'residency' or 'none'");
+		goto cleanup;
+	}
+
+	du_start_markers(&du);
+
+	result = walk(CommandInfo->pathname,
+	              -1,
+	              Config->WalkThreads,
+	              0,
+	              du_entries,
+	              NULL,
+	              &du);
+
+	du_stop_markers(&du);
+	if (result)
+		goto cleanup;
+
+	totals = du_format_totals(&du);
+	if (!totals)
+	{
+		result = GlobusGFSErrorMemory("du totals");
+		goto cleanup;
+	}
+
+	command_output = globus_common_create_string("250 %s %s\r\n", totals, CommandInfo->pathname);
+	globus_free(totals);
+
+cleanup:
+	Callback(Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+
+	pthread_cond_destroy(&du.Cond);
+	pthread_mutex_destroy(&du.Lock);
+}
@@ -0,0 +1,142 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+
+/*
+ * Local includes
+ */
+#include "handoff.h"
+#include "histogram.h"
+
+void
+handoff_init(handoff_t * Handoff)
+{
+	memset(Handoff, 0, sizeof(handoff_t));
+}
+
+void
+handoff_push(handoff_t * Handoff, handoff_node_t * Node)
+{
+	handoff_node_t * head = NULL;
+
+	/* Announced before the push so handoff_destroy() can't miss us. */
+	__sync_fetch_and_add(&Handoff->Pushing, 1);
+
+	do {
+		head       = Handoff->Head;
+		Node->Next = head;
+	} while (!__sync_bool_compare_and_swap(&Handoff->Head, head, Node));
+
+	/* The swap above is a full barrier, so Sleeping is read after the push. */
+	if (Handoff->Sleeping)
+	{
+		__sync_fetch_and_add(&Handoff->Sequence, 1);
+		__sync_fetch_and_add(&Handoff->Wakeups, 1);
+		syscall(SYS_futex, &Handoff->Sequence, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+
+	/* Last touch of Handoff; the consumer may free it from here on. */
+	__sync_fetch_and_sub(&Handoff->Pushing, 1);
+}
+
+handoff_node_t *
+handoff_take_all(handoff_t * Handoff)
+{
+	handoff_node_t * node     = NULL;
+	handoff_node_t * next     = NULL;
+	handoff_node_t * reversed = NULL;
+
+	if (!Handoff->Head)
+		return NULL;
+
+	node = __sync_lock_test_and_set(&Handoff->Head, NULL);
+
+	/* The stack is newest first. */
+	for (; node; node = next)
+	{
+		next       = node->Next;
+		node->Next = reversed;
+		reversed   = node;
+	}
+	return reversed;
+}
+
+void
+handoff_wait(handoff_t * Handoff, uint64_t * WaitCounter)
+{
+	int      sequence = Handoff->Sequence;
+	uint64_t start    = 0;
+
+	/*
+	 * Announce that we may sleep before the last look at Head. A producer
+	 * that pushes after that look sees Sleeping and bumps Sequence, which
+	 * makes the futex wait below return at once.
+	 */
+	Handoff->Sleeping = 1;
+	__sync_synchronize();
+
+	if (!Handoff->Head)
+	{
+		start = histogram_now();
+		syscall(SYS_futex, &Handoff->Sequence, FUTEX_WAIT_PRIVATE, sequence, NULL, NULL, 0);
+		if (WaitCounter)
+			*WaitCounter += histogram_now() - start;
+		Handoff->Sleeps++;
+	}
+
+	Handoff->Sleeping = 0;
+}
+
+void
+handoff_destroy(handoff_t * Handoff)
+{
+	/* A producer is at most one wake up away from leaving. */
+	while (Handoff->Pushing)
+		sched_yield();
+}
@@ -0,0 +1,108 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_HANDOFF_H
+#define HPSS_DSI_HANDOFF_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Lock free handoff of buffers from the Globus callback threads (any number
+ * of producers) to the single consumer of one transfer: the PIO thread and,
+ * once PIO is done with the transfer, the transfer complete callback.
+ *
+ * Producers push onto a stack with compare and swap; the consumer takes the
+ * whole stack at once with an exchange, so there is no ABA problem and the
+ * queue is bounded by the number of buffers the transfer has allocated. The
+ * consumer only sleeps, on a futex, when there is nothing to take, and
+ * producers only make the wake up system call when it is asleep.
+ *
+ * Anything a producer writes before handoff_push() (ie a transfer's Result)
+ * is visible to the consumer once it has taken that node.
+ *
+ * A producer still touches the handoff after its node is visible, to wake
+ * the consumer, so the consumer must call handoff_destroy() before freeing
+ * the memory that holds it.
+ */
+
+typedef struct handoff_node {
+	struct handoff_node * Next;
+} handoff_node_t;
+
+typedef struct {
+	handoff_node_t * volatile Head;
+	volatile int              Sequence; // futex word, bumped to wake the consumer
+	volatile int              Sleeping; // Set while the consumer may be asleep
+	volatile int              Pushing;  // Producers inside handoff_push()
+
+	uint64_t                  Sleeps;   // Consumer only
+	uint64_t                  Wakeups;  // Bumped atomically by producers
+} handoff_t;
+
+void
+handoff_init(handoff_t * Handoff);
+
+/* Any thread. */
+void
+handoff_push(handoff_t * Handoff, handoff_node_t * Node);
+
+/* Consumer only. Returns every pushed node, oldest first, or NULL. */
+handoff_node_t *
+handoff_take_all(handoff_t * Handoff);
+
+/*
+ * Consumer only. Blocks until a node has been pushed; returns at once if one
+ * is already waiting. The time blocked is added to *WaitCounter (usecs) if
+ * it is not NULL. May return spuriously.
+ */
+void
+handoff_wait(handoff_t * Handoff, uint64_t * WaitCounter);
+
+/*
+ * Consumer only. Waits for producers that are still inside handoff_push()
+ * to leave it. No node may be pushed afterwards.
+ */
+void
+handoff_destroy(handoff_t * Handoff);
+
+#endif /* HPSS_DSI_HANDOFF_H */
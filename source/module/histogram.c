@@ -0,0 +1,133 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <time.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "histogram.h"
+
+uint64_t
+histogram_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+histogram_bucket(uint64_t Usecs)
+{
+	int bucket = 0;
+
+	while (Usecs > 1 && bucket < HISTOGRAM_BUCKETS - 1)
+	{
+		Usecs >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void
+histogram_record(histogram_t * Histogram, uint64_t Usecs)
+{
+	uint64_t max = 0;
+
+	__sync_fetch_and_add(&Histogram->Count, 1);
+	__sync_fetch_and_add(&Histogram->Sum, Usecs);
+	__sync_fetch_and_add(&Histogram->Buckets[histogram_bucket(Usecs)], 1);
+
+	max = Histogram->Max;
+	while (Usecs > max)
+	{
+		if (__sync_bool_compare_and_swap(&Histogram->Max, max, Usecs))
+			break;
+		max = Histogram->Max;
+	}
+}
+
+uint64_t
+histogram_percentile(histogram_t * Histogram, int Percentile)
+{
+	uint64_t count  = Histogram->Count;
+	uint64_t target = 0;
+	uint64_t seen   = 0;
+	int      i      = 0;
+
+	if (count == 0)
+		return 0;
+
+	target = (count * Percentile + 99) / 100;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += Histogram->Buckets[i];
+		if (seen >= target)
+			return (uint64_t)2 << i;
+	}
+	return Histogram->Max;
+}
+
+char *
+histogram_format(histogram_t * Histogram, const char * Name)
+{
+	uint64_t count = Histogram->Count;
+
+	return globus_common_create_string("%s count=%"PRIu64" mean=%"PRIu64"us p50=%"PRIu64"us "
+	                                   "p90=%"PRIu64"us p99=%"PRIu64"us max=%"PRIu64"us",
+	                                   Name,
+	                                   count,
+	                                   count ? Histogram->Sum / count : 0,
+	                                   histogram_percentile(Histogram, 50),
+	                                   histogram_percentile(Histogram, 90),
+	                                   histogram_percentile(Histogram, 99),
+	                                   Histogram->Max);
+}
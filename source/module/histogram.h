@@ -0,0 +1,85 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_HISTOGRAM_H
+#define HPSS_DSI_HISTOGRAM_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Bucket i counts samples in [2^i, 2^(i+1)) microseconds; bucket 0 also
+ * takes 0us. 2^32us is a bit over an hour.
+ */
+#define HISTOGRAM_BUCKETS 33
+
+/*
+ * Latency histogram safe to update from any thread without a lock. A
+ * zeroed histogram_t is empty and ready for use.
+ */
+typedef struct {
+	uint64_t Count;
+	uint64_t Sum;  // usecs
+	uint64_t Max;  // usecs
+	uint64_t Buckets[HISTOGRAM_BUCKETS];
+} histogram_t;
+
+/* Monotonic clock in microseconds, for timing samples. */
+uint64_t
+histogram_now();
+
+void
+histogram_record(histogram_t * Histogram, uint64_t Usecs);
+
+/* Upper bound, in usecs, of the bucket holding the given percentile (0-100). */
+uint64_t
+histogram_percentile(histogram_t * Histogram, int Percentile);
+
+/*
+ * Returns a one line summary, ie
+ *   MKD count=12 mean=350us p50=512us p90=1024us p99=2048us max=3001us
+ * Free with globus_free().
+ */
+char *
+histogram_format(histogram_t * Histogram, const char * Name);
+
+#endif /* HPSS_DSI_HISTOGRAM_H */
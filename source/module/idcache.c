@@ -0,0 +1,347 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "idcache.h"
+
+enum {
+	IDCACHE_EMPTY = 0,
+	IDCACHE_USER,
+	IDCACHE_GROUP,
+};
+
+/*
+ * Slots may be shared between processes so they are guarded by a sequence
+ * count rather than a mutex: writers make it odd while they update the slot
+ * and readers retry if it changed under them.
+ */
+typedef struct {
+	uint32_t Seq;
+	int      Type;
+	int      Id;
+	time_t   Expires;
+	char     Name[IDCACHE_NAME_MAX];
+} idcache_slot_t;
+
+typedef struct {
+	idcache_slot_t Slots[IDCACHE_SLOTS];
+} idcache_table_t;
+
+static pthread_mutex_t   idcache_lock  = PTHREAD_MUTEX_INITIALIZER;
+static idcache_table_t * idcache_table  = NULL;
+static int               idcache_shared = 0;
+static int               idcache_ttl    = 0;
+static idcache_stats_t   idcache_stats;
+
+static idcache_table_t *
+idcache_map_shared()
+{
+	int         fd    = -1;
+	void      * table = NULL;
+	struct stat stat_buf;
+
+	fd = shm_open(IDCACHE_SHM_NAME, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+	if (fd < 0)
+		return NULL;
+
+	/* Anyone could have created it first; only trust a segment only we can write. */
+	if (fstat(fd, &stat_buf) || stat_buf.st_uid != geteuid() || (stat_buf.st_mode & (S_IRWXG|S_IRWXO)))
+	{
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "Shared id cache %s is not owned by us with mode 0600\n",
+		                       IDCACHE_SHM_NAME);
+		close(fd);
+		return NULL;
+	}
+
+	/* A zero filled table is a valid empty one so racing creators are harmless. */
+	if (ftruncate(fd, sizeof(idcache_table_t)) == 0)
+		table = mmap(NULL, sizeof(idcache_table_t), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return (table == MAP_FAILED) ? NULL : table;
+}
+
+globus_result_t
+idcache_init(config_t * Config)
+{
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(idcache_init);
+
+	pthread_mutex_lock(&idcache_lock);
+	{
+		idcache_ttl = Config->IDCacheTTL;
+
+		if (idcache_ttl > 0 && !idcache_table)
+		{
+			if (Config->IDCacheShared)
+			{
+				idcache_table = idcache_map_shared();
+				if (idcache_table)
+					idcache_shared = 1;
+				else
+					globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+					                       "Unable to map shared id cache, using a private one\n");
+			}
+
+			if (!idcache_table)
+			{
+				idcache_table = calloc(1, sizeof(idcache_table_t));
+				if (!idcache_table)
+					result = GlobusGFSErrorMemory("idcache_table_t");
+			}
+		}
+	}
+	pthread_mutex_unlock(&idcache_lock);
+
+	return result;
+}
+
+static idcache_slot_t *
+idcache_slot(int Type, char * Name)
+{
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	hash = (hash ^ Type) * 16777619u;
+	while (*Name)
+		hash = (hash ^ (unsigned char)*Name++) * 16777619u;
+
+	return &idcache_table->Slots[hash % IDCACHE_SLOTS];
+}
+
+static int
+idcache_lookup(int Type, char * Name, int * Id)
+{
+	idcache_slot_t * slot  = NULL;
+	uint32_t         seq   = 0;
+	int              found = 0;
+
+	if (!idcache_table || idcache_ttl <= 0 || strlen(Name) >= IDCACHE_NAME_MAX)
+		return 0;
+
+	slot = idcache_slot(Type, Name);
+	do {
+		seq = slot->Seq;
+		if (seq & 1)
+			return 0; // Being written; just do the lookup
+
+		__sync_synchronize();
+		found = (slot->Type == Type            &&
+		         slot->Expires > time(NULL)    &&
+		         strncmp(slot->Name, Name, IDCACHE_NAME_MAX) == 0);
+		if (found)
+			*Id = slot->Id;
+		__sync_synchronize();
+	} while (slot->Seq != seq);
+
+	return found;
+}
+
+static void
+idcache_insert(int Type, char * Name, int Id)
+{
+	idcache_slot_t * slot = NULL;
+	uint32_t         seq  = 0;
+
+	if (!idcache_table || idcache_ttl <= 0 || strlen(Name) >= IDCACHE_NAME_MAX)
+		return;
+
+	slot = idcache_slot(Type, Name);
+
+	/* If someone else is updating this slot, let them have it. */
+	seq = slot->Seq;
+	if ((seq & 1) || !__sync_bool_compare_and_swap(&slot->Seq, seq, seq + 1))
+		return;
+
+	__sync_synchronize();
+	slot->Type    = Type;
+	slot->Id      = Id;
+	slot->Expires = time(NULL) + idcache_ttl;
+	strncpy(slot->Name, Name, IDCACHE_NAME_MAX);
+	__sync_synchronize();
+
+	slot->Seq = seq + 2;
+}
+
+/*
+ * Directory services may need more than any fixed buffer (large groups in
+ * particular), so start from the system's hint and double on ERANGE.
+ */
+static size_t
+idcache_initial_buffer_size(int SysconfName)
+{
+	long size = sysconf(SysconfName);
+	return (size > 0) ? size : 1024;
+}
+
+globus_result_t
+idcache_get_uid(char * UserName, int * Uid)
+{
+	struct passwd * passwd = NULL;
+	struct passwd   passwd_buf;
+	char          * buffer = NULL;
+	size_t          size   = 0;
+	int             retval = 0;
+	uint64_t        start  = 0;
+
+	GlobusGFSName(idcache_get_uid);
+
+	/*
+	 * The uid picks the HPSS user the session logs in as, so it is never
+	 * taken from (or put in) a table other processes write.
+	 */
+	if (!idcache_shared && idcache_lookup(IDCACHE_USER, UserName, Uid))
+	{
+		__sync_fetch_and_add(&idcache_stats.Hits, 1);
+		return GLOBUS_SUCCESS;
+	}
+	__sync_fetch_and_add(&idcache_stats.Misses, 1);
+
+	start = histogram_now();
+	for (size = idcache_initial_buffer_size(_SC_GETPW_R_SIZE_MAX); ; size *= 2)
+	{
+		buffer = malloc(size);
+		if (!buffer)
+			return GlobusGFSErrorMemory("passwd buffer");
+
+		retval = getpwnam_r(UserName, &passwd_buf, buffer, size, &passwd);
+		if (retval != ERANGE || size * 2 > IDCACHE_MAX_BUFFER)
+			break;
+		free(buffer);
+	}
+	histogram_record(&idcache_stats.Lookups, histogram_now() - start);
+
+	if (retval == 0 && passwd)
+	{
+		/* Copy out the uid */
+		*Uid = passwd->pw_uid;
+		if (!idcache_shared)
+			idcache_insert(IDCACHE_USER, UserName, *Uid);
+	}
+	free(buffer);
+
+	if (retval != 0)
+		return GlobusGFSErrorSystemError("getpwnam_r", retval);
+
+	if (passwd == NULL)
+		return GlobusGFSErrorGeneric("Account not found");
+
+	return GLOBUS_SUCCESS;
+}
+
+globus_result_t
+idcache_get_gid(char * GroupName, int * Gid)
+{
+	struct group * group  = NULL;
+	struct group   group_buf;
+	char         * buffer = NULL;
+	size_t         size   = 0;
+	int            retval = 0;
+	uint64_t       start  = 0;
+
+	GlobusGFSName(idcache_get_gid);
+
+	if (idcache_lookup(IDCACHE_GROUP, GroupName, Gid))
+	{
+		__sync_fetch_and_add(&idcache_stats.Hits, 1);
+		return GLOBUS_SUCCESS;
+	}
+	__sync_fetch_and_add(&idcache_stats.Misses, 1);
+
+	start = histogram_now();
+	for (size = idcache_initial_buffer_size(_SC_GETGR_R_SIZE_MAX); ; size *= 2)
+	{
+		buffer = malloc(size);
+		if (!buffer)
+			return GlobusGFSErrorMemory("group buffer");
+
+		retval = getgrnam_r(GroupName, &group_buf, buffer, size, &group);
+		if (retval != ERANGE || size * 2 > IDCACHE_MAX_BUFFER)
+			break;
+		free(buffer);
+	}
+	histogram_record(&idcache_stats.Lookups, histogram_now() - start);
+
+	if (retval == 0 && group)
+	{
+		/* Copy out the gid */
+		*Gid = group->gr_gid;
+		idcache_insert(IDCACHE_GROUP, GroupName, *Gid);
+	}
+	free(buffer);
+
+	if (retval != 0)
+		return GlobusGFSErrorSystemError("getgrnam_r", retval);
+
+	if (group == NULL)
+		return GlobusGFSErrorGeneric("Group not found");
+
+	return GLOBUS_SUCCESS;
+}
+
+void
+idcache_get_stats(idcache_stats_t * Stats)
+{
+	*Stats = idcache_stats;
+}
@@ -0,0 +1,98 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_IDCACHE_H
+#define HPSS_DSI_IDCACHE_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "config.h"
+#include "histogram.h"
+
+/* Name of the shared memory table when IDCacheShared is on. */
+#define IDCACHE_SHM_NAME "/hpss_dsi_idcache"
+
+/* Table size; names map directly onto a slot. */
+#define IDCACHE_SLOTS 1024
+
+/* Longer names are looked up every time. */
+#define IDCACHE_NAME_MAX 64
+
+/* Largest getpwnam_r()/getgrnam_r() buffer we will grow to. */
+#define IDCACHE_MAX_BUFFER (1024*1024)
+
+typedef struct {
+	uint64_t    Hits;
+	uint64_t    Misses;
+	histogram_t Lookups; // Time spent in getpwnam_r()/getgrnam_r()
+} idcache_stats_t;
+
+/*
+ * Sets up the process wide name to id cache. With Config->IDCacheShared the
+ * table lives in shared memory so sessions, each in their own process,
+ * benefit from each other's lookups. Entries live for Config->IDCacheTTL
+ * seconds; 0 disables caching. Falls back to a private table if the shared
+ * one can not be mapped or is not owned by us with mode 0600.
+ */
+globus_result_t
+idcache_init(config_t * Config);
+
+/* Used for logins; with a shared table, always does a fresh lookup. */
+globus_result_t
+idcache_get_uid(char * UserName, int * Uid);
+
+globus_result_t
+idcache_get_gid(char * GroupName, int * Gid);
+
+void
+idcache_get_stats(idcache_stats_t * Stats);
+
+#endif /* HPSS_DSI_IDCACHE_H */
@@ -0,0 +1,515 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+#include "rpcstats.h"
+
+/*
+ * Local includes
+ */
+#include "journal.h"
+
+/*
+ * The file as of the last journal write, stored ahead of the ranges as
+ * 'size:mtime:'. Anything that writes to the file without going through
+ * the journal, ie hsi or a STOR with StorJournalSupport off, changes one
+ * of them and so invalidates the ranges.
+ */
+typedef struct {
+	globus_off_t Size;
+	long         MTime;
+} journal_stamp_t;
+
+/* Merges Offset, End into the sorted, disjoint Ranges. */
+static void
+journal_insert(journal_range_t * Ranges,
+               int             * Count,
+               globus_off_t      Offset,
+               globus_off_t      End)
+{
+	int             i        = 0;
+	int             count    = 0;
+	int             inserted = 0;
+	journal_range_t merged[JOURNAL_MAX_RANGES + 1];
+
+	for (i = 0; i < *Count; i++)
+	{
+		if (Ranges[i].End < Offset)
+		{
+			merged[count++] = Ranges[i];
+			continue;
+		}
+
+		if (Ranges[i].Offset > End)
+		{
+			if (!inserted)
+			{
+				merged[count].Offset = Offset;
+				merged[count].End    = End;
+				count++;
+				inserted = 1;
+			}
+			merged[count++] = Ranges[i];
+			continue;
+		}
+
+		/* Overlaps or touches; absorb it. */
+		if (Ranges[i].Offset < Offset)
+			Offset = Ranges[i].Offset;
+		if (Ranges[i].End > End)
+			End = Ranges[i].End;
+	}
+
+	if (!inserted)
+	{
+		merged[count].Offset = Offset;
+		merged[count].End    = End;
+		count++;
+	}
+
+	/* Dropping the highest range only costs a resend of it. */
+	if (count > JOURNAL_MAX_RANGES)
+		count = JOURNAL_MAX_RANGES;
+
+	memcpy(Ranges, merged, count * sizeof(journal_range_t));
+	*Count = count;
+}
+
+static void
+journal_format(journal_stamp_t * Stamp,
+               journal_range_t * Ranges,
+               int               Count,
+               char            * Buffer,
+               size_t            Length)
+{
+	int    i      = 0;
+	size_t offset = 0;
+
+	Buffer[0] = '\0';
+	if (Stamp && Count)
+		offset = snprintf(Buffer,
+		                  Length,
+		                  "%"GLOBUS_OFF_T_FORMAT":%ld:",
+		                  Stamp->Size,
+		                  Stamp->MTime);
+
+	for (i = 0; i < Count && offset < Length; i++)
+	{
+		offset += snprintf(Buffer + offset,
+		                   Length - offset,
+		                   "%s%"GLOBUS_OFF_T_FORMAT"-%"GLOBUS_OFF_T_FORMAT,
+		                   i ? "," : "",
+		                   Ranges[i].Offset,
+		                   Ranges[i].End);
+	}
+}
+
+/* A journal that does not parse is treated as empty. */
+static void
+journal_parse(char            * Value,
+              journal_stamp_t * Stamp,
+              journal_range_t * Ranges,
+              int             * Count)
+{
+	char         * ptr    = Value;
+	char         * endptr = NULL;
+	globus_off_t   offset = 0;
+	globus_off_t   end    = 0;
+
+	*Count = 0;
+
+	if (!*ptr)
+		return;
+
+	Stamp->Size = strtoll(ptr, &endptr, 10);
+	if (endptr == ptr || *endptr != ':')
+		goto invalid;
+	ptr = endptr + 1;
+
+	Stamp->MTime = strtol(ptr, &endptr, 10);
+	if (endptr == ptr || *endptr != ':')
+		goto invalid;
+	ptr = endptr + 1;
+
+	while (*ptr)
+	{
+		offset = strtoll(ptr, &endptr, 10);
+		if (endptr == ptr || *endptr != '-')
+			goto invalid;
+		ptr = endptr + 1;
+
+		end = strtoll(ptr, &endptr, 10);
+		if (endptr == ptr || end < offset || (*endptr != ',' && *endptr != '\0'))
+			goto invalid;
+		ptr = *endptr ? endptr + 1 : endptr;
+
+		if (end > offset)
+			journal_insert(Ranges, Count, offset, end);
+	}
+	return;
+
+invalid:
+	*Count = 0;
+}
+
+static globus_result_t
+journal_stat(char * Pathname, journal_stamp_t * Stamp)
+{
+	int         retval = 0;
+	hpss_stat_t stat_buf;
+
+	GlobusGFSName(journal_stat);
+
+	retval = hpss_Stat(Pathname, &stat_buf);
+	if (retval)
+		return GlobusGFSErrorSystemError("hpss_Stat", -retval);
+
+	CONVERT_U64_TO_LONGLONG(stat_buf.st_size, Stamp->Size);
+	Stamp->MTime = stat_buf.hpss_st_mtime;
+	return GLOBUS_SUCCESS;
+}
+
+static globus_result_t
+journal_read(char            * Pathname,
+             journal_stamp_t * Stamp,
+             journal_range_t * Ranges,
+             int             * Count)
+{
+	int                  retval = 0;
+	char               * tmp    = NULL;
+	char                 value[HPSS_XML_SIZE];
+	hpss_userattr_t      user_attrs[1];
+	hpss_userattr_list_t attr_list;
+
+	GlobusGFSName(journal_read);
+
+	*Count = 0;
+
+	attr_list.len  = sizeof(user_attrs)/sizeof(*user_attrs);
+	attr_list.Pair = user_attrs;
+
+	attr_list.Pair[0].Key   = JOURNAL_UDA_KEY;
+	attr_list.Pair[0].Value = value;
+
+	retval = hpss_UserAttrGetAttrs(Pathname, &attr_list, UDA_API_VALUE);
+	switch (retval)
+	{
+	case 0:
+		break;
+	case -ENOENT:
+		return GLOBUS_SUCCESS;
+	default:
+		return GlobusGFSErrorSystemError("hpss_UserAttrGetAttrs", -retval);
+	}
+
+	tmp = hpss_ChompXMLHeader(value, NULL);
+	if (!tmp)
+		return GLOBUS_SUCCESS;
+
+	journal_parse(tmp, Stamp, Ranges, Count);
+	free(tmp);
+	return GLOBUS_SUCCESS;
+}
+
+/* Loads the ranges of Pathname's journal, if they still describe the file. */
+static globus_result_t
+journal_load(char * Pathname, journal_range_t * Ranges, int * Count)
+{
+	journal_stamp_t journal_stamp;
+	journal_stamp_t file_stamp;
+	globus_result_t result = GLOBUS_SUCCESS;
+
+	result = journal_read(Pathname, &journal_stamp, Ranges, Count);
+	if (result || *Count == 0)
+		return result;
+
+	result = journal_stat(Pathname, &file_stamp);
+	if (result)
+		return result;
+
+	if (journal_stamp.Size  != file_stamp.Size ||
+	    journal_stamp.MTime != file_stamp.MTime)
+	{
+		*Count = 0;
+	}
+	return GLOBUS_SUCCESS;
+}
+
+/* Stamps the ranges with the file as it is now. No ranges clears the journal. */
+static globus_result_t
+journal_write(char * Pathname, journal_range_t * Ranges, int Count)
+{
+	int                  retval = 0;
+	char                 value[HPSS_XML_SIZE];
+	journal_stamp_t      stamp;
+	hpss_userattr_t      user_attrs[1];
+	hpss_userattr_list_t attr_list;
+	globus_result_t      result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(journal_write);
+
+	if (Count)
+	{
+		result = journal_stat(Pathname, &stamp);
+		if (result)
+			return result;
+	}
+
+	journal_format(&stamp, Ranges, Count, value, sizeof(value));
+
+	attr_list.len  = sizeof(user_attrs)/sizeof(*user_attrs);
+	attr_list.Pair = user_attrs;
+
+	attr_list.Pair[0].Key   = JOURNAL_UDA_KEY;
+	attr_list.Pair[0].Value = value;
+
+	retval = hpss_UserAttrSetAttrs(Pathname, &attr_list, NULL);
+	if (retval)
+		return GlobusGFSErrorSystemError("hpss_UserAttrSetAttrs", -retval);
+	return GLOBUS_SUCCESS;
+}
+
+globus_result_t
+journal_init(char          * Pathname,
+             globus_bool_t   Truncate,
+             config_t      * Config,
+             journal_t    ** Journal)
+{
+	int             count  = 0;
+	globus_result_t result = GLOBUS_SUCCESS;
+	journal_stamp_t stamp;
+	journal_range_t ranges[JOURNAL_MAX_RANGES];
+
+	GlobusGFSName(journal_init);
+
+	*Journal = NULL;
+
+	if (!Config->StorJournalSupport)
+	{
+		/*
+		 * Don't leave a journal from when the option was on behind. The
+		 * stamp would catch it anyway, so this is best effort.
+		 */
+		if (Truncate == GLOBUS_TRUE)
+		{
+			result = journal_read(Pathname, &stamp, ranges, &count);
+			if (!result && count)
+				result = journal_write(Pathname, NULL, 0);
+			if (result)
+				globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+				                       "Unable to clear the STOR journal of %s\n",
+				                       Pathname);
+		}
+		return GLOBUS_SUCCESS;
+	}
+
+	*Journal = calloc(1, sizeof(journal_t));
+	if (!*Journal)
+		return GlobusGFSErrorMemory("journal_t");
+
+	(*Journal)->Pathname = strdup(Pathname);
+	if (!(*Journal)->Pathname)
+	{
+		result = GlobusGFSErrorMemory("journal_t");
+		goto cleanup;
+	}
+	(*Journal)->Interval = (globus_off_t)Config->StorJournalInterval * 1024 * 1024;
+
+	if (Truncate == GLOBUS_TRUE)
+	{
+		/* Whatever an earlier upload committed is gone. */
+		result = journal_write(Pathname, NULL, 0);
+	} else
+	{
+		result = journal_load(Pathname, (*Journal)->Ranges, &(*Journal)->Count);
+		(*Journal)->Dirty = (*Journal)->Count > 0;
+	}
+
+cleanup:
+	if (result)
+	{
+		journal_destroy(*Journal);
+		*Journal = NULL;
+	}
+	return result;
+}
+
+globus_result_t
+journal_commit(journal_t * Journal, globus_off_t Offset, globus_off_t Length)
+{
+	if (Length <= 0)
+		return GLOBUS_SUCCESS;
+
+	journal_insert(Journal->Ranges, &Journal->Count, Offset, Offset + Length);
+	Journal->Dirty = 1;
+	return journal_write(Journal->Pathname, Journal->Ranges, Journal->Count);
+}
+
+globus_off_t
+journal_segment(journal_t * Journal, globus_off_t Length)
+{
+	if (Journal && Length > Journal->Interval)
+		return Journal->Interval;
+	return Length;
+}
+
+globus_result_t
+journal_clear(journal_t * Journal)
+{
+	if (!Journal->Dirty)
+		return GLOBUS_SUCCESS;
+
+	Journal->Count = 0;
+	Journal->Dirty = 0;
+	return journal_write(Journal->Pathname, NULL, 0);
+}
+
+globus_result_t
+journal_save(journal_t * Journal)
+{
+	if (!Journal->Count)
+		return GLOBUS_SUCCESS;
+
+	return journal_write(Journal->Pathname, Journal->Ranges, Journal->Count);
+}
+
+void
+journal_destroy(journal_t * Journal)
+{
+	if (Journal)
+	{
+		if (Journal->Pathname)
+			free(Journal->Pathname);
+		free(Journal);
+	}
+}
+
+static globus_bool_t
+journal_contains(journal_range_t * Ranges,
+                 int               Count,
+                 globus_off_t      Offset,
+                 globus_off_t      End)
+{
+	int i;
+
+	for (i = 0; i < Count; i++)
+	{
+		if (Ranges[i].Offset <= Offset && Ranges[i].End >= End)
+			return GLOBUS_TRUE;
+	}
+	return GLOBUS_FALSE;
+}
+
+globus_bool_t
+journal_restart_allowed(char                * Pathname,
+                        globus_range_list_t   RangeList,
+                        config_t            * Config)
+{
+	int             i        = 0;
+	int             count    = 0;
+	globus_off_t    offset   = 0;
+	globus_off_t    length   = 0;
+	globus_off_t    prev_end = 0;
+	journal_range_t ranges[JOURNAL_MAX_RANGES];
+
+	if (!Config->StorJournalSupport)
+		return GLOBUS_FALSE;
+
+	if (journal_load(Pathname, ranges, &count) != GLOBUS_SUCCESS)
+		return GLOBUS_FALSE;
+
+	/* The gaps between the ranges to be sent must already be in HPSS. */
+	for (i = 0; i < globus_range_list_size(RangeList); i++)
+	{
+		globus_range_list_at(RangeList, i, &offset, &length);
+
+		if (offset > prev_end && !journal_contains(ranges, count, prev_end, offset))
+			return GLOBUS_FALSE;
+
+		if (length == -1)
+			return GLOBUS_TRUE;
+		prev_end = offset + length;
+	}
+
+	/* We can't tell how much of the tail the client thinks is there. */
+	return GLOBUS_FALSE;
+}
+
+void
+journal_command(globus_gfs_operation_t      Operation,
+                globus_gfs_command_info_t * CommandInfo,
+                config_t                  * Config,
+                commands_callback           Callback)
+{
+	int               count          = 0;
+	char            * command_output = NULL;
+	globus_result_t   result         = GLOBUS_SUCCESS;
+	char              value[HPSS_XML_SIZE];
+	journal_range_t   ranges[JOURNAL_MAX_RANGES];
+
+	result = journal_load(CommandInfo->pathname, ranges, &count);
+	if (result)
+		goto cleanup;
+
+	journal_format(NULL, ranges, count, value, sizeof(value));
+
+	command_output = globus_common_create_string("250 %s\r\n", count ? value : "0-0");
+
+cleanup:
+	Callback(Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+}
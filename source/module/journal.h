@@ -0,0 +1,130 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_JOURNAL_H
+#define HPSS_DSI_JOURNAL_H
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "commands.h"
+#include "config.h"
+
+/*
+ * The STOR commit journal. Ranges that hpss_PIOExecute() has confirmed are
+ * written to this UDA as a restart marker, ie '0-1073741824,2147483648-...',
+ * so that an interrupted upload can resume from what is durable in HPSS.
+ * The ranges are stamped with the file's size and mtime at each write and
+ * are ignored once the file no longer matches.
+ */
+#define JOURNAL_UDA_KEY    "/hpss/user/gridftp/journal"
+#define JOURNAL_MAX_RANGES 16
+
+typedef struct {
+	globus_off_t Offset;
+	globus_off_t End;
+} journal_range_t;
+
+typedef struct {
+	char            * Pathname;
+	globus_off_t      Interval; // Most bytes committed by one PIO execute
+	int               Dirty;    // Ranges have been written to the UDA
+	int               Count;
+	journal_range_t   Ranges[JOURNAL_MAX_RANGES];
+} journal_t;
+
+/*
+ * Starts journaling a STOR of Pathname. A truncating STOR starts with an
+ * empty journal, clearing any left by an earlier upload, even when
+ * StorJournalSupport is off; otherwise the existing journal is loaded and
+ * extended. Returns with *Journal NULL when StorJournalSupport is off.
+ */
+globus_result_t
+journal_init(char          * Pathname,
+             globus_bool_t   Truncate,
+             config_t      * Config,
+             journal_t    ** Journal);
+
+/* Records that Offset, Length is durable in HPSS. */
+globus_result_t
+journal_commit(journal_t * Journal, globus_off_t Offset, globus_off_t Length);
+
+/* Limits Length so that each PIO execute ends at a journal commit. */
+globus_off_t
+journal_segment(journal_t * Journal, globus_off_t Length);
+
+/* The upload completed; the journal is no longer needed. */
+globus_result_t
+journal_clear(journal_t * Journal);
+
+/* The upload failed. Restamps the journal once the file has been closed. */
+globus_result_t
+journal_save(journal_t * Journal);
+
+void
+journal_destroy(journal_t * Journal);
+
+/*
+ * Returns true if every byte outside of RangeList, the ranges a restarted
+ * STOR will send, is in Pathname's journal.
+ */
+globus_bool_t
+journal_restart_allowed(char                * Pathname,
+                        globus_range_list_t   RangeList,
+                        config_t            * Config);
+
+/*
+ * SITE STORJOURNAL <sp> path
+ *
+ * Replies with the ranges of path that are durable in HPSS in restart
+ * marker form, suitable for REST, or '0-0' if there are none.
+ */
+void
+journal_command(globus_gfs_operation_t      Operation,
+                globus_gfs_command_info_t * CommandInfo,
+                config_t                  * Config,
+                commands_callback           Callback);
+
+#endif /* HPSS_DSI_JOURNAL_H */
@@ -0,0 +1,592 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+
+/*
+ * Local includes
+ */
+#include "listing.h"
+#include "stage.h"
+#include "cksm.h"
+#include "stat.h"
+#include "walk.h"
+#include "rpcstats.h"
+
+#define LISTING_ENTRIES_PER_CHUNK 200
+
+typedef struct {
+	pthread_mutex_t     Mutex;
+	ns_ObjHandle_t    * ObjHandle;
+	char              * DirPath;
+	config_t          * Config;
+	globus_gfs_stat_t * GFSStatArray;
+	listing_facts_t   * FactsArray;
+	uint32_t            Count;
+	uint32_t            NextIndex;
+	int                 FactMask;
+} listing_batch_t;
+
+/* "/" unless DirPath already ends in one, ie is the root. */
+static const char *
+listing_path_separator(const char * DirPath)
+{
+	size_t length = strlen(DirPath);
+	return (length > 0 && DirPath[length - 1] == '/') ? "" : "/";
+}
+
+static void *
+listing_facts_thread(void * Arg)
+{
+	listing_batch_t   * batch = Arg;
+	listing_facts_t   * facts    = NULL;
+	globus_gfs_stat_t * gfs_stat = NULL;
+	globus_result_t     result   = GLOBUS_SUCCESS;
+	uint32_t            index    = 0;
+	char              * pathname = NULL;
+
+	rpcstats_set_op(RPCSTATS_OP_COMMAND);
+
+	while (1)
+	{
+		pthread_mutex_lock(&batch->Mutex);
+		{
+			index = batch->NextIndex++;
+		}
+		pthread_mutex_unlock(&batch->Mutex);
+
+		if (index >= batch->Count)
+			break;
+
+		gfs_stat = &batch->GFSStatArray[index];
+		facts    = &batch->FactsArray[index];
+
+		/* Residency only has meaning for regular files. */
+		if (!S_ISREG(gfs_stat->mode))
+			continue;
+
+		if (batch->FactMask & (LISTING_FACT_RESIDENCY|LISTING_FACT_TAPE))
+		{
+			result = stage_get_residency_handle(batch->ObjHandle,
+			                                    gfs_stat->name,
+			                                    &facts->Residency,
+			                                    (batch->FactMask & LISTING_FACT_TAPE) ?
+			                                        &facts->TapeVolume : NULL);
+			if (result == GLOBUS_SUCCESS)
+				facts->Valid = 1;
+		}
+
+		/*
+		 * Only report checksums already cached in UDAs; never compute
+		 * one here.
+		 */
+		if (batch->FactMask & LISTING_FACT_CKSUM)
+		{
+			pathname = globus_common_create_string("%s%s%s",
+			                                       batch->DirPath,
+			                                       listing_path_separator(batch->DirPath),
+			                                       gfs_stat->name);
+			if (pathname)
+			{
+				checksum_get_file_sum(pathname, batch->Config, &facts->Checksum);
+				globus_free(pathname);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void
+listing_get_facts(ns_ObjHandle_t    * ObjHandle,
+                  char              * DirPath,
+                  config_t          * Config,
+                  globus_gfs_stat_t * GFSStatArray,
+                  uint32_t            Count,
+                  int                 FactMask,
+                  listing_facts_t   * FactsArray)
+{
+	int             i            = 0;
+	int             thread_count = 0;
+	pthread_t       threads[LISTING_FACT_THREADS];
+	listing_batch_t batch;
+
+	memset(FactsArray, 0, sizeof(listing_facts_t) * Count);
+
+	/*
+	 * Nothing to report without UDA checksums. HPSS has no UDA read
+	 * spanning files, so each checksum costs a round trip per entry; the
+	 * site has to opt in.
+	 */
+	if (!Config->UDAChecksumSupport || !Config->ListingChecksumSupport)
+		FactMask &= ~LISTING_FACT_CKSUM;
+
+	if (!(FactMask & (LISTING_FACT_RESIDENCY|LISTING_FACT_TAPE|LISTING_FACT_CKSUM)) || Count == 0)
+		return;
+
+	pthread_mutex_init(&batch.Mutex, NULL);
+	batch.ObjHandle    = ObjHandle;
+	batch.DirPath      = DirPath;
+	batch.Config       = Config;
+	batch.GFSStatArray = GFSStatArray;
+	batch.FactsArray   = FactsArray;
+	batch.Count        = Count;
+	batch.NextIndex    = 0;
+	batch.FactMask     = FactMask;
+
+	/*
+	 * Each entry costs a round trip to the core server so spread them
+	 * out. This thread takes part as well so a failure to launch helpers
+	 * only costs us concurrency.
+	 */
+	for (i = 1; i < LISTING_FACT_THREADS && i < Count; i++)
+	{
+		if (pthread_create(&threads[thread_count], NULL, listing_facts_thread, &batch))
+			break;
+		thread_count++;
+	}
+
+	listing_facts_thread(&batch);
+
+	for (i = 0; i < thread_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&batch.Mutex);
+}
+
+void
+listing_destroy_facts(listing_facts_t * FactsArray, uint32_t Count)
+{
+	int i;
+	for (i = 0; i < Count; i++)
+	{
+		if (FactsArray[i].TapeVolume)
+			free(FactsArray[i].TapeVolume);
+		if (FactsArray[i].Checksum)
+			free(FactsArray[i].Checksum);
+	}
+}
+
+static const char *
+listing_residency_string(stage_file_residency Residency)
+{
+	switch (Residency)
+	{
+	case STAGE_FILE_RESIDENT:
+		return "resident";
+	case STAGE_FILE_TAPE_ONLY:
+		return "tape-only";
+	case STAGE_FILE_ARCHIVED:
+		return "archived";
+	}
+	return "unknown";
+}
+
+/*
+ * Formats one entry in the style of an MLSx fact line:
+ *  type=file;size=1024;modify=20170101120000;unix.mode=0644;x.hpss.residency=archived;x.hpss.tape=A00001;x.cksum=md5:d41d8cd98f00b204e9800998ecf8427e; name
+ * If Prefix is given, the name is reported as Prefix/name.
+ */
+static char *
+listing_format_entry(globus_gfs_stat_t * GFSStat,
+                     listing_facts_t   * Facts,
+                     int                 FactMask,
+                     char              * Prefix)
+{
+	char         modify[32];
+	char         residency[64] = "";
+	char         tape[128]     = "";
+	char         cksum[128]    = "";
+	const char * type          = "file";
+	struct tm    tm;
+
+	if (S_ISDIR(GFSStat->mode))
+		type = "dir";
+	else if (S_ISLNK(GFSStat->mode))
+		type = "OS.unix=symlink";
+
+	gmtime_r(&GFSStat->mtime, &tm);
+	strftime(modify, sizeof(modify), "%Y%m%d%H%M%S", &tm);
+
+	if (Facts && Facts->Valid)
+	{
+		if (FactMask & LISTING_FACT_RESIDENCY)
+			snprintf(residency,
+			         sizeof(residency),
+			         "x.hpss.residency=%s;",
+			         listing_residency_string(Facts->Residency));
+
+		if ((FactMask & LISTING_FACT_TAPE) && Facts->TapeVolume)
+			snprintf(tape, sizeof(tape), "x.hpss.tape=%s;", Facts->TapeVolume);
+	}
+
+	if (Facts && Facts->Checksum && (FactMask & LISTING_FACT_CKSUM))
+		snprintf(cksum, sizeof(cksum), "x.cksum=md5:%s;", Facts->Checksum);
+
+	return globus_common_create_string("type=%s;size=%"GLOBUS_OFF_T_FORMAT";modify=%s;unix.mode=0%o;%s%s%s %s%s%s",
+	                                   type,
+	                                   GFSStat->size,
+	                                   modify,
+	                                   GFSStat->mode & 07777,
+	                                   residency,
+	                                   tape,
+	                                   cksum,
+	                                   Prefix ? Prefix : "",
+	                                   Prefix ? "/" : "",
+	                                   GFSStat->name);
+}
+
+static globus_result_t
+listing_parse_facts(char * FactList, int * FactMask)
+{
+	char * fact    = NULL;
+	char * saveptr = NULL;
+	char * copy    = NULL;
+
+	GlobusGFSName(listing_parse_facts);
+
+	*FactMask = 0;
+
+	copy = strdup(FactList);
+	if (!copy)
+		return GlobusGFSErrorMemory("fact list");
+
+	for (fact = strtok_r(copy, ",", &saveptr); fact; fact = strtok_r(NULL, ",", &saveptr))
+	{
+		if (strcasecmp(fact, "residency") == 0)
+			*FactMask |= LISTING_FACT_RESIDENCY;
+		else if (strcasecmp(fact, "tape") == 0)
+			*FactMask |= LISTING_FACT_TAPE;
+		else if (strcasecmp(fact, "cksum") == 0)
+			*FactMask |= LISTING_FACT_CKSUM;
+		else if (strcasecmp(fact, "all") == 0)
+			*FactMask |= LISTING_FACT_RESIDENCY|LISTING_FACT_TAPE|LISTING_FACT_CKSUM;
+		else if (strcasecmp(fact, "none") == 0)
+			continue;
+		else
+		{
+			free(copy);
+			return GlobusGFSErrorGeneric("Unknown listing fact");
+		}
+	}
+
+	free(copy);
+	return GLOBUS_SUCCESS;
+}
+
+static void
+listing_send_entries(globus_gfs_operation_t   Operation,
+                     globus_gfs_stat_t      * GFSStatArray,
+                     listing_facts_t        * FactsArray,
+                     uint32_t                 Count,
+                     int                      FactMask,
+                     char                   * Prefix)
+{
+	int    i;
+	char * line = NULL;
+
+	/*
+	 * One intermediate reply per entry keeps each reply to a single line
+	 * regardless of how the server frames intermediate responses.
+	 */
+	for (i = 0; i < Count; i++)
+	{
+		line = listing_format_entry(&GFSStatArray[i], FactsArray ? &FactsArray[i] : NULL, FactMask, Prefix);
+		if (!line)
+			continue;
+
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, line);
+		globus_free(line);
+	}
+}
+
+/*
+ * SITE LSFACTS <sp> facts <sp> path
+ *
+ * Lists path (a directory or a single object) with the requested HPSS facts
+ * attached to each entry so that clients can plan recalls without issuing
+ * SITE STAGE per file and skip CKSM for files with a cached checksum. facts
+ * is a comma separated list of 'residency', 'tape', 'cksum' or 'all'.
+ */
+void
+listing(globus_gfs_operation_t      Operation,
+        globus_gfs_command_info_t * CommandInfo,
+        config_t                  * Config,
+        commands_callback           Callback)
+{
+	int               retval         = 0;
+	int               fact_mask      = 0;
+	char           ** argv           = NULL;
+	int               argc           = 0;
+	char            * command_output = NULL;
+	uint64_t          offset         = 0;
+	uint32_t          end            = FALSE;
+	uint32_t          count_out      = 0;
+	globus_result_t   result         = GLOBUS_SUCCESS;
+	hpss_fileattr_t   dir_attrs;
+	globus_gfs_stat_t gfs_stat;
+	globus_gfs_stat_t gfs_stat_array[LISTING_ENTRIES_PER_CHUNK];
+	listing_facts_t   facts_array[LISTING_ENTRIES_PER_CHUNK];
+
+	GlobusGFSName(listing);
+
+	/* Get the command arguments. */
+	result = globus_gridftp_server_query_op_info(Operation,
+	                                             CommandInfo->op_info,
+	                                             GLOBUS_GFS_OP_INFO_CMD_ARGS,
+	                                             &argv,
+	                                             &argc);
+	if (result)
+	{
+		result = GlobusGFSErrorWrapFailed("Unable to get command args", result);
+		goto cleanup;
+	}
+
+	result = listing_parse_facts(argv[2], &fact_mask);
+	if (result)
+		goto cleanup;
+
+	result = stat_object(CommandInfo->pathname, &gfs_stat);
+	if (result)
+		goto cleanup;
+
+	if (!S_ISDIR(gfs_stat.mode))
+	{
+		/* Single object. */
+		memset(&facts_array[0], 0, sizeof(listing_facts_t));
+		if (S_ISREG(gfs_stat.mode) && (fact_mask & (LISTING_FACT_RESIDENCY|LISTING_FACT_TAPE)))
+		{
+			facts_array[0].Valid = !stage_get_residency_handle(NULL,
+			                                        CommandInfo->pathname,
+			                                        &facts_array[0].Residency,
+			                                        (fact_mask & LISTING_FACT_TAPE) ?
+			                                            &facts_array[0].TapeVolume : NULL);
+		}
+		if (S_ISREG(gfs_stat.mode) && (fact_mask & LISTING_FACT_CKSUM) && Config->ListingChecksumSupport)
+			checksum_get_file_sum(CommandInfo->pathname, Config, &facts_array[0].Checksum);
+
+		listing_send_entries(Operation, &gfs_stat, facts_array, 1, fact_mask, NULL);
+		listing_destroy_facts(facts_array, 1);
+		stat_destroy(&gfs_stat);
+		goto cleanup;
+	}
+	stat_destroy(&gfs_stat);
+
+	retval = hpss_FileGetAttributes(CommandInfo->pathname, &dir_attrs);
+	if (retval < 0)
+	{
+		result = GlobusGFSErrorSystemError("hpss_FileGetAttributes", -retval);
+		goto cleanup;
+	}
+
+	while (!end)
+	{
+		result = stat_directory_entries(&dir_attrs.ObjectHandle,
+		                                offset,
+		                                LISTING_ENTRIES_PER_CHUNK,
+		                                &end,
+		                                &offset,
+		                                gfs_stat_array,
+		                                NULL,
+		                                &count_out);
+		if (result)
+			break;
+
+		listing_get_facts(&dir_attrs.ObjectHandle,
+		                  CommandInfo->pathname,
+		                  Config,
+		                  gfs_stat_array,
+		                  count_out,
+		                  fact_mask,
+		                  facts_array);
+
+		listing_send_entries(Operation, gfs_stat_array, facts_array, count_out, fact_mask, NULL);
+
+		listing_destroy_facts(facts_array, count_out);
+		stat_destroy_array(gfs_stat_array, count_out);
+	}
+
+cleanup:
+	if (!result)
+		command_output = globus_common_create_string("250 End of listing of %s.\r\n",
+		                                             CommandInfo->pathname);
+
+	Callback(Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+}
+
+typedef struct {
+	pthread_mutex_t          Mutex;
+	globus_gfs_operation_t   Operation;
+	config_t               * Config;
+	int                      FactMask;
+} listing_recursive_t;
+
+static globus_result_t
+listing_recursive_entries(walk_dir_t        * Dir,
+                          globus_gfs_stat_t * GFSStatArray,
+                          uint32_t            Count,
+                          void              * UserArg)
+{
+	listing_recursive_t * recursive = UserArg;
+	listing_facts_t     * facts_array = NULL;
+
+	GlobusGFSName(listing_recursive_entries);
+
+	facts_array = malloc(sizeof(listing_facts_t) * Count);
+	if (!facts_array)
+		return GlobusGFSErrorMemory("listing_facts_t array");
+
+	listing_get_facts(&Dir->ObjHandle,
+	                  Dir->Path,
+	                  recursive->Config,
+	                  GFSStatArray,
+	                  Count,
+	                  recursive->FactMask,
+	                  facts_array);
+
+	/* Keep each directory chunk together in the reply stream. */
+	pthread_mutex_lock(&recursive->Mutex);
+	{
+		listing_send_entries(recursive->Operation,
+		                     GFSStatArray,
+		                     facts_array,
+		                     Count,
+		                     recursive->FactMask,
+		                     Dir->RelPath[0] ? Dir->RelPath : NULL);
+	}
+	pthread_mutex_unlock(&recursive->Mutex);
+
+	listing_destroy_facts(facts_array, Count);
+	free(facts_array);
+	return GLOBUS_SUCCESS;
+}
+
+/*
+ * SITE RLIST <sp> depth <sp> facts <sp> path
+ *
+ * Recursive form of SITE LSFACTS. Every object below the directory path, down
+ * to depth levels of subdirectories (negative for no limit), is reported with
+ * its name relative to path. Directories are read in parallel so entries from
+ * different directories are interleaved. facts is as for SITE LSFACTS or
+ * 'none'.
+ */
+void
+listing_recursive(globus_gfs_operation_t      Operation,
+                  globus_gfs_command_info_t * CommandInfo,
+                  config_t                  * Config,
+                  commands_callback           Callback)
+{
+	int                   depth          = 0;
+	char               ** argv           = NULL;
+	int                   argc           = 0;
+	char                * endptr         = NULL;
+	char                * command_output = NULL;
+	globus_result_t       result         = GLOBUS_SUCCESS;
+	listing_recursive_t   recursive;
+
+	GlobusGFSName(listing_recursive);
+
+	/* Get the command arguments. */
+	result = globus_gridftp_server_query_op_info(Operation,
+	                                             CommandInfo->op_info,
+	                                             GLOBUS_GFS_OP_INFO_CMD_ARGS,
+	                                             &argv,
+	                                             &argc);
+	if (result)
+	{
+		result = GlobusGFSErrorWrapFailed("Unable to get command args", result);
+		goto cleanup;
+	}
+
+	depth = strtol(argv[2], &endptr, 0);
+	if (*argv[2] == '\0' || *endptr != '\0')
+	{
+		result = GlobusGFSErrorGeneric("Illegal depth value");
+		goto cleanup;
+	}
+
+	memset(&recursive, 0, sizeof(recursive));
+	result = listing_parse_facts(argv[3], &recursive.FactMask);
+	if (result)
+		goto cleanup;
+
+	pthread_mutex_init(&recursive.Mutex, NULL);
+	recursive.Operation = Operation;
+	recursive.Config    = Config;
+
+	result = walk(CommandInfo->pathname,
+	              depth,
+	              Config->WalkThreads,
+	              0,
+	              listing_recursive_entries,
+	              NULL,
+	              &recursive);
+
+	pthread_mutex_destroy(&recursive.Mutex);
+
+cleanup:
+	if (!result)
+		command_output = globus_common_create_string("250 End of recursive listing of %s.\r\n",
+		                                             CommandInfo->pathname);
+
+	Callback(Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+}
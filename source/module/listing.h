@@ -0,0 +1,110 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_LISTING_H
+#define HPSS_DSI_LISTING_H
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <ns_ObjHandle.h>
+
+/*
+ * Local includes
+ */
+#include "commands.h"
+#include "config.h"
+#include "stage.h"
+
+/*
+ * Extra facts that can be requested with SITE LSFACTS. These are in
+ * addition to the POSIX facts returned by stat_directory_entries().
+ */
+#define LISTING_FACT_RESIDENCY 0x01
+#define LISTING_FACT_TAPE      0x02
+#define LISTING_FACT_CKSUM     0x04
+
+/* Max threads used to look up the extra facts for one chunk of entries. */
+#define LISTING_FACT_THREADS 8
+
+typedef struct {
+	int                  Valid;      // Set if Residency/TapeVolume were retrieved
+	stage_file_residency Residency;
+	char               * TapeVolume; // NULL if no tape copy
+	char               * Checksum;   // NULL if no valid checksum UDA
+} listing_facts_t;
+
+/*
+ * Looks up the requested facts for each regular file in GFSStatArray, which
+ * are entries of the directory DirPath (with handle ObjHandle). Lookups are
+ * spread across up to LISTING_FACT_THREADS threads. Failures for individual
+ * entries leave that entry's facts invalid; they are not an error for the
+ * listing.
+ */
+void
+listing_get_facts(ns_ObjHandle_t    * ObjHandle,
+                  char              * DirPath,
+                  config_t          * Config,
+                  globus_gfs_stat_t * GFSStatArray,
+                  uint32_t            Count,
+                  int                 FactMask,
+                  listing_facts_t   * FactsArray);
+
+void
+listing_destroy_facts(listing_facts_t * FactsArray, uint32_t Count);
+
+void
+listing(globus_gfs_operation_t      Operation,
+        globus_gfs_command_info_t * CommandInfo,
+        config_t                  * Config,
+        commands_callback           Callback);
+
+void
+listing_recursive(globus_gfs_operation_t      Operation,
+                  globus_gfs_command_info_t * CommandInfo,
+                  config_t                  * Config,
+                  commands_callback           Callback);
+
+#endif /* HPSS_DSI_LISTING_H */
@@ -48,6 +48,7 @@
  * System includes.
  */
 #include <pthread.h>
+#include <string.h>
 
 /*
  * Local includes.
@@ -110,3 +111,148 @@ markers_restart_supported()
 	_init_symbols();
 	return (_globus_restart_markers != NULL);
 }
+
+/*
+ * Reports the pending ranges. Caller holds Markers->Lock.
+ */
+static void
+markers_report(markers_t * Markers)
+{
+	globus_off_t end = 0;
+
+	end = Markers->PerfEnd;
+	if (end > Markers->PerfStart)
+	{
+		markers_update_perf_markers(Markers->Operation,
+		                            Markers->PerfStart,
+		                            end - Markers->PerfStart);
+		Markers->PerfStart = end;
+	}
+
+	end = Markers->RestartEnd;
+	if (end > Markers->RestartStart)
+	{
+		markers_update_restart_markers(Markers->Operation,
+		                               Markers->RestartStart,
+		                               end - Markers->RestartStart);
+		Markers->RestartStart = end;
+	}
+}
+
+void
+markers_flush(markers_t * Markers)
+{
+	pthread_mutex_lock(&Markers->Lock);
+	{
+		markers_report(Markers);
+	}
+	pthread_mutex_unlock(&Markers->Lock);
+}
+
+static void
+markers_timer(void * UserArg)
+{
+	markers_flush(UserArg);
+}
+
+static void
+markers_timer_stopped(void * UserArg)
+{
+	markers_t * markers = UserArg;
+
+	pthread_mutex_lock(&markers->Lock);
+	{
+		markers->TimerRunning = 0;
+		pthread_cond_broadcast(&markers->Cond);
+	}
+	pthread_mutex_unlock(&markers->Lock);
+}
+
+void
+markers_init(markers_t * Markers, globus_gfs_operation_t Operation)
+{
+	globus_reltime_t delay;
+
+	memset(Markers, 0, sizeof(markers_t));
+	Markers->Operation = Operation;
+	pthread_mutex_init(&Markers->Lock, NULL);
+	pthread_cond_init(&Markers->Cond, NULL);
+
+	/* Without the timer, updates still go out by size and at the end. */
+	GlobusTimeReltimeSet(delay, MARKERS_FLUSH_INTERVAL, 0);
+	if (globus_callback_register_periodic(&Markers->CallbackHandle,
+	                                      &delay,
+	                                      &delay,
+	                                      markers_timer,
+	                                      Markers) == GLOBUS_SUCCESS)
+	{
+		Markers->TimerRunning = 1;
+	}
+}
+
+/*
+ * Moves the pending range to Offset if the update does not follow on from
+ * it. Anything pending is reported first.
+ */
+static void
+markers_restart_range(markers_t             * Markers,
+                      globus_off_t          * Start,
+                      volatile globus_off_t * End,
+                      globus_off_t            Offset)
+{
+	pthread_mutex_lock(&Markers->Lock);
+	{
+		markers_report(Markers);
+		*Start = Offset;
+		*End   = Offset;
+	}
+	pthread_mutex_unlock(&Markers->Lock);
+}
+
+void
+markers_add_perf(markers_t * Markers, globus_off_t Offset, globus_off_t Length)
+{
+	if (Offset != Markers->PerfEnd)
+		markers_restart_range(Markers, &Markers->PerfStart, &Markers->PerfEnd, Offset);
+
+	if (__sync_add_and_fetch(&Markers->PerfEnd, Length) - Markers->PerfStart >= MARKERS_FLUSH_BYTES)
+		markers_flush(Markers);
+}
+
+void
+markers_add_restart(markers_t * Markers, globus_off_t Offset, globus_off_t Length)
+{
+	if (Offset != Markers->RestartEnd)
+		markers_restart_range(Markers, &Markers->RestartStart, &Markers->RestartEnd, Offset);
+
+	if (__sync_add_and_fetch(&Markers->RestartEnd, Length) - Markers->RestartStart >= MARKERS_FLUSH_BYTES)
+		markers_flush(Markers);
+}
+
+void
+markers_destroy(markers_t * Markers)
+{
+	if (!Markers->Operation)
+		return;
+
+	if (Markers->TimerRunning)
+	{
+		globus_callback_unregister(Markers->CallbackHandle,
+		                           markers_timer_stopped,
+		                           Markers,
+		                           NULL);
+
+		pthread_mutex_lock(&Markers->Lock);
+		{
+			while (Markers->TimerRunning)
+				pthread_cond_wait(&Markers->Cond, &Markers->Lock);
+		}
+		pthread_mutex_unlock(&Markers->Lock);
+	}
+
+	markers_flush(Markers);
+
+	pthread_mutex_destroy(&Markers->Lock);
+	pthread_cond_destroy(&Markers->Cond);
+	Markers->Operation = NULL;
+}
@@ -47,6 +47,11 @@
 #ifndef HPSS_DSI_MARKERS_H
 #define HPSS_DSI_MARKERS_H
 
+/*
+ * System includes.
+ */
+#include <pthread.h>
+
 /*
  * Globus includes.
  */
@@ -65,4 +70,51 @@ markers_update_restart_markers(globus_gfs_operation_t Operation,
 int
 markers_restart_supported();
 
+/*
+ * Pending marker updates are flushed to GridFTP at least this often (seconds)
+ * or once this many bytes have accumulated, whichever comes first.
+ */
+#define MARKERS_FLUSH_INTERVAL 1
+#define MARKERS_FLUSH_BYTES    (64*1024*1024)
+
+/*
+ * Per transfer marker state. The data path only extends the pending
+ * [Start, End) ranges with an atomic add; the ranges are reported from a
+ * periodic callback, when they pass MARKERS_FLUSH_BYTES or when the next
+ * update is not contiguous with them. Each range must only be extended
+ * from one thread at a time.
+ */
+typedef struct {
+	globus_gfs_operation_t   Operation;
+	pthread_mutex_t          Lock; // Serializes flushes
+	pthread_cond_t           Cond;
+	int                      TimerRunning;
+	globus_callback_handle_t CallbackHandle;
+
+	globus_off_t             PerfStart;
+	volatile globus_off_t    PerfEnd;
+	globus_off_t             RestartStart;
+	volatile globus_off_t    RestartEnd;
+} markers_t;
+
+void
+markers_init(markers_t * Markers, globus_gfs_operation_t Operation);
+
+void
+markers_add_perf(markers_t * Markers, globus_off_t Offset, globus_off_t Length);
+
+void
+markers_add_restart(markers_t * Markers, globus_off_t Offset, globus_off_t Length);
+
+/* Reports anything pending. */
+void
+markers_flush(markers_t * Markers);
+
+/*
+ * Stops the timer and reports anything pending. Call it before finishing
+ * the transfer. It is a no-op on a zeroed markers_t.
+ */
+void
+markers_destroy(markers_t * Markers);
+
 #endif /* HPSS_DSI_MARKERS_H */
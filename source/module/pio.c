@@ -43,12 +43,69 @@
  * System includes
  */
 #include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 
 /*
  * Local includes
  */
+#include "bufpool.h"
 #include "pio.h"
+#include "placement.h"
 #include "markers.h"
+#include "rpcstats.h"
+#include "trace.h"
+
+static int pio_retries     = DEFAULT_PIO_RETRIES;
+static int pio_retry_delay = DEFAULT_PIO_RETRY_DELAY;
+
+void
+pio_init(config_t * Config)
+{
+	pio_retries     = Config->PIORetries;
+	pio_retry_delay = Config->PIORetryDelay;
+}
+
+/*
+ * Errors that a mover or network hiccup can produce and that a second
+ * attempt may get past. Anything else (permissions, space, a bad handle)
+ * fails the transfer right away.
+ */
+static int
+pio_error_is_transient(int Error)
+{
+	switch (-Error)
+	{
+	case EIO:
+	case EAGAIN:
+	case EBUSY:
+	case ETIMEDOUT:
+	case EPIPE:
+	case ECONNRESET:
+	case ECONNREFUSED:
+	case ECONNABORTED:
+	case ENETDOWN:
+	case ENETUNREACH:
+	case EHOSTUNREACH:
+		return 1;
+	}
+	return 0;
+}
+
+/* Doubles with each attempt, up to PIO_RETRY_MAX_DELAY. */
+static int
+pio_retry_backoff(int Attempt)
+{
+	long delay = pio_retry_delay;
+
+	while (--Attempt > 0 && delay < PIO_RETRY_MAX_DELAY)
+		delay *= 2;
+
+	if (delay > PIO_RETRY_MAX_DELAY)
+		delay = PIO_RETRY_MAX_DELAY;
+	return delay;
+}
 
 globus_result_t
 pio_launch_detached(void * (*ThreadEntry)(void * Arg), void * Arg)
@@ -95,30 +152,47 @@ pio_launch_attached(void *   (* ThreadEntry)(void * Arg),
 void *
 pio_coordinator_thread(void * Arg)
 {
-	int                rc          = 0;
-	int                eot         = 0;
-	pio_t            * pio         = Arg;
-	globus_off_t       length      = pio->InitialLength;
-	globus_off_t       offset      = pio->InitialOffset;
-	uint64_t           bytes_moved = 0;
+	int                rc           = 0;
+	int                eot          = 0;
+	int                retry        = 0;
+	int                retries      = 0;
+	int                delay        = 0;
+	pio_t            * pio          = Arg;
+	globus_off_t       length       = pio->InitialLength;
+	globus_off_t       offset       = pio->InitialOffset;
+	globus_off_t       range_length = 0;
+	uint64_t           bytes_moved  = 0;
 	hpss_pio_gapinfo_t gap_info;
+	struct timespec    backoff;
 
 	GlobusGFSName(pio_coordinator_thread);
 
+	rpcstats_set_op(pio->RpcOp);
+	TRACE_SET_TRANSFER(pio->TraceID);
+
 	do {
-		bytes_moved = 0;
+		bytes_moved  = 0;
+		range_length = length;
 		memset(&gap_info, 0, sizeof(gap_info));
 
 		/* Call pio execute. */
+		TRACE_BEGIN("PIOExecute");
 		rc = hpss_PIOExecute(pio->FD,
 		                     offset,
 		                     length,
 		                     pio->CoordinatorSG,
 		                     &gap_info,
 		                     &bytes_moved);
+		TRACE_END("PIOExecute");
 
+		retry = 0;
 		if (rc != 0 && rc != 0xDEADBEEF)
-			pio->CoordinatorResult = GlobusGFSErrorSystemError("hpss_PIOExecute", -rc);
+		{
+			if (!pio->DataEnded && pio_error_is_transient(rc) && retries < pio_retries)
+				retry = 1;
+			else
+				pio->CoordinatorResult = GlobusGFSErrorSystemError("hpss_PIOExecute", -rc);
+		}
 
 		/*
 		 * It appears that gap_info.offset is relative to offset. So you
@@ -129,15 +203,49 @@ pio_coordinator_thread(void * Arg)
 
 		/* Add in any hole we may have found. */
 		length = bytes_moved;
-		if (neqz64m(gap_info.Length))
+		if (!retry && neqz64m(gap_info.Length))
 			length = add64m(gap_info.Offset, gap_info.Length);
 
-		do {
-			pio->RngCmpltCB(&offset, &length, &eot, pio->UserArg);
-		} while (length == 0 && !eot && !rc);
+		if (retry && length == 0)
+		{
+			/* Nothing was moved; the whole range goes again. */
+			length = range_length;
+		} else
+		{
+			/*
+			 * On a retry, this commits what the mover did move so that
+			 * we pick up from offset + bytes_moved.
+			 */
+			TRACE_BEGIN("range_complete");
+			do {
+				pio->RngCmpltCB(&offset, &length, &eot, pio->UserArg);
+			} while (length == 0 && !eot && (!rc || retry));
+			TRACE_END("range_complete");
+		}
+
+		if (retry && !eot)
+		{
+			delay = pio_retry_backoff(++retries);
+			globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+			                       "HPSS PIO transfer error: %s. Resuming at offset %"GLOBUS_OFF_T_FORMAT
+			                       " in %d ms (retry %d of %d)\n",
+			                       strerror(-rc),
+			                       offset,
+			                       delay,
+			                       retries,
+			                       pio_retries);
+			TRACE_BEGIN("retry_backoff");
+			backoff.tv_sec  = delay / 1000;
+			backoff.tv_nsec = (delay % 1000) * 1000000L;
+			nanosleep(&backoff, NULL);
+			TRACE_END("retry_backoff");
+			rc = 0;
+		}
 	} while (!rc && !eot);
 
+	TRACE_BEGIN("PIOEnd");
 	rc = hpss_PIOEnd(pio->CoordinatorSG);
+	TRACE_END("PIOEnd");
 	if (rc != 0 && rc != PIO_END_TRANSFER && pio->CoordinatorResult == GLOBUS_SUCCESS)
 		pio->CoordinatorResult = GlobusGFSErrorSystemError("hpss_PIOEnd", -rc);
 
@@ -150,13 +258,21 @@ pio_register_callback(void     *  UserArg,
                       uint32_t *  Length,
                       void     ** Buffer)
 {
+	int     rc  = 0;
 	pio_t * pio = UserArg;
 	/*
 	 * On STOR, this buffer comes up NULL the first time. On RETR,
 	 * it is not NULL but it isn't safe to exchange either.
 	 */
 	if (!*Buffer) *Buffer = pio->Buffer;
-	return pio->DataCO(*Buffer, Length, Offset, pio->UserArg);
+
+	/* Time between callouts is time spent in the mover. */
+	TRACE_BEGIN("callout");
+	rc = pio->DataCO(*Buffer, Length, Offset, pio->UserArg);
+	TRACE_END("callout");
+	if (rc)
+		pio->DataEnded = 1;
+	return rc;
 }
 
 void *
@@ -172,7 +288,15 @@ pio_thread(void * Arg)
 
 	GlobusGFSName(pio_thread);
 
-	buffer = malloc(pio->BlockSize);
+	rpcstats_set_op(pio->RpcOp);
+	TRACE_SET_TRANSFER(pio->TraceID);
+
+	/* The coordinator and HPSS's own threads inherit this. */
+	placement_pin_thread();
+
+	/* Without this buffer the transfer can not run at all. */
+	budget_reserve(&pio->Budget, pio->BlockSize, 1);
+	buffer = bufpool_get(pio->BlockSize);
 	if (!buffer)
 	{
 		result = GlobusGFSErrorMemory("pio buffer");
@@ -190,6 +314,7 @@ pio_thread(void * Arg)
 		goto cleanup;
 	coord_launched = 1;
 
+	TRACE_BEGIN("PIORegister");
 	rc = hpss_PIORegister(0,
 	                      NULL, /* DataNetSockAddr */
 	                      buffer,
@@ -197,6 +322,7 @@ pio_thread(void * Arg)
 	                      pio->ParticipantSG,
 	                      pio_register_callback,
 	                      pio);
+	TRACE_END("PIORegister");
 	if (rc != 0 && rc != PIO_END_TRANSFER)
 		result = GlobusGFSErrorSystemError("hpss_PIORegister", -rc);
 	safe_to_end_pio = 1;
@@ -210,7 +336,8 @@ cleanup:
 	}
 
 	if (coord_launched) pthread_join(thread_id, NULL);
-	if (buffer) free(buffer);
+	budget_leave(&pio->Budget);
+	bufpool_put(buffer, pio->BlockSize);
 
 	if (!result) result = pio->CoordinatorResult;
 
@@ -266,6 +393,8 @@ pio_start(hpss_pio_operation_t           PioOpType,
 	pio->BlockSize     = BlockSize;
 	pio->InitialOffset = Offset;
 	pio->InitialLength = Length;
+	pio->RpcOp         = rpcstats_get_op();
+	pio->TraceID       = TRACE_GET_TRANSFER();
 	pio->DataCO        = DataCO;
 	pio->RngCmpltCB    = RngCmpltCB;
 	pio->XferCmpltCB   = XferCmpltCB;
@@ -282,7 +411,9 @@ pio_start(hpss_pio_operation_t           PioOpType,
 	pio_params.Transport       = HPSS_PIO_MVR_SELECT;
 	pio_params.Options         = 0;
 
+	TRACE_BEGIN("PIOStart");
 	int retval = hpss_PIOStart(&pio_params, &pio->CoordinatorSG);
+	TRACE_END("PIOStart");
 	if (retval != 0)
 	{
 		result = GlobusGFSErrorSystemError("hpss_PIOStart", -retval);
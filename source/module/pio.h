@@ -56,8 +56,22 @@
  */
 #include <hpss_api.h>
 
+/*
+ * Local includes
+ */
+#include "budget.h"
+#include "config.h"
+
 #define PIO_END_TRANSFER 0xDEADBEEF
 
+/* Upper bound on the backoff between hpss_PIOExecute() retries. */
+#define PIO_RETRY_MAX_DELAY 30000 /* ms */
+
+/*
+ * After a transient error, the coordinator resumes the range from the last
+ * offset the mover confirmed. Callouts may therefore be handed an Offset
+ * below one they have already seen and must handle it.
+ */
 typedef int
 (*pio_data_callout)(char     * Buffer,
                     uint32_t * Length, /* IN / OUT */
@@ -89,6 +103,7 @@ typedef struct {
 	int           FD;
 	char        * Buffer;
 	uint32_t      BlockSize;
+	budget_t      Budget; // Accounts for Buffer
 	uint64_t      InitialOffset;
 	uint64_t      InitialLength;
 
@@ -98,10 +113,20 @@ typedef struct {
 	void                         * UserArg;
 
 	globus_result_t CoordinatorResult;
+	int             DataEnded; // DataCO asked to end the transfer; don't retry
 	hpss_pio_grp_t  CoordinatorSG;
 	hpss_pio_grp_t  ParticipantSG;
+
+	int             RpcOp;   // rpcstats_op_t of the thread that started us
+	uint32_t        TraceID; // TRACE_GET_TRANSFER() of the thread that started us
 } pio_t;
     
+/*
+ * Sets the retry policy for hpss_PIOExecute() failures in this session.
+ */
+void
+pio_init(config_t * Config);
+
 /* Don't call for zero-length transfers. */
 globus_result_t
 pio_start(hpss_pio_operation_t           PioOpType,
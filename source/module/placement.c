@@ -0,0 +1,244 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/* For CPU_SET() and pthread_setaffinity_np(). */
+#define _GNU_SOURCE
+
+/*
+ * System includes
+ */
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "placement.h"
+
+static pthread_once_t placement_once       = PTHREAD_ONCE_INIT;
+static config_t     * placement_config     = NULL;
+static int            placement_huge_pages = 0;
+static int            placement_node       = -1;
+static int            placement_pin        = 0;
+static cpu_set_t      placement_cpus;
+
+/* Parses a sysfs cpulist such as "0-7,16-23". Returns 0 on success. */
+static int
+placement_parse_cpulist(char * List, cpu_set_t * Cpus)
+{
+	char * range   = NULL;
+	char * saveptr = NULL;
+	int    first   = 0;
+	int    last    = 0;
+
+	CPU_ZERO(Cpus);
+
+	for (range = strtok_r(List, ",\n", &saveptr); range; range = strtok_r(NULL, ",\n", &saveptr))
+	{
+		switch (sscanf(range, "%d-%d", &first, &last))
+		{
+		case 1:
+			last = first;
+		case 2:
+			break;
+		default:
+			return 1;
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+		{
+			CPU_SET(first, Cpus);
+		}
+	}
+
+	return CPU_COUNT(Cpus) == 0;
+}
+
+static int
+placement_read_cpus(int Node, cpu_set_t * Cpus)
+{
+	FILE * file = NULL;
+	char   path[128];
+	char   list[4096];
+	int    retval = 1;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", Node);
+
+	file = fopen(path, "r");
+	if (!file)
+		return 1;
+
+	if (fgets(list, sizeof(list), file))
+		retval = placement_parse_cpulist(list, Cpus);
+	fclose(file);
+
+	return retval;
+}
+
+static void
+placement_setup()
+{
+	config_t * config = placement_config;
+
+	placement_huge_pages = config->BufferHugePages;
+	placement_node       = config->BufferNUMANode;
+
+	if (placement_node >= PLACEMENT_MAX_NODES)
+	{
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "BufferNUMANode %d is out of range, ignoring it\n",
+		                       placement_node);
+		placement_node = -1;
+	}
+
+	if (config->PinPIOThreads)
+	{
+		if (placement_node < 0)
+			globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+			                       "PinPIOThreads needs BufferNUMANode, not pinning\n");
+		else if (placement_read_cpus(placement_node, &placement_cpus))
+			globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+			                       "Unable to find the CPUs of NUMA node %d, not pinning\n",
+			                       placement_node);
+		else
+			placement_pin = 1;
+	}
+}
+
+void
+placement_init(config_t * Config)
+{
+	placement_config = Config;
+	pthread_once(&placement_once, placement_setup);
+}
+
+/* Smaller buffers would waste most of a huge page. */
+static int
+placement_huge(globus_size_t Size)
+{
+	return (placement_huge_pages && Size >= PLACEMENT_HUGE_PAGE_SIZE);
+}
+
+static size_t
+placement_length(globus_size_t Size)
+{
+	size_t align = placement_huge(Size) ? PLACEMENT_HUGE_PAGE_SIZE : getpagesize();
+
+	return (Size + align - 1) / align * align;
+}
+
+/*
+ * Prefers the node rather than binding to it so that a full node costs
+ * locality instead of failing the transfer.
+ */
+static void
+placement_bind(void * Buffer, size_t Length)
+{
+	unsigned long mask[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long))];
+
+	memset(mask, 0, sizeof(mask));
+	mask[placement_node / (8 * sizeof(unsigned long))] |= 1UL << (placement_node % (8 * sizeof(unsigned long)));
+
+	syscall(SYS_mbind, Buffer, Length, MPOL_PREFERRED, mask, PLACEMENT_MAX_NODES + 1, 0);
+}
+
+char *
+placement_alloc(globus_size_t Size)
+{
+	void * buffer = MAP_FAILED;
+	size_t length = 0;
+
+	if (!placement_huge_pages && placement_node < 0)
+		return malloc(Size);
+
+	length = placement_length(Size);
+
+	if (placement_huge(Size))
+		buffer = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+
+	if (buffer == MAP_FAILED)
+	{
+		buffer = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (buffer == MAP_FAILED)
+			return NULL;
+
+		/* No reserved huge pages; transparent ones will do. */
+		if (placement_huge(Size))
+			madvise(buffer, length, MADV_HUGEPAGE);
+	}
+
+	/* Before first touch, so the pages land on the node. */
+	if (placement_node >= 0)
+		placement_bind(buffer, length);
+
+	return buffer;
+}
+
+void
+placement_free(char * Buffer, globus_size_t Size)
+{
+	if (!Buffer)
+		return;
+
+	if (!placement_huge_pages && placement_node < 0)
+		free(Buffer);
+	else
+		munmap(Buffer, placement_length(Size));
+}
+
+void
+placement_pin_thread()
+{
+	if (placement_pin)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &placement_cpus);
+}
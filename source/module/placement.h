@@ -0,0 +1,87 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_PLACEMENT_H
+#define HPSS_DSI_PLACEMENT_H
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "config.h"
+
+/*
+ * With BufferHugePages, buffers at least this big are rounded up to a
+ * multiple of it and backed by huge pages.
+ */
+#define PLACEMENT_HUGE_PAGE_SIZE (2*1024*1024)
+
+/* Highest NUMA node we can bind to, plus one. */
+#define PLACEMENT_MAX_NODES 1024
+
+/*
+ * Sets up where transfer buffers and PIO threads live:
+ *  Config->BufferHugePages backs buffers with 2MB huge pages, falling back
+ *    to transparent huge pages if none are reserved.
+ *  Config->BufferNUMANode (-1 for none) puts buffers on that node.
+ *  Config->PinPIOThreads runs PIO threads, and so checksums, on the CPUs
+ *    of that node.
+ * Only the first call in a process takes effect; buffers must be freed the
+ * way they were allocated.
+ */
+void
+placement_init(config_t * Config);
+
+/* Returns a transfer buffer of Size bytes, NULL if out of memory. */
+char *
+placement_alloc(globus_size_t Size);
+
+void
+placement_free(char * Buffer, globus_size_t Size);
+
+/* Pins the calling thread if PinPIOThreads is on. */
+void
+placement_pin_thread();
+
+#endif /* HPSS_DSI_PLACEMENT_H */
@@ -0,0 +1,233 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "pool.h"
+
+typedef struct pool_job {
+	struct pool_job * Next;
+	pool_func_t       Func;
+	void            * Arg;
+	uint64_t          QueuedAt;
+} pool_job_t;
+
+struct pool {
+	pthread_mutex_t   Lock;
+	pthread_cond_t    Cond;
+	pool_job_t      * Head;
+	pool_job_t      * Tail;
+	int               Shutdown;
+	int               ThreadCount;
+	pthread_t       * Threads;
+	pool_stats_t      Stats;
+};
+
+static void *
+pool_thread(void * Arg)
+{
+	pool_t     * pool = Arg;
+	pool_job_t * job  = NULL;
+
+	pthread_mutex_lock(&pool->Lock);
+	while (1)
+	{
+		while (!pool->Head && !pool->Shutdown)
+			pthread_cond_wait(&pool->Cond, &pool->Lock);
+
+		if (!pool->Head)
+			break;
+
+		job = pool->Head;
+		pool->Head = job->Next;
+		if (!pool->Head)
+			pool->Tail = NULL;
+		pool->Stats.QueueDepth--;
+		pool->Stats.Busy++;
+		pthread_mutex_unlock(&pool->Lock);
+
+		histogram_record(&pool->Stats.QueueWait, histogram_now() - job->QueuedAt);
+		job->Func(job->Arg);
+		free(job);
+
+		pthread_mutex_lock(&pool->Lock);
+		pool->Stats.Busy--;
+	}
+	pthread_mutex_unlock(&pool->Lock);
+
+	return NULL;
+}
+
+globus_result_t
+pool_init(pool_t ** Pool, int ThreadCount, int MaxQueueDepth)
+{
+	pool_t * pool = NULL;
+	int      i    = 0;
+
+	GlobusGFSName(pool_init);
+
+	*Pool = NULL;
+
+	pool = malloc(sizeof(pool_t));
+	if (!pool)
+		return GlobusGFSErrorMemory("pool_t");
+	memset(pool, 0, sizeof(pool_t));
+
+	pool->Threads = malloc(sizeof(pthread_t) * ThreadCount);
+	if (!pool->Threads)
+	{
+		free(pool);
+		return GlobusGFSErrorMemory("pool threads");
+	}
+
+	pthread_mutex_init(&pool->Lock, NULL);
+	pthread_cond_init(&pool->Cond, NULL);
+	pool->Stats.MaxQueueDepth = MaxQueueDepth;
+
+	for (i = 0; i < ThreadCount; i++)
+	{
+		if (pthread_create(&pool->Threads[pool->ThreadCount], NULL, pool_thread, pool))
+			break;
+		pool->ThreadCount++;
+	}
+	pool->Stats.Threads = pool->ThreadCount;
+
+	if (pool->ThreadCount == 0)
+	{
+		pool_destroy(pool);
+		return GlobusGFSErrorGeneric("Unable to start pool threads");
+	}
+
+	*Pool = pool;
+	return GLOBUS_SUCCESS;
+}
+
+globus_result_t
+pool_submit(pool_t * Pool, pool_func_t Func, void * Arg)
+{
+	pool_job_t * job = NULL;
+
+	GlobusGFSName(pool_submit);
+
+	job = malloc(sizeof(pool_job_t));
+	if (!job)
+		return GlobusGFSErrorMemory("pool_job_t");
+
+	job->Next     = NULL;
+	job->Func     = Func;
+	job->Arg      = Arg;
+	job->QueuedAt = histogram_now();
+
+	pthread_mutex_lock(&Pool->Lock);
+	{
+		if (Pool->Shutdown || Pool->Stats.QueueDepth >= Pool->Stats.MaxQueueDepth)
+		{
+			Pool->Stats.Rejected++;
+			pthread_mutex_unlock(&Pool->Lock);
+			free(job);
+			return GlobusGFSErrorGeneric("Pool queue is full");
+		}
+
+		if (Pool->Tail)
+			Pool->Tail->Next = job;
+		else
+			Pool->Head = job;
+		Pool->Tail = job;
+
+		Pool->Stats.Submitted++;
+		if (++Pool->Stats.QueueDepth > Pool->Stats.PeakQueueDepth)
+			Pool->Stats.PeakQueueDepth = Pool->Stats.QueueDepth;
+
+		pthread_cond_signal(&Pool->Cond);
+	}
+	pthread_mutex_unlock(&Pool->Lock);
+
+	return GLOBUS_SUCCESS;
+}
+
+void
+pool_get_stats(pool_t * Pool, pool_stats_t * Stats)
+{
+	pthread_mutex_lock(&Pool->Lock);
+	{
+		*Stats = Pool->Stats;
+	}
+	pthread_mutex_unlock(&Pool->Lock);
+}
+
+void
+pool_destroy(pool_t * Pool)
+{
+	int i;
+
+	if (!Pool)
+		return;
+
+	pthread_mutex_lock(&Pool->Lock);
+	{
+		Pool->Shutdown = 1;
+		pthread_cond_broadcast(&Pool->Cond);
+	}
+	pthread_mutex_unlock(&Pool->Lock);
+
+	for (i = 0; i < Pool->ThreadCount; i++)
+	{
+		pthread_join(Pool->Threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&Pool->Cond);
+	pthread_mutex_destroy(&Pool->Lock);
+	free(Pool->Threads);
+	free(Pool);
+}
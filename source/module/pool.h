@@ -0,0 +1,95 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_POOL_H
+#define HPSS_DSI_POOL_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "histogram.h"
+
+typedef void (*pool_func_t)(void * Arg);
+
+typedef struct pool pool_t;
+
+typedef struct {
+	int         Threads;
+	int         MaxQueueDepth;
+	int         QueueDepth;     // Jobs waiting right now
+	int         PeakQueueDepth;
+	int         Busy;           // Jobs running right now
+	uint64_t    Submitted;
+	uint64_t    Rejected;       // Turned away because the queue was full
+	histogram_t QueueWait;
+} pool_stats_t;
+
+/*
+ * Starts ThreadCount workers which run submitted jobs in FIFO order. At
+ * most MaxQueueDepth jobs wait for a worker.
+ */
+globus_result_t
+pool_init(pool_t ** Pool, int ThreadCount, int MaxQueueDepth);
+
+/*
+ * Queues Func(Arg). Fails, without running Func, if the queue is full; the
+ * caller decides whether to run it inline instead.
+ */
+globus_result_t
+pool_submit(pool_t * Pool, pool_func_t Func, void * Arg);
+
+void
+pool_get_stats(pool_t * Pool, pool_stats_t * Stats);
+
+/* Waits for queued and running jobs, then stops the workers. */
+void
+pool_destroy(pool_t * Pool);
+
+#endif /* HPSS_DSI_POOL_H */
@@ -0,0 +1,473 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+
+/*
+ * Local includes
+ */
+#include "rdel.h"
+#include "stat.h"
+#include "walk.h"
+#include "rpcstats.h"
+
+/*
+ * One chunk of entries handed to the unlink threads by a walk thread, which
+ * waits for the whole chunk before reading on.
+ */
+typedef struct rdel_chunk {
+	struct rdel_chunk * Next;
+	walk_dir_t        * Dir;
+	globus_gfs_stat_t * GFSStatArray;
+	uint32_t            Count;
+	uint32_t            NextIndex;
+	uint32_t            Remaining;
+	pthread_cond_t      Cond;
+} rdel_chunk_t;
+
+typedef struct {
+	pthread_mutex_t            Lock;
+	pthread_cond_t             Cond;
+	rdel_chunk_t             * Head;
+	rdel_chunk_t             * Tail;
+	int                        Shutdown;
+
+	globus_gfs_operation_t     Operation;
+	globus_callback_handle_t   CallbackHandle;
+	int                        MarkersRunning;
+
+	uint64_t                   FilesRemoved;
+	uint64_t                   DirsRemoved;
+	uint64_t                   Failures;
+	char                     * FailedPaths[RDEL_MAX_REPORTED_FAILURES];
+} rdel_t;
+
+static void
+rdel_record_failure(rdel_t * Rdel, char * Pathname, int Error)
+{
+	pthread_mutex_lock(&Rdel->Lock);
+	{
+		if (Rdel->Failures < RDEL_MAX_REPORTED_FAILURES)
+			Rdel->FailedPaths[Rdel->Failures] = globus_common_create_string("%s: %s",
+			                                                                Pathname,
+			                                                                strerror(Error));
+		Rdel->Failures++;
+	}
+	pthread_mutex_unlock(&Rdel->Lock);
+}
+
+static void
+rdel_send_markers(void * UserArg)
+{
+	rdel_t * rdel = UserArg;
+	char     progress[128];
+
+	pthread_mutex_lock(&rdel->Lock);
+	{
+		snprintf(progress,
+		         sizeof(progress),
+		         "Removed %"PRIu64" files, %"PRIu64" directories, %"PRIu64" failures",
+		         rdel->FilesRemoved,
+		         rdel->DirsRemoved,
+		         rdel->Failures);
+
+		globus_gridftp_server_intermediate_command(rdel->Operation,
+		                                           GLOBUS_SUCCESS,
+		                                           progress);
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+}
+
+static void
+rdel_start_markers(rdel_t * Rdel)
+{
+	int              marker_freq = 0;
+	globus_reltime_t delay;
+
+	/* Get the frequency for maker updates. */
+	globus_gridftp_server_get_update_interval(Rdel->Operation, &marker_freq);
+
+	if (marker_freq > 0)
+	{
+		GlobusTimeReltimeSet(delay, marker_freq, 0);
+		if (globus_callback_register_periodic(&Rdel->CallbackHandle,
+		                                      &delay,
+		                                      &delay,
+		                                      rdel_send_markers,
+		                                      Rdel) == GLOBUS_SUCCESS)
+		{
+			Rdel->MarkersRunning = 1;
+		}
+	}
+}
+
+static void
+rdel_markers_stopped(void * UserArg)
+{
+	rdel_t * rdel = UserArg;
+
+	pthread_mutex_lock(&rdel->Lock);
+	{
+		rdel->MarkersRunning = 0;
+		pthread_cond_broadcast(&rdel->Cond);
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+}
+
+/*
+ * Waits out any marker already in flight so that nothing is sent after the
+ * final reply and rdel outlives its last use.
+ */
+static void
+rdel_stop_markers(rdel_t * Rdel)
+{
+	if (!Rdel->MarkersRunning)
+		return;
+
+	globus_callback_unregister(Rdel->CallbackHandle, rdel_markers_stopped, Rdel, NULL);
+
+	pthread_mutex_lock(&Rdel->Lock);
+	{
+		while (Rdel->MarkersRunning)
+			pthread_cond_wait(&Rdel->Cond, &Rdel->Lock);
+	}
+	pthread_mutex_unlock(&Rdel->Lock);
+}
+
+static void
+rdel_destroy(rdel_t * Rdel)
+{
+	int i;
+
+	for (i = 0; i < RDEL_MAX_REPORTED_FAILURES; i++)
+	{
+		if (Rdel->FailedPaths[i])
+			globus_free(Rdel->FailedPaths[i]);
+	}
+
+	pthread_cond_destroy(&Rdel->Cond);
+	pthread_mutex_destroy(&Rdel->Lock);
+	free(Rdel);
+}
+
+static void *
+rdel_unlink_thread(void * Arg)
+{
+	rdel_t       * rdel     = Arg;
+	rdel_chunk_t * chunk    = NULL;
+	uint32_t       index    = 0;
+	char         * pathname = NULL;
+	int            retval   = 0;
+	int            removed  = 0;
+
+	rpcstats_set_op(RPCSTATS_OP_COMMAND);
+
+	pthread_mutex_lock(&rdel->Lock);
+	while (1)
+	{
+		while (!rdel->Head && !rdel->Shutdown)
+			pthread_cond_wait(&rdel->Cond, &rdel->Lock);
+
+		if (!rdel->Head)
+			break;
+
+		chunk = rdel->Head;
+		index = chunk->NextIndex++;
+		if (chunk->NextIndex == chunk->Count)
+		{
+			rdel->Head = chunk->Next;
+			if (!rdel->Head)
+				rdel->Tail = NULL;
+		}
+		pthread_mutex_unlock(&rdel->Lock);
+
+		removed  = 0;
+		pathname = globus_common_create_string("%s/%s",
+		                                       chunk->Dir->Path,
+		                                       chunk->GFSStatArray[index].name);
+		if (!pathname)
+		{
+			rdel_record_failure(rdel, chunk->GFSStatArray[index].name, ENOMEM);
+		} else
+		{
+			retval = hpss_Unlink(pathname);
+			if (retval)
+				rdel_record_failure(rdel, pathname, -retval);
+			else
+				removed = 1;
+			globus_free(pathname);
+		}
+
+		pthread_mutex_lock(&rdel->Lock);
+		rdel->FilesRemoved += removed;
+		if (--chunk->Remaining == 0)
+			pthread_cond_signal(&chunk->Cond);
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+
+	return NULL;
+}
+
+static globus_result_t
+rdel_entries(walk_dir_t        * Dir,
+             globus_gfs_stat_t * GFSStatArray,
+             uint32_t            Count,
+             void              * UserArg)
+{
+	rdel_t            * rdel    = UserArg;
+	uint32_t            i       = 0;
+	uint32_t            nondirs = 0;
+	globus_gfs_stat_t   tmp;
+	rdel_chunk_t        chunk;
+
+	/* Subdirectories are removed by rdel_dir_complete(); gather the rest up front. */
+	for (i = 0; i < Count; i++)
+	{
+		if (S_ISDIR(GFSStatArray[i].mode))
+			continue;
+
+		if (i != nondirs)
+		{
+			tmp                   = GFSStatArray[nondirs];
+			GFSStatArray[nondirs] = GFSStatArray[i];
+			GFSStatArray[i]       = tmp;
+		}
+		nondirs++;
+	}
+
+	if (nondirs == 0)
+		return GLOBUS_SUCCESS;
+
+	memset(&chunk, 0, sizeof(chunk));
+	pthread_cond_init(&chunk.Cond, NULL);
+	chunk.Dir          = Dir;
+	chunk.GFSStatArray = GFSStatArray;
+	chunk.Count        = nondirs;
+	chunk.Remaining    = nondirs;
+
+	pthread_mutex_lock(&rdel->Lock);
+	{
+		if (rdel->Tail)
+			rdel->Tail->Next = &chunk;
+		else
+			rdel->Head = &chunk;
+		rdel->Tail = &chunk;
+		pthread_cond_broadcast(&rdel->Cond);
+
+		while (chunk.Remaining > 0)
+			pthread_cond_wait(&chunk.Cond, &rdel->Lock);
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+
+	pthread_cond_destroy(&chunk.Cond);
+	return GLOBUS_SUCCESS;
+}
+
+static void
+rdel_dir_complete(walk_dir_t * Dir, void * UserArg)
+{
+	rdel_t * rdel   = UserArg;
+	int      retval = 0;
+
+	retval = hpss_Rmdir(Dir->Path);
+	if (retval == 0)
+	{
+		pthread_mutex_lock(&rdel->Lock);
+		{
+			rdel->DirsRemoved++;
+		}
+		pthread_mutex_unlock(&rdel->Lock);
+		return;
+	}
+
+	/* A failure further down leaves every ancestor non-empty; that is not news. */
+	pthread_mutex_lock(&rdel->Lock);
+	if (retval == -ENOTEMPTY && rdel->Failures > 0)
+	{
+		pthread_mutex_unlock(&rdel->Lock);
+		return;
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+
+	rdel_record_failure(rdel, Dir->Path, -retval);
+}
+
+void
+rdel(globus_gfs_operation_t      Operation,
+     globus_gfs_command_info_t * CommandInfo,
+     config_t                  * Config,
+     commands_callback           Callback)
+{
+	int               i              = 0;
+	int               retval         = 0;
+	int               thread_count   = 0;
+	char            * command_output = NULL;
+	rdel_t          * rdel           = NULL;
+	pthread_t       * threads        = NULL;
+	globus_result_t   result         = GLOBUS_SUCCESS;
+	globus_gfs_stat_t gfs_stat;
+
+	GlobusGFSName(rdel);
+
+	/* A link to a directory is removed itself, never its target's tree. */
+	result = stat_link(CommandInfo->pathname, &gfs_stat);
+	if (result)
+	{
+		Callback(Operation, result, NULL);
+		return;
+	}
+
+	if (!S_ISDIR(gfs_stat.mode))
+	{
+		stat_destroy(&gfs_stat);
+
+		retval = hpss_Unlink(CommandInfo->pathname);
+		if (retval)
+			result = GlobusGFSErrorSystemError("hpss_Unlink", -retval);
+		Callback(Operation, result, NULL);
+		return;
+	}
+	stat_destroy(&gfs_stat);
+
+	rdel = malloc(sizeof(rdel_t));
+	threads = malloc(sizeof(pthread_t) * Config->DeleteThreads);
+	if (!rdel || !threads)
+	{
+		if (rdel)
+			free(rdel);
+		if (threads)
+			free(threads);
+		Callback(Operation, GlobusGFSErrorMemory("rdel_t"), NULL);
+		return;
+	}
+
+	memset(rdel, 0, sizeof(rdel_t));
+	pthread_mutex_init(&rdel->Lock, NULL);
+	pthread_cond_init(&rdel->Cond, NULL);
+	rdel->Operation = Operation;
+
+	for (i = 0; i < Config->DeleteThreads; i++)
+	{
+		if (pthread_create(&threads[thread_count], NULL, rdel_unlink_thread, rdel))
+			break;
+		thread_count++;
+	}
+
+	if (thread_count == 0)
+	{
+		result = GlobusGFSErrorGeneric("Unable to start unlink threads");
+		goto cleanup;
+	}
+
+	rdel_start_markers(rdel);
+
+	result = walk(CommandInfo->pathname,
+	              -1,
+	              Config->WalkThreads,
+	              WALK_WHOLE_DIRS,
+	              rdel_entries,
+	              rdel_dir_complete,
+	              rdel);
+
+	pthread_mutex_lock(&rdel->Lock);
+	{
+		rdel->Shutdown = 1;
+		pthread_cond_broadcast(&rdel->Cond);
+	}
+	pthread_mutex_unlock(&rdel->Lock);
+
+	for (i = 0; i < thread_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	/* Stop progress before the summary so it is the last thing sent. */
+	rdel_stop_markers(rdel);
+
+	for (i = 0; i < RDEL_MAX_REPORTED_FAILURES && rdel->FailedPaths[i]; i++)
+	{
+		globus_gridftp_server_intermediate_command(Operation, GLOBUS_SUCCESS, rdel->FailedPaths[i]);
+	}
+
+	if (result)
+	{
+		result = GlobusGFSErrorWrapFailed("Recursive delete stopped early", result);
+	} else if (rdel->Failures)
+	{
+		command_output = globus_common_create_string("Removed %"PRIu64" files and %"PRIu64" directories; "
+		                                             "failed to remove %"PRIu64" objects",
+		                                             rdel->FilesRemoved,
+		                                             rdel->DirsRemoved,
+		                                             rdel->Failures);
+		result = GlobusGFSErrorGeneric(command_output);
+		globus_free(command_output);
+		command_output = NULL;
+	} else
+	{
+		command_output = globus_common_create_string("250 Removed %"PRIu64" files and %"PRIu64" directories.\r\n",
+		                                             rdel->FilesRemoved,
+		                                             rdel->DirsRemoved);
+	}
+
+cleanup:
+	Callback(Operation, result, command_output);
+	if (command_output)
+		globus_free(command_output);
+
+	free(threads);
+	rdel_destroy(rdel);
+}
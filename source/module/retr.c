@@ -48,8 +48,11 @@
  * Local includes
  */
 #include "markers.h"
+#include "bufpool.h"
 #include "retr.h"
 #include "pio.h"
+#include "rpcstats.h"
+#include "trace.h"
 
 globus_result_t
 retr_open_for_reading(char * Pathname,
@@ -89,6 +92,13 @@ retr_open_for_reading(char * Pathname,
     return GLOBUS_SUCCESS;
 }
 
+static void
+retr_set_result(retr_info_t * RetrInfo, globus_result_t Result)
+{
+	if (Result)
+		__sync_bool_compare_and_swap(&RetrInfo->Result, GLOBUS_SUCCESS, Result);
+}
+
 void
 retr_gridftp_callout(globus_gfs_operation_t Operation,
                      globus_result_t        Result,
@@ -101,19 +111,42 @@ retr_gridftp_callout(globus_gfs_operation_t Operation,
 
 	if (retr_buffer->Valid != VALID_TAG) return;
 
-	pthread_mutex_lock(&retr_info->Mutex);
-	{
-		if (Result && !retr_info->Result) retr_info->Result = Result;
-
-		globus_list_insert(&retr_info->FreeBufferList, retr_buffer);
 assert(Length  <= retr_info->BlockSize);
-		pthread_cond_signal(&retr_info->Cond);
+
+	/* The push publishes the result along with the buffer. */
+	retr_set_result(retr_info, Result);
+	handoff_push(&retr_info->Returned, &retr_buffer->Node);
+}
+
+/* PIO thread only. Moves buffers GridFTP is done with to the free list. */
+static void
+retr_collect_buffers(retr_info_t * RetrInfo)
+{
+	handoff_node_t * node = handoff_take_all(&RetrInfo->Returned);
+
+	for (; node; node = node->Next)
+	{
+		globus_list_insert(&RetrInfo->FreeBufferList, node);
 	}
-	pthread_mutex_unlock(&retr_info->Mutex);
+}
+
+/* PIO thread only. Frees an idle buffer and returns it to the budget. */
+static void
+retr_drop_free_buffer(retr_info_t * RetrInfo)
+{
+	retr_buffer_t * buffer = NULL;
+
+	buffer = globus_list_remove(&RetrInfo->FreeBufferList, RetrInfo->FreeBufferList);
+	globus_list_remove(&RetrInfo->AllBufferList,
+	                   globus_list_search(RetrInfo->AllBufferList, buffer));
+
+	bufpool_free(buffer->Buffer, RetrInfo->BlockSize);
+	free(buffer);
+	budget_release(&RetrInfo->Budget, RetrInfo->BlockSize);
 }
 
 /*
- * Called locked.
+ * PIO thread only.
  */
 globus_result_t
 retr_get_free_buffer(retr_info_t   *  RetrInfo,
@@ -139,6 +172,8 @@ retr_get_free_buffer(retr_info_t   *  RetrInfo,
 		if (RetrInfo->ConnChkCnt >= 100)
 			RetrInfo->ConnChkCnt = 0;
 
+		retr_collect_buffers(RetrInfo);
+
 		/* Check for error first. */
 		if (RetrInfo->Result)
 			return RetrInfo->Result;
@@ -149,9 +184,24 @@ retr_get_free_buffer(retr_info_t   *  RetrInfo,
 
 		cur_conn_cnt = all_buf_cnt - free_buf_cnt;
 		if (cur_conn_cnt < RetrInfo->OptConnCnt)
-			break;
+		{
+			/* Give back idle buffers beyond our share of the budget. */
+			while (free_buf_cnt > 0 && all_buf_cnt > 1 && budget_over_share(&RetrInfo->Budget))
+			{
+				retr_drop_free_buffer(RetrInfo);
+				free_buf_cnt--;
+				all_buf_cnt--;
+			}
+
+			if (free_buf_cnt > 0)
+				break;
 
-		pthread_cond_wait(&RetrInfo->Cond, &RetrInfo->Mutex);
+			/* Under pressure, wait for one in flight rather than allocate. */
+			if (budget_reserve(&RetrInfo->Budget, RetrInfo->BlockSize, cur_conn_cnt == 0))
+				break;
+		}
+
+		handoff_wait(&RetrInfo->Returned, &RetrInfo->Stats.WaitGridFTP);
 	}
 
 	if (!globus_list_empty(RetrInfo->FreeBufferList))
@@ -162,13 +212,21 @@ retr_get_free_buffer(retr_info_t   *  RetrInfo,
 
 	*FreeBuffer = malloc(sizeof(retr_buffer_t));
 	if (!*FreeBuffer)
+	{
+		budget_release(&RetrInfo->Budget, RetrInfo->BlockSize);
 		return GlobusGFSErrorMemory("free_buffer");
-	(*FreeBuffer)->Buffer = malloc(RetrInfo->BlockSize);
+	}
+	(*FreeBuffer)->Buffer = bufpool_get(RetrInfo->BlockSize);
 	if (!(*FreeBuffer)->Buffer)
+	{
+		free(*FreeBuffer);
+		budget_release(&RetrInfo->Budget, RetrInfo->BlockSize);
 		return GlobusGFSErrorMemory("free_buffer");
+	}
 	(*FreeBuffer)->RetrInfo = RetrInfo;
 	(*FreeBuffer)->Valid    = VALID_TAG;
 	globus_list_insert(&RetrInfo->AllBufferList, *FreeBuffer);
+	xferstats_buffers(&RetrInfo->Stats, globus_list_size(RetrInfo->AllBufferList));
 	return GLOBUS_SUCCESS;
 }
 
@@ -179,69 +237,84 @@ retr_pio_callout(char     * ReadyBuffer,
                  void     * CallbackArg)
 {
 	int             rc           = 0;
+	uint32_t        length       = *Length;
 	retr_buffer_t * free_buffer  = NULL;
 	retr_info_t   * retr_info    = CallbackArg;
 	globus_result_t result       = GLOBUS_SUCCESS;
 
 	GlobusGFSName(retr_pio_callout);
 
+	/* After a PIO retry, drop what we have already sent. */
+	if (Offset < retr_info->CurrentOffset)
+	{
+		if (Offset + length <= retr_info->CurrentOffset)
+			return 0;
+
+		length      -= retr_info->CurrentOffset - Offset;
+		ReadyBuffer += retr_info->CurrentOffset - Offset;
+		Offset       = retr_info->CurrentOffset;
+	}
+
 	assert (Offset == retr_info->CurrentOffset);
 
-	pthread_mutex_lock(&retr_info->Mutex);
-	{
-assert(*Length <= retr_info->BlockSize);
+	xferstats_callout_begin(&retr_info->Stats);
 
-		result = retr_get_free_buffer(retr_info, &free_buffer);
-		if (result)
-		{
-			if (!retr_info->Result) retr_info->Result = result;
-			rc = PIO_END_TRANSFER; /* Signal to shutdown. */
-			goto cleanup;
-		}
+assert(*Length <= retr_info->BlockSize);
 
-		memcpy(free_buffer->Buffer, ReadyBuffer, *Length);
+	TRACE_BEGIN("wait_buffer");
+	result = retr_get_free_buffer(retr_info, &free_buffer);
+	TRACE_END("wait_buffer");
+	if (result)
+	{
+		retr_set_result(retr_info, result);
+		rc = PIO_END_TRANSFER; /* Signal to shutdown. */
+		goto cleanup;
+	}
 
-		result = globus_gridftp_server_register_write(retr_info->Operation,
-		                                              (globus_byte_t *)free_buffer->Buffer,
-		                                              *Length,
-		                                              Offset,
-		                                              -1,
-		                                              retr_gridftp_callout,
-		                                              free_buffer);
+	memcpy(free_buffer->Buffer, ReadyBuffer, length);
 
-		if (result)
-		{
-			if (!retr_info->Result) retr_info->Result = result;
-			rc = PIO_END_TRANSFER; /* Signal to shutdown. */
-			goto cleanup;
-		}
+	result = globus_gridftp_server_register_write(retr_info->Operation,
+	                                              (globus_byte_t *)free_buffer->Buffer,
+	                                              length,
+	                                              Offset,
+	                                              -1,
+	                                              retr_gridftp_callout,
+	                                              free_buffer);
 
-		/* Update perf markers */
-		markers_update_perf_markers(retr_info->Operation, Offset, *Length);
+	if (result)
+	{
+		/* GridFTP will never hand this one back. */
+		globus_list_insert(&retr_info->FreeBufferList, free_buffer);
+		retr_set_result(retr_info, result);
+		rc = PIO_END_TRANSFER; /* Signal to shutdown. */
+		goto cleanup;
 	}
-cleanup:
-	pthread_mutex_unlock(&retr_info->Mutex);
 
-	retr_info->CurrentOffset += *Length;
+	/* Update perf markers */
+	markers_add_perf(&retr_info->Markers, Offset, length);
+
+cleanup:
+	retr_info->CurrentOffset += length;
+	xferstats_callout_end(&retr_info->Stats, length);
 	return rc;
 }
 
+/*
+ * Waits for every register_write() to call back, even after an error; the
+ * buffers go back to the pool once we return.
+ */
 void
 retr_wait_for_gridftp(retr_info_t * RetrInfo)
 {
-	pthread_mutex_lock(&RetrInfo->Mutex);
+	while (1)
 	{
-		while (1)
-		{
-			if (RetrInfo->Result) break;
+		retr_collect_buffers(RetrInfo);
 
-			if (globus_list_size(RetrInfo->AllBufferList) == globus_list_size(RetrInfo->FreeBufferList))
-				break;
+		if (globus_list_size(RetrInfo->AllBufferList) == globus_list_size(RetrInfo->FreeBufferList))
+			break;
 
-			pthread_cond_wait(&RetrInfo->Cond, &RetrInfo->Mutex);
-		}
+		handoff_wait(&RetrInfo->Returned, &RetrInfo->Stats.WaitGridFTP);
 	}
-	pthread_mutex_unlock(&RetrInfo->Mutex);
 }
 
 void
@@ -286,11 +359,12 @@ retr_range_complete_callback(globus_off_t * Offset,
 	}
 }
 
+/* Arg is the block size. */
 static int
 release_buffer(void * Datum, void * Arg)
 {
 	((retr_buffer_t *)Datum)->Valid = INVALID_TAG;
-	free(((retr_buffer_t *)Datum)->Buffer);
+	bufpool_put(((retr_buffer_t *)Datum)->Buffer, *(globus_size_t *)Arg);
 
 	return 0;
 }
@@ -305,8 +379,12 @@ retr_transfer_complete_callback (globus_result_t Result,
 
 	GlobusGFSName(retr_transfer_complete_callback);
 
+	markers_destroy(&retr_info->Markers);
 	globus_gridftp_server_finished_transfer(retr_info->Operation, result);
+
+	TRACE_BEGIN("wait_gridftp");
 	retr_wait_for_gridftp(retr_info);
+	TRACE_END("wait_gridftp");
 
 	/* Prefer our error over PIO's */
 	if (retr_info->Result)
@@ -315,17 +393,23 @@ retr_transfer_complete_callback (globus_result_t Result,
 	if (result)
 		result = retr_info->Result;
 
+	TRACE_BEGIN("close");
 	rc = hpss_Close(retr_info->FileFD);
+	TRACE_END("close");
 	if (rc && !result)
 		result = GlobusGFSErrorSystemError("hpss_Close", -rc);
 
+	xferstats_log(&retr_info->Stats, "RETR", &retr_info->Returned);
 
-	pthread_mutex_destroy(&retr_info->Mutex);
-	pthread_cond_destroy(&retr_info->Cond);
 	globus_list_free(retr_info->FreeBufferList);
-	globus_list_search_pred(retr_info->AllBufferList, release_buffer, NULL);
+	/* Give up our share before the buffers go back to the pool. */
+	budget_leave(&retr_info->Budget);
+	globus_list_search_pred(retr_info->AllBufferList, release_buffer, &retr_info->BlockSize);
 	globus_list_destroy_all(retr_info->AllBufferList, free);
+	handoff_destroy(&retr_info->Returned);
 	free(retr_info);
+
+	TRACE_TRANSFER_END();
 }
 
 void
@@ -340,7 +424,11 @@ retr(globus_gfs_operation_t       Operation,
 
 	GlobusGFSName(retr);
 
+	TRACE_TRANSFER_BEGIN("RETR", TransferInfo->pathname);
+
+	TRACE_BEGIN("stat");
 	rc = hpss_Stat(TransferInfo->pathname, &hpss_stat_buf);
+	TRACE_END("stat");
 	if (rc)
 	{
 		result = GlobusGFSErrorSystemError("hpss_Stat", -rc);
@@ -361,20 +449,24 @@ retr(globus_gfs_operation_t       Operation,
 	retr_info->TransferInfo = TransferInfo;
 	retr_info->FileFD       = -1;
 	retr_info->FileSize     = hpss_stat_buf.st_size;
-	pthread_mutex_init(&retr_info->Mutex, NULL);
-	pthread_cond_init(&retr_info->Cond, NULL);
+	handoff_init(&retr_info->Returned);
+	budget_join(&retr_info->Budget);
+	xferstats_init(&retr_info->Stats, TransferInfo->pathname);
 
 	globus_gridftp_server_get_block_size(Operation, &retr_info->BlockSize);
 
 	/*
 	 * Open the file.
 	 */
+	TRACE_BEGIN("open");
 	result = retr_open_for_reading(TransferInfo->pathname,
 	                               &retr_info->FileFD,
 	                               &file_stripe_width);
+	TRACE_END("open");
 	if (result) goto cleanup;
 
 	globus_gridftp_server_begin_transfer(Operation, 0, NULL);
+	markers_init(&retr_info->Markers, Operation);
 
 	globus_gridftp_server_get_read_range(Operation,
 	                                     &retr_info->CurrentOffset, 
@@ -385,6 +477,7 @@ retr(globus_gfs_operation_t       Operation,
 	/*
 	 * Setup PIO
 	 */
+	TRACE_BEGIN("pio_start");
 	result = pio_start(HPSS_PIO_READ,
 	                   retr_info->FileFD,
 	                   file_stripe_width,
@@ -395,17 +488,21 @@ retr(globus_gfs_operation_t       Operation,
 	                   retr_range_complete_callback,
 	                   retr_transfer_complete_callback,
 	                   retr_info);
+	TRACE_END("pio_start");
 
 cleanup:
 	if (result)
 	{
+		TRACE_TRANSFER_END();
+		if (retr_info)
+			markers_destroy(&retr_info->Markers);
 		globus_gridftp_server_finished_transfer(Operation, result);
 		if (retr_info)
 		{
 			if (retr_info->FileFD != -1)
 				hpss_Close(retr_info->FileFD);
-			pthread_mutex_destroy(&retr_info->Mutex);
-			pthread_cond_destroy(&retr_info->Cond);
+			budget_leave(&retr_info->Budget);
+			xferstats_log(&retr_info->Stats, "RETR", NULL);
 			free(retr_info);
 		}
 	}
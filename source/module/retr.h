@@ -55,11 +55,16 @@
 /*
  * Local includes
  */
+#include "budget.h"
+#include "handoff.h"
+#include "markers.h"
 #include "pio.h"
+#include "xferstats.h"
 
 struct retr_info;
 
 typedef struct {
+    handoff_node_t     Node; // Must be first
     char             * Buffer;
     struct retr_info * RetrInfo;
 #define VALID_TAG   0xDEADBEEF
@@ -74,20 +79,25 @@ typedef struct retr_info {
 	int      FileFD;
 	uint64_t FileSize;
 
-	globus_result_t Result;
+	globus_result_t Result; // First error wins; set with retr_set_result()
 	globus_size_t   BlockSize;
 	globus_off_t    RangeLength;
 	globus_off_t    CurrentOffset;
 
-	pthread_mutex_t Mutex;
-	pthread_cond_t  Cond;
-
 	int OptConnCnt;
 	int ConnChkCnt;
 
+	/*
+	 * Only the PIO thread touches the buffer lists. GridFTP hands written
+	 * buffers back through Returned.
+	 */
 	globus_list_t * AllBufferList;
 	globus_list_t * FreeBufferList;
+	handoff_t       Returned;
+	budget_t        Budget;
 
+	markers_t       Markers;
+	xferstats_t     Stats;
 } retr_info_t;
 
 void
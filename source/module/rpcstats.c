@@ -0,0 +1,231 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "rpcstats.h"
+
+/* Distinct error codes remembered per operation/call; the rest are only counted. */
+#define RPCSTATS_ERROR_CODES 4
+
+typedef struct {
+	int      Code;  // errno, 0 if the slot is free
+	uint64_t Count;
+} rpcstats_error_t;
+
+typedef struct {
+	histogram_t      Latency;
+	uint64_t         Errors;
+	rpcstats_error_t ErrorCodes[RPCSTATS_ERROR_CODES];
+} rpcstats_entry_t;
+
+int rpcstats_enabled = 0;
+
+/* [RPCSTATS_OP_COUNT][RPCSTATS_CALL_COUNT], only allocated when enabled. */
+static rpcstats_entry_t * rpcstats_table = NULL;
+
+static __thread rpcstats_op_t rpcstats_current_op = RPCSTATS_OP_SESSION;
+
+static const char * rpcstats_op_names[RPCSTATS_OP_COUNT] = {
+	"SESSION",
+	"RETR",
+	"STOR",
+	"CKSM",
+	"STAT",
+	"COMMAND",
+};
+
+#define RPCSTATS_CALL_NAME(Name) #Name,
+const char * rpcstats_call_names[RPCSTATS_CALL_COUNT] = {
+	RPCSTATS_CALLS(RPCSTATS_CALL_NAME)
+};
+#undef RPCSTATS_CALL_NAME
+
+/*
+ * Once enabled, stats stay on for the life of the process even if a later
+ * config turns them off; the table is shared by every session in it. The
+ * call trace follows the current config.
+ */
+globus_result_t
+rpcstats_init(config_t * Config)
+{
+	int                error = 0;
+	rpcstats_entry_t * table = NULL;
+
+	GlobusGFSName(rpcstats_init);
+
+	error = calltrace_init(Config->CallTraceDir,
+	                       rpcstats_call_names,
+	                       RPCSTATS_CALL_COUNT,
+	                       rpcstats_op_names,
+	                       RPCSTATS_OP_COUNT);
+	if (error)
+		return GlobusGFSErrorSystemError("calltrace_init", error);
+
+	if (!Config->RPCStatsSupport || rpcstats_enabled)
+		return GLOBUS_SUCCESS;
+
+	table = calloc(RPCSTATS_OP_COUNT * RPCSTATS_CALL_COUNT, sizeof(rpcstats_entry_t));
+	if (!table)
+		return GlobusGFSErrorMemory("rpcstats table");
+
+	if (!__sync_bool_compare_and_swap(&rpcstats_table, NULL, table))
+		free(table);
+
+	rpcstats_enabled = 1;
+	return GLOBUS_SUCCESS;
+}
+
+void
+rpcstats_set_op(rpcstats_op_t Op)
+{
+	rpcstats_current_op = Op;
+}
+
+rpcstats_op_t
+rpcstats_get_op()
+{
+	return rpcstats_current_op;
+}
+
+void
+rpcstats_record(rpcstats_call_t Call, uint64_t StartTime, int ReturnValue)
+{
+	int                i     = 0;
+	int                code  = 0;
+	rpcstats_entry_t * entry = &rpcstats_table[rpcstats_current_op * RPCSTATS_CALL_COUNT + Call];
+
+	histogram_record(&entry->Latency, histogram_now() - StartTime);
+
+	if (ReturnValue >= 0)
+		return;
+
+	__sync_fetch_and_add(&entry->Errors, 1);
+
+	code = -ReturnValue;
+	for (i = 0; i < RPCSTATS_ERROR_CODES; i++)
+	{
+		if (entry->ErrorCodes[i].Code == 0)
+			__sync_bool_compare_and_swap(&entry->ErrorCodes[i].Code, 0, code);
+
+		if (entry->ErrorCodes[i].Code == code)
+		{
+			__sync_fetch_and_add(&entry->ErrorCodes[i].Count, 1);
+			break;
+		}
+	}
+}
+
+void
+rpcstats_report(rpcstats_report_callback Callback, void * Arg)
+{
+	int                op     = 0;
+	int                call   = 0;
+	int                i      = 0;
+	int                length = 0;
+	char               name[64];
+	char               errors[256];
+	char             * line   = NULL;
+	rpcstats_entry_t * entry  = NULL;
+
+	if (!rpcstats_enabled)
+		return;
+
+	for (op = 0; op < RPCSTATS_OP_COUNT; op++)
+	{
+		for (call = 0; call < RPCSTATS_CALL_COUNT; call++)
+		{
+			entry = &rpcstats_table[op * RPCSTATS_CALL_COUNT + call];
+			if (entry->Latency.Count == 0)
+				continue;
+
+			snprintf(name, sizeof(name), "%s %s", rpcstats_op_names[op], rpcstats_call_names[call]);
+
+			errors[0] = '\0';
+			if (entry->Errors)
+			{
+				length = snprintf(errors, sizeof(errors), " errors=%"PRIu64" (", entry->Errors);
+				for (i = 0; i < RPCSTATS_ERROR_CODES && entry->ErrorCodes[i].Code; i++)
+				{
+					if (length >= sizeof(errors))
+						break;
+					length += snprintf(errors + length,
+					                   sizeof(errors) - length,
+					                   "%s%d:%"PRIu64,
+					                   i ? "," : "",
+					                   entry->ErrorCodes[i].Code,
+					                   entry->ErrorCodes[i].Count);
+				}
+				if (length < sizeof(errors))
+					snprintf(errors + length, sizeof(errors) - length, ")");
+			}
+
+			line = histogram_format(&entry->Latency, name);
+			if (!line)
+				continue;
+
+			if (errors[0])
+			{
+				char * full = globus_common_create_string("%s%s", line, errors);
+				globus_free(line);
+				line = full;
+				if (!line)
+					continue;
+			}
+
+			Callback(line, Arg);
+			globus_free(line);
+		}
+	}
+}
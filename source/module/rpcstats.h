@@ -0,0 +1,261 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_RPCSTATS_H
+#define HPSS_DSI_RPCSTATS_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+
+/*
+ * Local includes
+ */
+#include "calltrace.h"
+#include "config.h"
+#include "histogram.h"
+
+/*
+ * Per call statistics for the HPSS client API. Including this header (after
+ * the HPSS headers, which it pulls in itself) routes each call listed in
+ * RPCSTATS_CALLS through RPCSTATS_CALL() so that every module file is covered
+ * without touching its call sites. When RPCStatsSupport and CallTraceDir are
+ * off the cost of a call is two loads and a branch.
+ *
+ * Calls are broken down by the operation the calling thread is working for;
+ * see rpcstats_set_op(). Threads we start for an operation must set it.
+ *
+ * The same wrappers feed the call trace (calltrace.h), which keeps the
+ * arguments picked out by each call's RPCSTATS_ARGS_*(): a path, or NULL,
+ * and two integers. They are evaluated after the call returns, so output
+ * arguments may be used.
+ */
+
+typedef enum {
+	RPCSTATS_OP_SESSION, // Session start up
+	RPCSTATS_OP_RETR,
+	RPCSTATS_OP_STOR,
+	RPCSTATS_OP_CKSM,
+	RPCSTATS_OP_STAT,
+	RPCSTATS_OP_COMMAND,
+	RPCSTATS_OP_COUNT,
+} rpcstats_op_t;
+
+/* Only calls returning int, negative errno on failure, belong here. */
+#define RPCSTATS_CALLS(X)             \
+	X(hpss_Chmod)                     \
+	X(hpss_Chown)                     \
+	X(hpss_Close)                     \
+	X(hpss_FileGetAttributes)         \
+	X(hpss_FileGetXAttributes)        \
+	X(hpss_FileGetXAttributesHandle)  \
+	X(hpss_FilesetGetAttributes)      \
+	X(hpss_LoadDefaultThreadState)    \
+	X(hpss_Lstat)                     \
+	X(hpss_Mkdir)                     \
+	X(hpss_Open)                      \
+	X(hpss_PIOEnd)                    \
+	X(hpss_PIOExecute)                \
+	X(hpss_PIOExportGrp)              \
+	X(hpss_PIOImportGrp)              \
+	X(hpss_PIORegister)               \
+	X(hpss_PIOStart)                  \
+	X(hpss_ParseAuthString)           \
+	X(hpss_ReadAttrsHandle)           \
+	X(hpss_Readlink)                  \
+	X(hpss_ReadlinkHandle)            \
+	X(hpss_Rename)                    \
+	X(hpss_Rmdir)                     \
+	X(hpss_SetCOSByHints)             \
+	X(hpss_SetLoginCred)              \
+	X(hpss_Stage)                     \
+	X(hpss_StageCallBack)             \
+	X(hpss_Stat)                      \
+	X(hpss_Symlink)                   \
+	X(hpss_Truncate)                  \
+	X(hpss_Unlink)                    \
+	X(hpss_UserAttrGetAttrs)          \
+	X(hpss_UserAttrSetAttrs)          \
+	X(hpss_Utime)
+
+#define RPCSTATS_CALL_ENUM(Name) RPCSTATS_CALL_##Name,
+typedef enum {
+	RPCSTATS_CALLS(RPCSTATS_CALL_ENUM)
+	RPCSTATS_CALL_COUNT,
+} rpcstats_call_t;
+#undef RPCSTATS_CALL_ENUM
+
+/* Set by rpcstats_init(); read on every call. */
+extern int rpcstats_enabled;
+
+/* Indexed by rpcstats_call_t. */
+extern const char * rpcstats_call_names[RPCSTATS_CALL_COUNT];
+
+globus_result_t
+rpcstats_init(config_t * Config);
+
+void
+rpcstats_set_op(rpcstats_op_t Op);
+
+rpcstats_op_t
+rpcstats_get_op();
+
+void
+rpcstats_record(rpcstats_call_t Call, uint64_t StartTime, int ReturnValue);
+
+/*
+ * Calls Callback once per operation/call pair that has been used, with a one
+ * line summary, ie
+ *   STOR hpss_Open count=2 mean=9000us p50=8192us ... max=12000us errors=1 (EDQUOT:1)
+ * Callback does not own Line. Does nothing when disabled.
+ */
+typedef void
+(*rpcstats_report_callback)(const char * Line, void * Arg);
+
+void
+rpcstats_report(rpcstats_report_callback Callback, void * Arg);
+
+/* Uses a GNU statement expression so the wrapped call keeps its value. */
+#define RPCSTATS_CALL(Call, Expr, ...)                                        \
+	({                                                                        \
+		uint64_t _rpcstats_start = (rpcstats_enabled | calltrace_enabled) ?   \
+		                           histogram_now() : 0;                       \
+		int      _rpcstats_retval = (Expr);                                   \
+		if (_rpcstats_start && rpcstats_enabled)                              \
+			rpcstats_record(Call, _rpcstats_start, _rpcstats_retval);         \
+		if (_rpcstats_start && calltrace_enabled)                             \
+			calltrace_record(Call,                                            \
+			                 rpcstats_get_op(),                               \
+			                 _rpcstats_start,                                 \
+			                 _rpcstats_retval,                                \
+			                 __VA_ARGS__);                                    \
+		_rpcstats_retval;                                                     \
+	})
+
+/*
+ * Trace arguments: Path, Arg0, Arg1. Stat and FileGetAttributes keep the
+ * size and file type so that replay can recreate the namespace.
+ */
+#define RPCSTATS_ARGS_hpss_Chmod(Path, Mode)                              Path, Mode, 0
+#define RPCSTATS_ARGS_hpss_Chown(Path, UID, GID)                          Path, UID, GID
+#define RPCSTATS_ARGS_hpss_Close(FD)                                      NULL, FD, 0
+#define RPCSTATS_ARGS_hpss_FileGetAttributes(Path, Buf)                   \
+	Path, (Buf)->Attrs.DataLength,                                        \
+	(Buf)->Attrs.Type == NS_OBJECT_TYPE_DIRECTORY ? S_IFDIR : S_IFREG
+#define RPCSTATS_ARGS_hpss_FileGetXAttributes(Path, Flags, Level, ...)     Path, Flags, Level
+#define RPCSTATS_ARGS_hpss_FileGetXAttributesHandle(Handle, Path, Cred, Flags, Level, ...) \
+	Path, Flags, Level
+#define RPCSTATS_ARGS_hpss_FilesetGetAttributes(Path, ...)                Path, 0, 0
+#define RPCSTATS_ARGS_hpss_LoadDefaultThreadState(UID, ...)               NULL, UID, 0
+#define RPCSTATS_ARGS_hpss_Lstat(Path, Buf)                               Path, (Buf)->st_size, (Buf)->st_mode
+#define RPCSTATS_ARGS_hpss_Mkdir(Path, Mode)                              Path, Mode, 0
+#define RPCSTATS_ARGS_hpss_Open(Path, Flags, Mode, ...)                   Path, Flags, Mode
+#define RPCSTATS_ARGS_hpss_PIOEnd(Group)                                  NULL, 0, 0
+#define RPCSTATS_ARGS_hpss_PIOExecute(FD, Offset, Size, ...)              NULL, Offset, Size
+#define RPCSTATS_ARGS_hpss_PIOExportGrp(...)                              NULL, 0, 0
+#define RPCSTATS_ARGS_hpss_PIOImportGrp(...)                              NULL, 0, 0
+#define RPCSTATS_ARGS_hpss_PIORegister(Element, Address, Buffer, Length, ...) \
+	NULL, Element, Length
+#define RPCSTATS_ARGS_hpss_PIOStart(Params, Group)                        NULL, (Params)->Operation, (Params)->BlockSize
+#define RPCSTATS_ARGS_hpss_ParseAuthString(...)                           NULL, 0, 0
+#define RPCSTATS_ARGS_hpss_ReadAttrsHandle(Handle, Offset, Cred, Size, ...) NULL, Offset, Size
+#define RPCSTATS_ARGS_hpss_Readlink(Path, Buf, Size)                      Path, Size, 0
+#define RPCSTATS_ARGS_hpss_ReadlinkHandle(Handle, Path, Buf, Size, Cred)  Path, Size, 0
+#define RPCSTATS_ARGS_hpss_Rename(From, To)                               From, 0, 0
+#define RPCSTATS_ARGS_hpss_Rmdir(Path)                                    Path, 0, 0
+#define RPCSTATS_ARGS_hpss_SetCOSByHints(FD, ...)                         NULL, FD, 0
+#define RPCSTATS_ARGS_hpss_SetLoginCred(...)                              NULL, 0, 0
+#define RPCSTATS_ARGS_hpss_Stage(Path, Offset, Length, ...)               Path, Offset, Length
+#define RPCSTATS_ARGS_hpss_StageCallBack(Path, Offset, Length, ...)       Path, Offset, Length
+#define RPCSTATS_ARGS_hpss_Stat(Path, Buf)                                Path, (Buf)->st_size, (Buf)->st_mode
+#define RPCSTATS_ARGS_hpss_Symlink(Contents, Path)                        Path, 0, 0
+#define RPCSTATS_ARGS_hpss_Truncate(Path, Length)                         Path, Length, 0
+#define RPCSTATS_ARGS_hpss_Unlink(Path)                                   Path, 0, 0
+#define RPCSTATS_ARGS_hpss_UserAttrGetAttrs(Path, Attrs, ...)             Path, (Attrs)->len, 0
+#define RPCSTATS_ARGS_hpss_UserAttrSetAttrs(Path, Attrs, ...)             Path, (Attrs)->len, 0
+#define RPCSTATS_ARGS_hpss_Utime(Path, Times)                             Path, 0, 0
+
+#define hpss_Chmod(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Chmod, hpss_Chmod(__VA_ARGS__), RPCSTATS_ARGS_hpss_Chmod(__VA_ARGS__))
+#define hpss_Chown(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Chown, hpss_Chown(__VA_ARGS__), RPCSTATS_ARGS_hpss_Chown(__VA_ARGS__))
+#define hpss_Close(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Close, hpss_Close(__VA_ARGS__), RPCSTATS_ARGS_hpss_Close(__VA_ARGS__))
+#define hpss_FileGetAttributes(...)        RPCSTATS_CALL(RPCSTATS_CALL_hpss_FileGetAttributes, hpss_FileGetAttributes(__VA_ARGS__), RPCSTATS_ARGS_hpss_FileGetAttributes(__VA_ARGS__))
+#define hpss_FileGetXAttributes(...)       RPCSTATS_CALL(RPCSTATS_CALL_hpss_FileGetXAttributes, hpss_FileGetXAttributes(__VA_ARGS__), RPCSTATS_ARGS_hpss_FileGetXAttributes(__VA_ARGS__))
+#define hpss_FileGetXAttributesHandle(...) RPCSTATS_CALL(RPCSTATS_CALL_hpss_FileGetXAttributesHandle, hpss_FileGetXAttributesHandle(__VA_ARGS__), RPCSTATS_ARGS_hpss_FileGetXAttributesHandle(__VA_ARGS__))
+#define hpss_FilesetGetAttributes(...)     RPCSTATS_CALL(RPCSTATS_CALL_hpss_FilesetGetAttributes, hpss_FilesetGetAttributes(__VA_ARGS__), RPCSTATS_ARGS_hpss_FilesetGetAttributes(__VA_ARGS__))
+#define hpss_LoadDefaultThreadState(...)   RPCSTATS_CALL(RPCSTATS_CALL_hpss_LoadDefaultThreadState, hpss_LoadDefaultThreadState(__VA_ARGS__), RPCSTATS_ARGS_hpss_LoadDefaultThreadState(__VA_ARGS__))
+#define hpss_Lstat(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Lstat, hpss_Lstat(__VA_ARGS__), RPCSTATS_ARGS_hpss_Lstat(__VA_ARGS__))
+#define hpss_Mkdir(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Mkdir, hpss_Mkdir(__VA_ARGS__), RPCSTATS_ARGS_hpss_Mkdir(__VA_ARGS__))
+#define hpss_Open(...)                     RPCSTATS_CALL(RPCSTATS_CALL_hpss_Open, hpss_Open(__VA_ARGS__), RPCSTATS_ARGS_hpss_Open(__VA_ARGS__))
+#define hpss_PIOEnd(...)                   RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIOEnd, hpss_PIOEnd(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIOEnd(__VA_ARGS__))
+#define hpss_PIOExecute(...)               RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIOExecute, hpss_PIOExecute(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIOExecute(__VA_ARGS__))
+#define hpss_PIOExportGrp(...)             RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIOExportGrp, hpss_PIOExportGrp(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIOExportGrp(__VA_ARGS__))
+#define hpss_PIOImportGrp(...)             RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIOImportGrp, hpss_PIOImportGrp(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIOImportGrp(__VA_ARGS__))
+#define hpss_PIORegister(...)              RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIORegister, hpss_PIORegister(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIORegister(__VA_ARGS__))
+#define hpss_PIOStart(...)                 RPCSTATS_CALL(RPCSTATS_CALL_hpss_PIOStart, hpss_PIOStart(__VA_ARGS__), RPCSTATS_ARGS_hpss_PIOStart(__VA_ARGS__))
+#define hpss_ParseAuthString(...)          RPCSTATS_CALL(RPCSTATS_CALL_hpss_ParseAuthString, hpss_ParseAuthString(__VA_ARGS__), RPCSTATS_ARGS_hpss_ParseAuthString(__VA_ARGS__))
+#define hpss_ReadAttrsHandle(...)          RPCSTATS_CALL(RPCSTATS_CALL_hpss_ReadAttrsHandle, hpss_ReadAttrsHandle(__VA_ARGS__), RPCSTATS_ARGS_hpss_ReadAttrsHandle(__VA_ARGS__))
+#define hpss_Readlink(...)                 RPCSTATS_CALL(RPCSTATS_CALL_hpss_Readlink, hpss_Readlink(__VA_ARGS__), RPCSTATS_ARGS_hpss_Readlink(__VA_ARGS__))
+#define hpss_ReadlinkHandle(...)           RPCSTATS_CALL(RPCSTATS_CALL_hpss_ReadlinkHandle, hpss_ReadlinkHandle(__VA_ARGS__), RPCSTATS_ARGS_hpss_ReadlinkHandle(__VA_ARGS__))
+#define hpss_Rename(...)                   RPCSTATS_CALL(RPCSTATS_CALL_hpss_Rename, hpss_Rename(__VA_ARGS__), RPCSTATS_ARGS_hpss_Rename(__VA_ARGS__))
+#define hpss_Rmdir(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Rmdir, hpss_Rmdir(__VA_ARGS__), RPCSTATS_ARGS_hpss_Rmdir(__VA_ARGS__))
+#define hpss_SetCOSByHints(...)            RPCSTATS_CALL(RPCSTATS_CALL_hpss_SetCOSByHints, hpss_SetCOSByHints(__VA_ARGS__), RPCSTATS_ARGS_hpss_SetCOSByHints(__VA_ARGS__))
+#define hpss_SetLoginCred(...)             RPCSTATS_CALL(RPCSTATS_CALL_hpss_SetLoginCred, hpss_SetLoginCred(__VA_ARGS__), RPCSTATS_ARGS_hpss_SetLoginCred(__VA_ARGS__))
+#define hpss_Stage(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Stage, hpss_Stage(__VA_ARGS__), RPCSTATS_ARGS_hpss_Stage(__VA_ARGS__))
+#define hpss_StageCallBack(...)            RPCSTATS_CALL(RPCSTATS_CALL_hpss_StageCallBack, hpss_StageCallBack(__VA_ARGS__), RPCSTATS_ARGS_hpss_StageCallBack(__VA_ARGS__))
+#define hpss_Stat(...)                     RPCSTATS_CALL(RPCSTATS_CALL_hpss_Stat, hpss_Stat(__VA_ARGS__), RPCSTATS_ARGS_hpss_Stat(__VA_ARGS__))
+#define hpss_Symlink(...)                  RPCSTATS_CALL(RPCSTATS_CALL_hpss_Symlink, hpss_Symlink(__VA_ARGS__), RPCSTATS_ARGS_hpss_Symlink(__VA_ARGS__))
+#define hpss_Truncate(...)                 RPCSTATS_CALL(RPCSTATS_CALL_hpss_Truncate, hpss_Truncate(__VA_ARGS__), RPCSTATS_ARGS_hpss_Truncate(__VA_ARGS__))
+#define hpss_Unlink(...)                   RPCSTATS_CALL(RPCSTATS_CALL_hpss_Unlink, hpss_Unlink(__VA_ARGS__), RPCSTATS_ARGS_hpss_Unlink(__VA_ARGS__))
+#define hpss_UserAttrGetAttrs(...)         RPCSTATS_CALL(RPCSTATS_CALL_hpss_UserAttrGetAttrs, hpss_UserAttrGetAttrs(__VA_ARGS__), RPCSTATS_ARGS_hpss_UserAttrGetAttrs(__VA_ARGS__))
+#define hpss_UserAttrSetAttrs(...)         RPCSTATS_CALL(RPCSTATS_CALL_hpss_UserAttrSetAttrs, hpss_UserAttrSetAttrs(__VA_ARGS__), RPCSTATS_ARGS_hpss_UserAttrSetAttrs(__VA_ARGS__))
+#define hpss_Utime(...)                    RPCSTATS_CALL(RPCSTATS_CALL_hpss_Utime, hpss_Utime(__VA_ARGS__), RPCSTATS_ARGS_hpss_Utime(__VA_ARGS__))
+
+#endif /* HPSS_DSI_RPCSTATS_H */
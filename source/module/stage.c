@@ -62,6 +62,7 @@
  */
 #include "stage.h"
 #include "stat.h"
+#include "rpcstats.h"
 
 static globus_list_t * _gStageList = NULL;
 
@@ -241,6 +242,80 @@ stage_get_residency(char * Pathname, stage_file_residency * Residency)
 	return GLOBUS_SUCCESS;
 }
 
+/*
+ * Returns the name of the first volume holding a copy of the file on a tape
+ * level or NULL if the file has no tape copy (or PV lists were not returned).
+ */
+char *
+stage_get_tape_volume(hpss_xfileattr_t * XFileAttr)
+{
+	int storage_level = 0;
+	int vv_index      = 0;
+
+	for (storage_level = 0; storage_level < HPSS_MAX_STORAGE_LEVELS; storage_level++)
+	{
+		if (!(XFileAttr->SCAttrib[storage_level].Flags & BFS_BFATTRS_LEVEL_IS_TAPE))
+			continue;
+
+		for (vv_index = 0; vv_index < XFileAttr->SCAttrib[storage_level].NumberOfVVs; vv_index++)
+		{
+			pv_list_t * pv_list = XFileAttr->SCAttrib[storage_level].VVAttrib[vv_index].PVList;
+
+			if (pv_list != NULL && pv_list->Length > 0)
+				return strdup(pv_list->List[0].Name);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Same as stage_get_residency() but Name is relative to the directory
+ * ObjHandle so that directory listings do not need to resolve a full path
+ * per entry. If ObjHandle is NULL, Name is a full path. If TapeVolume is not
+ * NULL, it is set to the first tape volume holding the file (or NULL if there
+ * is none); the caller frees it.
+ */
+globus_result_t
+stage_get_residency_handle(ns_ObjHandle_t       * ObjHandle,
+                           char                 * Name,
+                           stage_file_residency * Residency,
+                           char                ** TapeVolume)
+{
+	hpss_xfileattr_t xfileattr;
+	int retval = 0;
+
+	GlobusGFSName(stage_get_residency_handle);
+
+	if (TapeVolume)
+		*TapeVolume = NULL;
+
+	memset(&xfileattr, 0, sizeof(hpss_xfileattr_t));
+
+	if (ObjHandle)
+		retval = hpss_FileGetXAttributesHandle(ObjHandle,
+		                                       Name,
+		                                       NULL,
+		                                       API_GET_STATS_FOR_ALL_LEVELS|API_GET_XATTRS_NO_BLOCK,
+		                                       0,
+		                                       &xfileattr);
+	else
+		retval = hpss_FileGetXAttributes(Name,
+		                                 API_GET_STATS_FOR_ALL_LEVELS|API_GET_XATTRS_NO_BLOCK,
+		                                 0,
+		                                 &xfileattr);
+	if (retval)
+		return GlobusGFSErrorSystemError("hpss_FileGetXAttributes", -retval);
+
+	stage_check_residency(&xfileattr, Residency);
+
+	if (TapeVolume)
+		*TapeVolume = stage_get_tape_volume(&xfileattr);
+
+	stage_free_xfileattr(&xfileattr);
+	return GLOBUS_SUCCESS;
+}
+
 globus_result_t
 stage_file(char * Pathname, int Timeout, stage_file_residency * Residency)
 {
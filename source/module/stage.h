@@ -46,6 +46,11 @@
  */
 #include <globus_gridftp_server.h>
 
+/*
+ * HPSS includes
+ */
+#include <ns_ObjHandle.h>
+
 /*
  * Local includes
  */
@@ -58,6 +63,12 @@ typedef enum {
 	STAGE_FILE_ARCHIVED,
 } stage_file_residency;
 
+globus_result_t
+stage_get_residency_handle(ns_ObjHandle_t       * ObjHandle,
+                           char                 * Name,
+                           stage_file_residency * Residency,
+                           char                ** TapeVolume);
+
 void
 stage(globus_gfs_operation_t      Operation,
       globus_gfs_command_info_t * CommandInfo,
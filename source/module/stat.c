@@ -55,6 +55,7 @@
  * Local includes
  */
 #include "stat.h"
+#include "rpcstats.h"
 
 globus_result_t
 stat_translate_stat(char              * Pathname,
@@ -264,6 +265,7 @@ stat_directory_entries(ns_ObjHandle_t    * ObjHandle,       // IN
                        uint32_t          * End,             // OUT
                        uint64_t          * OffsetOut,       // OUT
                        globus_gfs_stat_t * GFSStatArray,    // OUT
+                       ns_ObjHandle_t    * ObjHandleArray,  // OUT, optional
                        uint32_t          * GFSStatCountOut) // OUT
 {
 	globus_result_t result;
@@ -304,8 +306,13 @@ stat_directory_entries(ns_ObjHandle_t    * ObjHandle,       // IN
 			free(dir_entry_buffer);
 			return result;
 		}
+
+		/* Callers walking the tree need the handles to descend. */
+		if (ObjHandleArray)
+			ObjHandleArray[i] = dir_entry_buffer[i].ObjHandle;
 	}
 
+	free(dir_entry_buffer);
 	return GLOBUS_SUCCESS;
 }
 
@@ -64,6 +64,7 @@ stat_directory_entries(ns_ObjHandle_t    * ObjHandle,        // IN
                        uint32_t          * End,              // OUT
                        uint64_t          * OffsetOut,        // OUT
                        globus_gfs_stat_t * GFSStatArray,     // OUT
+                       ns_ObjHandle_t    * ObjHandleArray,   // OUT, optional
                        uint32_t          * GFSStatCountOut); // OUT
 
 void
@@ -49,10 +49,14 @@
  * Local includes
  */
 #include "markers.h"
+#include "bufpool.h"
 #include "config.h"
 #include "stor.h"
 #include "cksm.h"
+#include "journal.h"
 #include "pio.h"
+#include "rpcstats.h"
+#include "trace.h"
 
 globus_result_t
 stor_can_change_cos(char * Pathname, int * can_change_cos)
@@ -158,7 +162,9 @@ stor_open_for_writing(char        * Pathname,
 		goto cleanup;
 	}
 
+	TRACE_BEGIN("cos");
 	result = stor_can_change_cos(Pathname, &can_change_cos);
+	TRACE_END("cos");
 	if (result != GLOBUS_SUCCESS)
 		goto cleanup;
 
@@ -167,11 +173,13 @@ stor_open_for_writing(char        * Pathname,
 	{
 		hpss_cos_md_t cos_md;
 
+		TRACE_BEGIN("set_cos");
 		retval = hpss_SetCOSByHints(*FileFD,
 		                            0,
 		                            &hints_in,
 		                            &priorities,
 		                            &cos_md);
+		TRACE_END("set_cos");
 
 		if (retval)
 		{
@@ -194,6 +202,13 @@ cleanup:
 	return result;
 }
 
+static void
+stor_set_result(stor_info_t * StorInfo, globus_result_t Result)
+{
+	if (Result)
+		__sync_bool_compare_and_swap(&StorInfo->Result, GLOBUS_SUCCESS, Result);
+}
+
 void
 stor_gridftp_callout(globus_gfs_operation_t Operation,
                      globus_result_t        Result,
@@ -213,33 +228,44 @@ stor_gridftp_callout(globus_gfs_operation_t Operation,
 	assert(stor_buffer->Buffer == (char *)Buffer);
 
 
-	pthread_mutex_lock(&stor_info->Mutex);
-	{
-		/* Save EOF */
-		if (Eof) stor_info->Eof = Eof;
-		/* Save any error */
-		if (Result && !stor_info->Result) stor_info->Result = Result;
+	/* Save any error */
+	stor_set_result(stor_info, Result);
 
 assert(Length  <= stor_info->BlockSize);
 
-		/* Set buffer counters. */
-		stor_buffer->BufferOffset   = 0;
-		stor_buffer->TransferOffset = Offset;
-		stor_buffer->BufferLength   = Length;
+	/* Set buffer counters. */
+	stor_buffer->Eof            = Eof;
+	stor_buffer->BufferOffset   = 0;
+	stor_buffer->TransferOffset = Offset;
+	stor_buffer->BufferLength   = Length;
+
+	/* Hand it to the PIO thread. */
+	handoff_push(&stor_info->Returned, &stor_buffer->Node);
+}
+
+/* PIO thread only. Files buffers GridFTP has filled. */
+static void
+stor_collect_buffers(stor_info_t * StorInfo)
+{
+	stor_buffer_t  * stor_buffer = NULL;
+	handoff_node_t * node        = handoff_take_all(&StorInfo->Returned);
+
+	for (; node; node = node->Next)
+	{
+		stor_buffer = (stor_buffer_t *)node;
+
+		/* Save EOF */
+		if (stor_buffer->Eof) StorInfo->Eof = GLOBUS_TRUE;
 
 		/* Stor the buffer. */
-		if (Length)
-			globus_list_insert(&stor_info->ReadyBufferList, stor_buffer);
+		if (stor_buffer->BufferLength)
+			globus_list_insert(&StorInfo->ReadyBufferList, stor_buffer);
 		else
-			globus_list_insert(&stor_info->FreeBufferList, stor_buffer);
+			globus_list_insert(&StorInfo->FreeBufferList, stor_buffer);
 
 		/* Decrease the current connection count. */
-		stor_info->CurConnCnt--;
-
-		/* Wake the PIO thread */
-		pthread_cond_signal(&stor_info->Cond);
+		StorInfo->CurConnCnt--;
 	}
-	pthread_mutex_unlock(&stor_info->Mutex);
 }
 
 
@@ -253,7 +279,7 @@ stor_find_buffer(void * Datum, void * Arg)
 	return 0;
 }
 
-/* Called locked. */
+/* PIO thread only. */
 uint64_t
 stor_copy_out_buffers(stor_info_t * StorInfo,
                       void        * Buffer,
@@ -308,7 +334,22 @@ stor_copy_out_buffers(stor_info_t * StorInfo,
 	return copied_length;
 }
 
-/* Called locked. */
+/* PIO thread only. Frees an idle buffer and returns it to the budget. */
+static void
+stor_drop_free_buffer(stor_info_t * StorInfo)
+{
+	stor_buffer_t * stor_buffer = NULL;
+
+	stor_buffer = globus_list_remove(&StorInfo->FreeBufferList, StorInfo->FreeBufferList);
+	globus_list_remove(&StorInfo->AllBufferList,
+	                   globus_list_search(StorInfo->AllBufferList, stor_buffer));
+
+	bufpool_free(stor_buffer->Buffer, StorInfo->BlockSize);
+	globus_free(stor_buffer);
+	budget_release(&StorInfo->Budget, StorInfo->BlockSize);
+}
+
+/* PIO thread only. */
 globus_result_t
 stor_launch_gridftp_reads(stor_info_t * StorInfo)
 {
@@ -322,6 +363,14 @@ stor_launch_gridftp_reads(stor_info_t * StorInfo)
 		                                             &StorInfo->OptConnCnt);
 	if (StorInfo->ConnChkCnt >= 100) StorInfo->ConnChkCnt = 0;
 
+	/* Give back idle buffers beyond our share of the budget. */
+	while (!globus_list_empty(StorInfo->FreeBufferList)    &&
+	       globus_list_size(StorInfo->AllBufferList) > 1   &&
+	       budget_over_share(&StorInfo->Budget))
+	{
+		stor_drop_free_buffer(StorInfo);
+	}
+
 	// This code assumes the buffers are coming in in order.
 	while (StorInfo->CurConnCnt < StorInfo->OptConnCnt)
 	{
@@ -333,25 +382,32 @@ stor_launch_gridftp_reads(stor_info_t * StorInfo)
 		} else if (globus_list_size(StorInfo->AllBufferList) >= StorInfo->OptConnCnt)
 		{
 			break;
+		} else if (!budget_reserve(&StorInfo->Budget, StorInfo->BlockSize, StorInfo->CurConnCnt == 0))
+		{
+			/* Under pressure, make do with the reads in flight. */
+			break;
 		} else
 		{
 			/* Allocate a new buffer. */
 			stor_buffer = globus_malloc(sizeof(stor_buffer_t));
 			if (!stor_buffer)
 			{
+				budget_release(&StorInfo->Budget, StorInfo->BlockSize);
 				result = GlobusGFSErrorMemory("stor_buffer_t");
 				break;
 			}
-			stor_buffer->Buffer = globus_malloc(StorInfo->BlockSize);
+			stor_buffer->Buffer = bufpool_get(StorInfo->BlockSize);
 			if (!stor_buffer->Buffer)
 			{
 				free(stor_buffer);
+				budget_release(&StorInfo->Budget, StorInfo->BlockSize);
 				result = GlobusGFSErrorMemory("stor_buffer_t");
 				break;
 			}
 			stor_buffer->StorInfo = StorInfo;
 			stor_buffer->Valid = VALID_TAG;
 			globus_list_insert(&StorInfo->AllBufferList, stor_buffer);
+			xferstats_buffers(&StorInfo->Stats, globus_list_size(StorInfo->AllBufferList));
 		}
 
 		result = globus_gridftp_server_register_read(StorInfo->Operation,
@@ -361,7 +417,11 @@ stor_launch_gridftp_reads(stor_info_t * StorInfo)
 		                                             stor_buffer);
 
 		if (result)
+		{
+			/* GridFTP will never hand this one back. */
+			globus_list_insert(&StorInfo->FreeBufferList, stor_buffer);
 			break;
+		}
 
 		/* Increase the current connection count. */
 		StorInfo->CurConnCnt++;
@@ -394,73 +454,106 @@ stor_pio_callout(char     * Buffer,
 	int             rc            = 0;
 	uint64_t        offset_needed = 0;
 	uint64_t        copied_length = 0;
+	uint64_t        resent_length = 0;
 	stor_info_t   * stor_info     = CallbackArg;
+	globus_off_t    pio_end       = stor_info->PIOOffset + stor_info->PIOLength;
 	globus_result_t result        = GLOBUS_SUCCESS;
 
 	GlobusGFSName(stor_pio_callout);
 
-	pthread_mutex_lock(&stor_info->Mutex);
-	{
-		while (!result && copied_length != *Length && !stor_info->Result)
-		{
-			offset_needed = Offset + copied_length;
+	xferstats_callout_begin(&stor_info->Stats);
 
-			copied_length += stor_copy_out_buffers(stor_info,
-			                                       Buffer + copied_length,
-			                                       offset_needed,
-			                                       *Length - copied_length);
+	stor_collect_buffers(stor_info);
 
-			if (stor_info->Eof)
-			{
-				if (copied_length != *Length && (copied_length + offset_needed) != stor_info->TransferInfo->alloc_size)
-					result = GlobusGFSErrorGeneric("Premature end of data transfer");
-				break;
-			}
+	/*
+	 * After a PIO retry, the mover asks again for data it never stored. We
+	 * have already consumed it from GridFTP, so we can only resume if it
+	 * is still in the PIO buffer from the last callout.
+	 */
+	if (stor_info->PIOLength && Offset < pio_end)
+	{
+		if (Buffer != stor_info->PIOBuffer ||
+		    Offset < stor_info->PIOOffset  ||
+		    pio_end - Offset > *Length)
+		{
+			result = GlobusGFSErrorGeneric("Unable to resume the transfer after a PIO error");
+		} else
+		{
+			resent_length = pio_end - Offset;
+			memmove(Buffer, Buffer + (Offset - stor_info->PIOOffset), resent_length);
+			copied_length = resent_length;
+		}
+	}
 
-//			result = stor_check_for_parallel_conns(stor_info, Offset + copied_length);
+	while (!result && copied_length != *Length && !stor_info->Result)
+	{
+		offset_needed = Offset + copied_length;
 
-			if (!result)
-				result = stor_launch_gridftp_reads(stor_info);
+		copied_length += stor_copy_out_buffers(stor_info,
+		                                       Buffer + copied_length,
+		                                       offset_needed,
+		                                       *Length - copied_length);
 
-			if (!result && copied_length != *Length)
-				pthread_cond_wait(&stor_info->Cond, &stor_info->Mutex);
+		if (stor_info->Eof)
+		{
+			if (copied_length != *Length && (copied_length + offset_needed) != stor_info->TransferInfo->alloc_size)
+				result = GlobusGFSErrorGeneric("Premature end of data transfer");
+			break;
 		}
 
-		if (copied_length)
-			markers_update_perf_markers(stor_info->Operation, Offset, copied_length);
+//		result = stor_check_for_parallel_conns(stor_info, Offset + copied_length);
 
-		if (!stor_info->Result)
-			stor_info->Result = result;
-		if (stor_info->Result)
-			copied_length = -1;
+		if (!result)
+			result = stor_launch_gridftp_reads(stor_info);
 
-		if (result)
+		if (!result && copied_length != *Length)
 		{
-			if (!stor_info->Result) stor_info->Result = result;
-			rc = PIO_END_TRANSFER; /* Signal to shutdown. */
+			TRACE_BEGIN("wait_buffer");
+			handoff_wait(&stor_info->Returned, &stor_info->Stats.WaitGridFTP);
+			TRACE_END("wait_buffer");
+			stor_collect_buffers(stor_info);
 		}
 	}
-	pthread_mutex_unlock(&stor_info->Mutex);
 
+	if (copied_length > resent_length)
+		markers_add_perf(&stor_info->Markers,
+		                 Offset + resent_length,
+		                 copied_length - resent_length);
+
+	stor_set_result(stor_info, result);
+	if (stor_info->Result)
+		copied_length = -1;
+
+	if (result)
+		rc = PIO_END_TRANSFER; /* Signal to shutdown. */
+
+	if (!rc)
+	{
+		stor_info->PIOBuffer = Buffer;
+		stor_info->PIOOffset = Offset;
+		stor_info->PIOLength = *Length;
+	}
+
+	xferstats_callout_end(&stor_info->Stats, rc ? 0 : *Length);
 	return rc;
 }
 
+/*
+ * Waits for every register_read() to call back, even after an error; the
+ * buffers go back to the pool once we return.
+ */
 void
 stor_wait_for_gridftp(stor_info_t * StorInfo)
 {
-	pthread_mutex_lock(&StorInfo->Mutex);
+	while (1)
 	{
-		while (1)
-		{
-			if (StorInfo->Result) break;
+		stor_collect_buffers(StorInfo);
 
-			if (globus_list_size(StorInfo->AllBufferList) == globus_list_size(StorInfo->FreeBufferList))
-				break;
+		if (StorInfo->CurConnCnt == 0)
+			break;
 
-			pthread_cond_wait(&StorInfo->Cond, &StorInfo->Mutex);
-		}
+		handoff_wait(&StorInfo->Returned, &StorInfo->Stats.WaitGridFTP);
 	}
-	pthread_mutex_unlock(&StorInfo->Mutex);
 }
 
 void
@@ -469,15 +562,26 @@ stor_range_complete_callback(globus_off_t * Offset,
                              int          * Eot,
                              void         * UserArg)
 {
-	stor_info_t * stor_info = UserArg;
+	stor_info_t   * stor_info = UserArg;
+	globus_result_t result    = GLOBUS_SUCCESS;
+
+	markers_add_restart(&stor_info->Markers, *Offset, *Length);
 
-	markers_update_restart_markers(stor_info->Operation, *Offset, *Length);
+	/* A failed commit only costs a resend on restart. */
+	if (stor_info->Journal)
+	{
+		result = journal_commit(stor_info->Journal, *Offset, *Length);
+		if (result)
+			globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+			                       "Unable to update the STOR journal of %s\n",
+			                       stor_info->TransferInfo->pathname);
+	}
 
 assert(*Length <= stor_info->RangeLength);
 
 	stor_info->RangeLength -= *Length;
 	*Offset                += *Length;
-	*Length                 = stor_info->RangeLength;
+	*Length                 = journal_segment(stor_info->Journal, stor_info->RangeLength);
 
 	*Eot = 0;
 	if (stor_info->RangeLength == 0)
@@ -486,14 +590,16 @@ assert(*Length <= stor_info->RangeLength);
 		if (*Length == -1)
 			*Eot = 1;
 		stor_info->RangeLength = *Length;
+		*Length = journal_segment(stor_info->Journal, *Length);
 	}
 }
 
+/* Arg is the block size. */
 static int
 release_buffer(void * Datum, void * Arg)
 {
 	((stor_buffer_t *)Datum)->Valid = INVALID_TAG;
-	free(((stor_buffer_t *)Datum)->Buffer);
+	bufpool_put(((stor_buffer_t *)Datum)->Buffer, *(globus_size_t *)Arg);
 
 	return 0;
 }
@@ -508,8 +614,12 @@ stor_transfer_complete_callback(globus_result_t Result,
 
 	GlobusGFSName(stor_transfer_complete_callback);
 
+	markers_destroy(&stor_info->Markers);
 	globus_gridftp_server_finished_transfer(stor_info->Operation, result);
+
+	TRACE_BEGIN("wait_gridftp");
 	stor_wait_for_gridftp(stor_info);
+	TRACE_END("wait_gridftp");
 
 	/* Prefer our error over PIO's. */
 	if (stor_info->Result)
@@ -517,18 +627,36 @@ stor_transfer_complete_callback(globus_result_t Result,
 	if (!result)
 		result = stor_info->Result;
 	
+	TRACE_BEGIN("close");
 	rc = hpss_Close(stor_info->FileFD);
+	TRACE_END("close");
 	if (rc && !result)
 		result = GlobusGFSErrorSystemError("hpss_Close", -rc);
 
-	pthread_mutex_destroy(&stor_info->Mutex);
-	pthread_cond_destroy(&stor_info->Cond);
+	/* Keep the journal of a failed upload so that it can resume. */
+	if (stor_info->Journal && !result && journal_clear(stor_info->Journal))
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "Unable to clear the STOR journal of %s\n",
+		                       stor_info->TransferInfo->pathname);
+	if (stor_info->Journal && result && journal_save(stor_info->Journal))
+		globus_gfs_log_message(GLOBUS_GFS_LOG_WARN,
+		                       "Unable to update the STOR journal of %s\n",
+		                       stor_info->TransferInfo->pathname);
+	journal_destroy(stor_info->Journal);
+
+	xferstats_log(&stor_info->Stats, "STOR", &stor_info->Returned);
+
 	globus_list_free(stor_info->FreeBufferList);
 	globus_list_free(stor_info->ReadyBufferList);
 
-	globus_list_search_pred(stor_info->AllBufferList, release_buffer, NULL);
+	/* Give up our share before the buffers go back to the pool. */
+	budget_leave(&stor_info->Budget);
+	globus_list_search_pred(stor_info->AllBufferList, release_buffer, &stor_info->BlockSize);
 	globus_list_destroy_all(stor_info->AllBufferList, free);
+	handoff_destroy(&stor_info->Returned);
 	free(stor_info);
+
+	TRACE_TRANSFER_END();
 }
 
 void
@@ -543,6 +671,8 @@ stor(globus_gfs_operation_t       Operation,
 
 	GlobusGFSName(stor);
 
+	TRACE_TRANSFER_BEGIN("STOR", TransferInfo->pathname);
+
 	/*
 	 * Create our structure.
 	 */
@@ -556,25 +686,39 @@ stor(globus_gfs_operation_t       Operation,
 	stor_info->Operation    = Operation;
 	stor_info->TransferInfo = TransferInfo;
 	stor_info->FileFD       = -1;
-	pthread_mutex_init(&stor_info->Mutex, NULL);
-	pthread_cond_init(&stor_info->Cond, NULL);
+	handoff_init(&stor_info->Returned);
+	budget_join(&stor_info->Budget);
+	xferstats_init(&stor_info->Stats, TransferInfo->pathname);
 
 	globus_gridftp_server_get_block_size(Operation, &stor_info->BlockSize);
 
+	TRACE_BEGIN("clear_checksum");
 	result = cksm_clear_checksum(TransferInfo->pathname, Config);
+	TRACE_END("clear_checksum");
 	if (result) goto cleanup;
 
 	/*
 	 * Open the file.
 	 */
+	TRACE_BEGIN("open");
 	result = stor_open_for_writing(TransferInfo->pathname,
 	                               TransferInfo->alloc_size,
 	                               TransferInfo->truncate,
 	                               &stor_info->FileFD,
 	                               &file_stripe_width);
+	TRACE_END("open");
+	if (result) goto cleanup;
+
+	TRACE_BEGIN("journal");
+	result = journal_init(TransferInfo->pathname,
+	                      TransferInfo->truncate,
+	                      Config,
+	                      &stor_info->Journal);
+	TRACE_END("journal");
 	if (result) goto cleanup;
 
 	globus_gridftp_server_begin_transfer(Operation, 0, NULL);
+	markers_init(&stor_info->Markers, Operation);
 
 	globus_gridftp_server_get_write_range(Operation, &offset, &stor_info->RangeLength);
 	if (stor_info->RangeLength == -1)
@@ -588,38 +732,40 @@ stor(globus_gfs_operation_t       Operation,
 	 */
 	if (stor_info->RangeLength == 0)
 	{
-		pthread_mutex_lock(&stor_info->Mutex);
-		{
-			result = stor_launch_gridftp_reads(stor_info);
-		}
-		pthread_mutex_unlock(&stor_info->Mutex);
+		result = stor_launch_gridftp_reads(stor_info);
 		if (result) goto cleanup;
 	}
 
 	/*
 	 * Setup PIO
 	 */
+	TRACE_BEGIN("pio_start");
 	result = pio_start(HPSS_PIO_WRITE,
 	                   stor_info->FileFD,
 	                   file_stripe_width,
 	                   stor_info->BlockSize,
 	                   offset,
-	                   stor_info->RangeLength,
+	                   journal_segment(stor_info->Journal, stor_info->RangeLength),
 	                   stor_pio_callout,
 	                   stor_range_complete_callback,
 	                   stor_transfer_complete_callback,
 	                   stor_info);
+	TRACE_END("pio_start");
 
 cleanup:
 	if (result)
 	{
+		TRACE_TRANSFER_END();
+		if (stor_info)
+			markers_destroy(&stor_info->Markers);
 		globus_gridftp_server_finished_transfer(Operation, result);
 		if (stor_info)
 		{
 			if (stor_info->FileFD != -1)
 				hpss_Close(stor_info->FileFD);
-			pthread_mutex_destroy(&stor_info->Mutex);
-			pthread_cond_destroy(&stor_info->Cond);
+			journal_destroy(stor_info->Journal);
+			budget_leave(&stor_info->Budget);
+			xferstats_log(&stor_info->Stats, "STOR", NULL);
 			free(stor_info);
 		}
 	}
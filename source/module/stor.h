@@ -55,8 +55,13 @@
 /*
  * Local includes
  */
+#include "budget.h"
 #include "config.h"
+#include "handoff.h"
+#include "journal.h"
+#include "markers.h"
 #include "pio.h"
+#include "xferstats.h"
 
 /*
  * Because of the sequential, ascending nature of offsets with PIO,
@@ -65,7 +70,9 @@
 struct stor_info;
 
 typedef struct {
+	handoff_node_t     Node; // Must be first
 	char             * Buffer;
+	globus_bool_t      Eof;            // Set by the GridFTP callback
 	globus_off_t       BufferOffset;   // Moves as buffer is consumed
 	globus_off_t       TransferOffset; // Moves as BufferOffset moves
 	globus_off_t       BufferLength;   // Moves as BufferOffset moves
@@ -81,23 +88,38 @@ typedef struct stor_info {
 
 	int FileFD;
 
-	globus_result_t Result;
+	globus_result_t Result; // First error wins; set with stor_set_result()
 	globus_size_t   BlockSize;
 
-	pthread_mutex_t Mutex;
-	pthread_cond_t  Cond;
-
 	globus_off_t    RangeLength; // Current range transfer length
 	globus_bool_t   Eof;
 
+	/*
+	 * The last block handed to PIO. It stays in the PIO buffer until the
+	 * next callout so a PIO retry can resume from within it.
+	 */
+	char          * PIOBuffer;
+	globus_off_t    PIOOffset;
+	globus_off_t    PIOLength;
+
+	journal_t     * Journal; // NULL unless StorJournalSupport
+
 	int OptConnCnt;
 	int ConnChkCnt;
 	int CurConnCnt;
 
+	/*
+	 * Only the PIO thread touches the buffer lists. GridFTP hands filled
+	 * buffers back through Returned.
+	 */
 	globus_list_t * AllBufferList;
 	globus_list_t * ReadyBufferList;
 	globus_list_t * FreeBufferList;
+	handoff_t       Returned;
+	budget_t        Budget;
 
+	markers_t       Markers;
+	xferstats_t     Stats;
 } stor_info_t;
 
 void
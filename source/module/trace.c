@@ -0,0 +1,375 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+#ifdef HPSS_DSI_TRACE
+
+/*
+ * System includes
+ */
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Local includes
+ */
+#include "histogram.h"
+#include "trace.h"
+
+/* How often the flusher drains the rings when nothing wakes it. */
+#define TRACE_FLUSH_INTERVAL_MS 100
+
+typedef struct {
+	uint64_t     Timestamp; // usecs, histogram_now()
+	const char * Name;
+	uint32_t     TransferID;
+	char         Phase;     // Chrome phase: 'B'egin / 'E'nd
+} trace_event_t;
+
+/*
+ * Single producer (the owning thread), single consumer (the flusher). Head
+ * is only written by the producer and Tail only by the consumer; each
+ * publishes with a full barrier after touching the slots.
+ */
+typedef struct trace_ring {
+	trace_event_t       Events[TRACE_RING_SIZE];
+	volatile uint64_t   Head;
+	volatile uint64_t   Tail;
+	pid_t               ThreadID;
+	volatile int        Exited; // Set when the owning thread exits
+	struct trace_ring * Next;
+} trace_ring_t;
+
+typedef struct {
+	uint32_t TransferID; // 0 if the slot is free
+	FILE   * File;
+	int      Ended;
+} trace_transfer_t;
+
+static pthread_once_t   trace_once       = PTHREAD_ONCE_INIT;
+static pthread_key_t    trace_ring_key;
+static pthread_mutex_t  trace_lock       = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   trace_cond       = PTHREAD_COND_INITIALIZER;
+static trace_ring_t   * trace_rings      = NULL;
+static trace_transfer_t trace_transfers[TRACE_MAX_TRANSFERS];
+static uint32_t         trace_next_transfer_id = 0;
+
+static __thread trace_ring_t * trace_thread_ring     = NULL;
+static __thread uint32_t       trace_thread_transfer = 0;
+
+static void
+trace_ring_exit(void * Arg)
+{
+	((trace_ring_t *)Arg)->Exited = 1;
+}
+
+static void
+trace_write_string(FILE * File, const char * String)
+{
+	for (; *String; String++)
+	{
+		if (*String == '"' || *String == '\\')
+			fprintf(File, "\\%c", *String);
+		else if ((unsigned char)*String < 0x20)
+			fprintf(File, "\\u%04x", *String);
+		else
+			fputc(*String, File);
+	}
+}
+
+static trace_transfer_t *
+trace_find_transfer(uint32_t TransferID)
+{
+	int i;
+
+	for (i = 0; i < TRACE_MAX_TRANSFERS; i++)
+	{
+		if (trace_transfers[i].TransferID == TransferID)
+			return &trace_transfers[i];
+	}
+	return NULL;
+}
+
+/* Called with trace_lock held. */
+static void
+trace_drain(trace_ring_t * Ring)
+{
+	uint64_t           tail     = Ring->Tail;
+	uint64_t           head     = Ring->Head;
+	trace_event_t    * event    = NULL;
+	trace_transfer_t * transfer = NULL;
+
+	__sync_synchronize();
+
+	for (; tail != head; tail++)
+	{
+		event = &Ring->Events[tail % TRACE_RING_SIZE];
+
+		/* Events for transfers already closed, or never opened, are lost. */
+		transfer = trace_find_transfer(event->TransferID);
+		if (!event->TransferID || !transfer)
+			continue;
+
+		fprintf(transfer->File,
+		        ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRIu64",\"pid\":%d,\"tid\":%d}",
+		        event->Name,
+		        event->Phase,
+		        event->Timestamp,
+		        getpid(),
+		        Ring->ThreadID);
+	}
+
+	__sync_synchronize();
+	Ring->Tail = tail;
+}
+
+static void *
+trace_flusher(void * Arg)
+{
+	int                i;
+	trace_ring_t    ** ring_ptr = NULL;
+	trace_ring_t     * ring     = NULL;
+	trace_transfer_t * transfer = NULL;
+	struct timespec    timeout;
+
+	pthread_mutex_lock(&trace_lock);
+	while (1)
+	{
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_nsec += TRACE_FLUSH_INTERVAL_MS * 1000000L;
+		timeout.tv_sec  += timeout.tv_nsec / 1000000000L;
+		timeout.tv_nsec %= 1000000000L;
+		pthread_cond_timedwait(&trace_cond, &trace_lock, &timeout);
+
+		for (ring_ptr = &trace_rings; (ring = *ring_ptr); )
+		{
+			trace_drain(ring);
+
+			/* Detached PIO threads come and go with each transfer. */
+			if (ring->Exited && ring->Tail == ring->Head)
+			{
+				*ring_ptr = ring->Next;
+				free(ring);
+				continue;
+			}
+			ring_ptr = &ring->Next;
+		}
+
+		/* Everything an ended transfer recorded was drained above. */
+		for (i = 0; i < TRACE_MAX_TRANSFERS; i++)
+		{
+			transfer = &trace_transfers[i];
+			if (!transfer->TransferID || !transfer->Ended)
+				continue;
+
+			fprintf(transfer->File, "\n]\n");
+			fclose(transfer->File);
+			memset(transfer, 0, sizeof(*transfer));
+		}
+	}
+	pthread_mutex_unlock(&trace_lock);
+
+	return NULL;
+}
+
+static void
+trace_init()
+{
+	pthread_t      thread;
+	pthread_attr_t attr;
+
+	pthread_key_create(&trace_ring_key, trace_ring_exit);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_create(&thread, &attr, trace_flusher, NULL);
+	pthread_attr_destroy(&attr);
+}
+
+void
+trace_transfer_begin(const char * Kind, const char * Pathname)
+{
+	char               path[1024];
+	const char       * dir      = getenv("HPSS_DSI_TRACE_DIR");
+	uint32_t           id       = 0;
+	int                fd       = -1;
+	FILE             * file     = NULL;
+	trace_transfer_t * transfer = NULL;
+
+	pthread_once(&trace_once, trace_init);
+
+	trace_thread_transfer = 0;
+
+	id = __sync_add_and_fetch(&trace_next_transfer_id, 1);
+
+	snprintf(path,
+	         sizeof(path),
+	         "%s/hpss_dsi_trace.%d.%u.json",
+	         dir ? dir : "/tmp",
+	         getpid(),
+	         id);
+
+	/*
+	 * Traces hold path names and default to /tmp; keep them private and
+	 * don't follow or reuse anything planted under our name.
+	 */
+	fd = open(path, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW, 0600);
+	if (fd == -1)
+		return;
+
+	file = fdopen(fd, "w");
+	if (!file)
+	{
+		close(fd);
+		unlink(path);
+		return;
+	}
+
+	/* The process name row labels the transfer in the viewer. */
+	fprintf(file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s ", getpid(), Kind);
+	trace_write_string(file, Pathname);
+	fprintf(file, "\"}}");
+
+	pthread_mutex_lock(&trace_lock);
+	{
+		transfer = trace_find_transfer(0);
+		if (transfer)
+		{
+			transfer->TransferID = id;
+			transfer->File       = file;
+			transfer->Ended      = 0;
+		}
+	}
+	pthread_mutex_unlock(&trace_lock);
+
+	if (!transfer)
+	{
+		fclose(file);
+		unlink(path);
+		return;
+	}
+
+	trace_thread_transfer = id;
+}
+
+void
+trace_transfer_end()
+{
+	trace_transfer_t * transfer = NULL;
+
+	if (!trace_thread_transfer)
+		return;
+
+	pthread_mutex_lock(&trace_lock);
+	{
+		transfer = trace_find_transfer(trace_thread_transfer);
+		if (transfer)
+			transfer->Ended = 1;
+		pthread_cond_signal(&trace_cond);
+	}
+	pthread_mutex_unlock(&trace_lock);
+
+	trace_thread_transfer = 0;
+}
+
+uint32_t
+trace_get_transfer()
+{
+	return trace_thread_transfer;
+}
+
+void
+trace_set_transfer(uint32_t TransferID)
+{
+	trace_thread_transfer = TransferID;
+}
+
+void
+trace_event(const char * Name, char Phase)
+{
+	uint64_t        head  = 0;
+	trace_ring_t  * ring  = trace_thread_ring;
+	trace_event_t * event = NULL;
+
+	if (!trace_thread_transfer)
+		return;
+
+	if (!ring)
+	{
+		ring = calloc(1, sizeof(trace_ring_t));
+		if (!ring)
+			return;
+		ring->ThreadID = syscall(SYS_gettid);
+
+		pthread_once(&trace_once, trace_init);
+		pthread_setspecific(trace_ring_key, ring);
+
+		pthread_mutex_lock(&trace_lock);
+		{
+			ring->Next  = trace_rings;
+			trace_rings = ring;
+		}
+		pthread_mutex_unlock(&trace_lock);
+
+		trace_thread_ring = ring;
+	}
+
+	head = ring->Head;
+	if (head - ring->Tail >= TRACE_RING_SIZE)
+		return;
+
+	event = &ring->Events[head % TRACE_RING_SIZE];
+	event->Timestamp  = histogram_now();
+	event->Name       = Name;
+	event->TransferID = trace_thread_transfer;
+	event->Phase      = Phase;
+
+	__sync_synchronize();
+	ring->Head = head + 1;
+}
+
+#endif /* HPSS_DSI_TRACE */
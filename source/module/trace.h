@@ -0,0 +1,109 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_TRACE_H
+#define HPSS_DSI_TRACE_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Transfer timeline tracing. Built only with -DHPSS_DSI_TRACE (ie
+ * 'make CFLAGS=-DHPSS_DSI_TRACE'); otherwise every TRACE_*() below compiles
+ * to nothing.
+ *
+ * Each thread records its events into its own lock free ring. A background
+ * thread drains the rings and writes one Chrome trace file (chrome://tracing,
+ * Perfetto) per transfer to $HPSS_DSI_TRACE_DIR, /tmp by default, named
+ * hpss_dsi_trace.<pid>.<transfer>.json, mode 0600. A transfer whose file
+ * already exists is not traced.
+ *
+ * Events belong to the transfer the recording thread is working on. The
+ * thread that starts a transfer gets it from TRACE_TRANSFER_BEGIN(); threads
+ * started for it must be handed TRACE_GET_TRANSFER() and call
+ * TRACE_SET_TRANSFER(). Names must be string literals; only the pointer is
+ * recorded.
+ */
+
+#ifdef HPSS_DSI_TRACE
+
+/* Events per thread ring; events are dropped while a ring is full. */
+#define TRACE_RING_SIZE 4096
+
+/* Transfers that can have a trace file open at once. */
+#define TRACE_MAX_TRANSFERS 32
+
+void
+trace_transfer_begin(const char * Kind, const char * Pathname);
+
+/* Closes the current transfer's trace once its events are written. */
+void
+trace_transfer_end();
+
+uint32_t
+trace_get_transfer();
+
+void
+trace_set_transfer(uint32_t TransferID);
+
+void
+trace_event(const char * Name, char Phase);
+
+#define TRACE_TRANSFER_BEGIN(Kind, Pathname) trace_transfer_begin(Kind, Pathname)
+#define TRACE_TRANSFER_END()                 trace_transfer_end()
+#define TRACE_GET_TRANSFER()                 trace_get_transfer()
+#define TRACE_SET_TRANSFER(TransferID)       trace_set_transfer(TransferID)
+#define TRACE_BEGIN(Name)                    trace_event(Name, 'B')
+#define TRACE_END(Name)                      trace_event(Name, 'E')
+
+#else /* HPSS_DSI_TRACE */
+
+#define TRACE_TRANSFER_BEGIN(Kind, Pathname)
+#define TRACE_TRANSFER_END()
+#define TRACE_GET_TRANSFER()                 0
+#define TRACE_SET_TRANSFER(TransferID)
+#define TRACE_BEGIN(Name)
+#define TRACE_END(Name)
+
+#endif /* HPSS_DSI_TRACE */
+
+#endif /* HPSS_DSI_TRACE_H */
@@ -0,0 +1,608 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <hpss_api.h>
+
+/*
+ * Local includes
+ */
+#include "stat.h"
+#include "walk.h"
+#include "rpcstats.h"
+
+/*
+ * Each worker owns a deque of directories waiting to be read. The owner
+ * pushes and pops at the bottom so it works depth first on what it just
+ * found; thieves take from the top where the shallower, larger subtrees sit.
+ */
+typedef struct {
+	pthread_mutex_t   Mutex;
+	walk_dir_t     ** Dirs;
+	int               Size;
+	int               Top;
+	int               Bottom;
+} walk_deque_t;
+
+typedef struct {
+	pthread_mutex_t              Mutex;
+	pthread_cond_t               Cond;
+	int                          Queued;      // Dirs sitting in deques
+	int                          Outstanding; // Dirs queued or being read
+	globus_result_t              Result;
+	int                          MaxDepth;
+	int                          ThreadCount;
+	int                          Flags;
+	walk_deque_t               * Deques;
+	walk_entries_callback        EntriesCallback;
+	walk_dir_complete_callback   DirCompleteCallback;
+	void                       * UserArg;
+} walk_t;
+
+typedef struct {
+	walk_t * Walk;
+	int      ID;
+} walk_worker_t;
+
+static walk_dir_t *
+walk_dir_new(walk_dir_t * Parent, ns_ObjHandle_t * ObjHandle, char * Path, char * Name)
+{
+	walk_dir_t * dir = NULL;
+
+	dir = malloc(sizeof(walk_dir_t));
+	if (!dir)
+		return NULL;
+	memset(dir, 0, sizeof(walk_dir_t));
+
+	dir->Parent    = Parent;
+	dir->ObjHandle = *ObjHandle;
+	dir->Pending   = 1; // For reading our own entries
+
+	if (Parent)
+	{
+		dir->Depth   = Parent->Depth + 1;
+		dir->Path    = globus_common_create_string("%s/%s", Parent->Path, Name);
+		dir->RelPath = Parent->RelPath[0] ?
+		                   globus_common_create_string("%s/%s", Parent->RelPath, Name) :
+		                   globus_libc_strdup(Name);
+	} else
+	{
+		dir->Path    = globus_libc_strdup(Path);
+		dir->RelPath = globus_libc_strdup("");
+	}
+
+	if (!dir->Path || !dir->RelPath)
+	{
+		if (dir->Path)
+			globus_free(dir->Path);
+		if (dir->RelPath)
+			globus_free(dir->RelPath);
+		free(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+static void
+walk_dir_free(walk_dir_t * Dir)
+{
+	globus_free(Dir->Path);
+	globus_free(Dir->RelPath);
+	free(Dir);
+}
+
+static void
+walk_set_result(walk_t * Walk, globus_result_t Result)
+{
+	pthread_mutex_lock(&Walk->Mutex);
+	{
+		if (Walk->Result == GLOBUS_SUCCESS)
+			Walk->Result = Result;
+	}
+	pthread_mutex_unlock(&Walk->Mutex);
+}
+
+static int
+walk_aborted(walk_t * Walk)
+{
+	int aborted;
+
+	pthread_mutex_lock(&Walk->Mutex);
+	{
+		aborted = (Walk->Result != GLOBUS_SUCCESS);
+	}
+	pthread_mutex_unlock(&Walk->Mutex);
+
+	return aborted;
+}
+
+static globus_result_t
+walk_push(walk_t * Walk, int ID, walk_dir_t * Dir)
+{
+	walk_deque_t  * deque = &Walk->Deques[ID];
+	walk_dir_t   ** dirs  = NULL;
+	int             size  = 0;
+
+	GlobusGFSName(walk_push);
+
+	pthread_mutex_lock(&deque->Mutex);
+	{
+		if (deque->Bottom == deque->Size)
+		{
+			/* Slide down over the slots thieves have emptied. */
+			if (deque->Top > 0)
+			{
+				memmove(deque->Dirs,
+				        deque->Dirs + deque->Top,
+				        sizeof(walk_dir_t *) * (deque->Bottom - deque->Top));
+				deque->Bottom -= deque->Top;
+				deque->Top     = 0;
+			}
+
+			if (deque->Bottom == deque->Size)
+			{
+				size = deque->Size ? deque->Size * 2 : 64;
+				dirs = realloc(deque->Dirs, sizeof(walk_dir_t *) * size);
+				if (!dirs)
+				{
+					pthread_mutex_unlock(&deque->Mutex);
+					return GlobusGFSErrorMemory("walk deque");
+				}
+				deque->Dirs = dirs;
+				deque->Size = size;
+			}
+		}
+		deque->Dirs[deque->Bottom++] = Dir;
+	}
+	pthread_mutex_unlock(&deque->Mutex);
+
+	pthread_mutex_lock(&Walk->Mutex);
+	{
+		Walk->Queued++;
+		Walk->Outstanding++;
+		pthread_cond_signal(&Walk->Cond);
+	}
+	pthread_mutex_unlock(&Walk->Mutex);
+
+	return GLOBUS_SUCCESS;
+}
+
+static walk_dir_t *
+walk_take(walk_t * Walk, int ID, int Steal)
+{
+	walk_deque_t * deque = &Walk->Deques[ID];
+	walk_dir_t   * dir   = NULL;
+
+	pthread_mutex_lock(&deque->Mutex);
+	{
+		if (deque->Top < deque->Bottom)
+		{
+			if (Steal)
+				dir = deque->Dirs[deque->Top++];
+			else
+				dir = deque->Dirs[--deque->Bottom];
+
+			if (deque->Top == deque->Bottom)
+				deque->Top = deque->Bottom = 0;
+		}
+	}
+	pthread_mutex_unlock(&deque->Mutex);
+
+	if (dir)
+	{
+		pthread_mutex_lock(&Walk->Mutex);
+		{
+			Walk->Queued--;
+		}
+		pthread_mutex_unlock(&Walk->Mutex);
+	}
+
+	return dir;
+}
+
+/*
+ * Drops one reference on Dir. Once nothing is pending on a directory it is
+ * complete, which in turn releases its parent's reference.
+ */
+static void
+walk_release(walk_t * Walk, walk_dir_t * Dir)
+{
+	walk_dir_t * parent  = NULL;
+	int          pending = 0;
+
+	while (Dir)
+	{
+		pthread_mutex_lock(&Walk->Mutex);
+		{
+			pending = --Dir->Pending;
+		}
+		pthread_mutex_unlock(&Walk->Mutex);
+
+		if (pending > 0)
+			return;
+
+		if (Walk->DirCompleteCallback && !walk_aborted(Walk))
+			Walk->DirCompleteCallback(Dir, Walk->UserArg);
+
+		parent = Dir->Parent;
+		walk_dir_free(Dir);
+		Dir = parent;
+	}
+}
+
+/* Queues Dir's subdirectories among Count entries, then hands them all over. */
+static globus_result_t
+walk_entries(walk_t            * Walk,
+             int                 ID,
+             walk_dir_t        * Dir,
+             globus_gfs_stat_t * GFSStatArray,
+             ns_ObjHandle_t    * ObjHandleArray,
+             uint32_t            Count)
+{
+	int               i      = 0;
+	walk_dir_t      * subdir = NULL;
+	globus_result_t   result = GLOBUS_SUCCESS;
+
+	GlobusGFSName(walk_entries);
+
+	/* Queue subdirectories before the callback so idle workers can start on them. */
+	for (i = 0; i < Count && result == GLOBUS_SUCCESS; i++)
+	{
+		if (!S_ISDIR(GFSStatArray[i].mode))
+			continue;
+		if (Walk->MaxDepth >= 0 && Dir->Depth >= Walk->MaxDepth)
+			continue;
+
+		subdir = walk_dir_new(Dir, &ObjHandleArray[i], NULL, GFSStatArray[i].name);
+		if (!subdir)
+		{
+			result = GlobusGFSErrorMemory("walk_dir_t");
+			break;
+		}
+
+		pthread_mutex_lock(&Walk->Mutex);
+		{
+			Dir->Pending++;
+		}
+		pthread_mutex_unlock(&Walk->Mutex);
+
+		result = walk_push(Walk, ID, subdir);
+		if (result)
+		{
+			walk_dir_free(subdir);
+			walk_release(Walk, Dir);
+		}
+	}
+
+	if (!result && Walk->EntriesCallback)
+		result = Walk->EntriesCallback(Dir, GFSStatArray, Count, Walk->UserArg);
+
+	return result;
+}
+
+static void
+walk_read_dir(walk_t * Walk, int ID, walk_dir_t * Dir)
+{
+	uint64_t            offset           = 0;
+	uint32_t            end              = FALSE;
+	uint32_t            count            = 0;
+	uint32_t            count_out        = 0;
+	uint32_t            i                = 0;
+	uint32_t            read_end         = 0;
+	uint32_t            size             = WALK_ENTRIES_PER_CHUNK;
+	void              * tmp              = NULL;
+	globus_result_t     result           = GLOBUS_SUCCESS;
+	globus_gfs_stat_t   gfs_stat_chunk[WALK_ENTRIES_PER_CHUNK];
+	ns_ObjHandle_t      obj_handle_chunk[WALK_ENTRIES_PER_CHUNK];
+	globus_gfs_stat_t * gfs_stat_array   = gfs_stat_chunk;
+	ns_ObjHandle_t    * obj_handle_array = obj_handle_chunk;
+
+	GlobusGFSName(walk_read_dir);
+
+	if (Walk->Flags & WALK_WHOLE_DIRS)
+	{
+		gfs_stat_array   = NULL;
+		obj_handle_array = NULL;
+		size             = 0;
+	}
+
+	while (!end && !walk_aborted(Walk))
+	{
+		/* Only whole directory reads keep more than one chunk. */
+		if (count + WALK_ENTRIES_PER_CHUNK > size)
+		{
+			size += WALK_ENTRIES_PER_CHUNK;
+
+			tmp = realloc(gfs_stat_array, size * sizeof(globus_gfs_stat_t));
+			if (!tmp)
+			{
+				result = GlobusGFSErrorMemory("globus_gfs_stat_t");
+				break;
+			}
+			gfs_stat_array = tmp;
+
+			tmp = realloc(obj_handle_array, size * sizeof(ns_ObjHandle_t));
+			if (!tmp)
+			{
+				result = GlobusGFSErrorMemory("ns_ObjHandle_t");
+				break;
+			}
+			obj_handle_array = tmp;
+		}
+
+		result = stat_directory_entries(&Dir->ObjHandle,
+		                                offset,
+		                                WALK_ENTRIES_PER_CHUNK,
+		                                &end,
+		                                &offset,
+		                                gfs_stat_array + count,
+		                                obj_handle_array + count,
+		                                &count_out);
+		if (result)
+			break;
+
+		/* Callers never want '.' or '..', and we must not descend into them. */
+		read_end = count + count_out;
+		for (i = count; i < read_end; i++)
+		{
+			if (strcmp(gfs_stat_array[i].name, ".") == 0 || strcmp(gfs_stat_array[i].name, "..") == 0)
+			{
+				stat_destroy(&gfs_stat_array[i]);
+				continue;
+			}
+
+			gfs_stat_array[count]   = gfs_stat_array[i];
+			obj_handle_array[count] = obj_handle_array[i];
+			count++;
+		}
+
+		if ((Walk->Flags & WALK_WHOLE_DIRS) && !end)
+			continue;
+
+		result = walk_entries(Walk, ID, Dir, gfs_stat_array, obj_handle_array, count);
+
+		stat_destroy_array(gfs_stat_array, count);
+		count = 0;
+		if (result)
+			break;
+	}
+
+	stat_destroy_array(gfs_stat_array, count);
+	if (Walk->Flags & WALK_WHOLE_DIRS)
+	{
+		free(gfs_stat_array);
+		free(obj_handle_array);
+	}
+
+	if (result)
+		walk_set_result(Walk, result);
+}
+
+static void *
+walk_worker(void * Arg)
+{
+	walk_worker_t * worker = Arg;
+	walk_t        * walk   = worker->Walk;
+	walk_dir_t    * dir    = NULL;
+	int             i      = 0;
+	int             done   = 0;
+
+	/* Only commands walk trees. */
+	rpcstats_set_op(RPCSTATS_OP_COMMAND);
+
+	while (!done)
+	{
+		/* Our own work first, then steal from the others. */
+		dir = walk_take(walk, worker->ID, 0);
+		for (i = 1; !dir && i < walk->ThreadCount; i++)
+		{
+			dir = walk_take(walk, (worker->ID + i) % walk->ThreadCount, 1);
+		}
+
+		if (dir)
+		{
+			/* After an abort, just drain what is left. */
+			if (!walk_aborted(walk))
+				walk_read_dir(walk, worker->ID, dir);
+			walk_release(walk, dir);
+
+			pthread_mutex_lock(&walk->Mutex);
+			{
+				if (--walk->Outstanding == 0)
+					pthread_cond_broadcast(&walk->Cond);
+			}
+			pthread_mutex_unlock(&walk->Mutex);
+			continue;
+		}
+
+		pthread_mutex_lock(&walk->Mutex);
+		{
+			/*
+			 * Queued is checked under the lock so a push that lands
+			 * after our scan of the deques can not be missed.
+			 */
+			if (walk->Outstanding == 0)
+				done = 1;
+			else if (walk->Queued == 0)
+				pthread_cond_wait(&walk->Cond, &walk->Mutex);
+		}
+		pthread_mutex_unlock(&walk->Mutex);
+	}
+
+	return NULL;
+}
+
+globus_result_t
+walk(char                       * Pathname,
+     int                          MaxDepth,
+     int                          ThreadCount,
+     int                          Flags,
+     walk_entries_callback        EntriesCallback,
+     walk_dir_complete_callback   DirCompleteCallback,
+     void                       * UserArg)
+{
+	int              i            = 0;
+	int              retval       = 0;
+	int              thread_count = 0;
+	walk_dir_t     * root         = NULL;
+	globus_result_t  result       = GLOBUS_SUCCESS;
+	pthread_t        threads[WALK_MAX_THREADS];
+	walk_worker_t    workers[WALK_MAX_THREADS];
+	hpss_fileattr_t  dir_attrs;
+	hpss_stat_t      hpss_stat_buf;
+	walk_t           walk;
+
+	GlobusGFSName(walk);
+
+	if (ThreadCount < 1)
+		ThreadCount = 1;
+	if (ThreadCount > WALK_MAX_THREADS)
+		ThreadCount = WALK_MAX_THREADS;
+
+	/* hpss_FileGetAttributes() follows links; don't walk a tree we were not given. */
+	retval = hpss_Lstat(Pathname, &hpss_stat_buf);
+	if (retval)
+		return GlobusGFSErrorSystemError("hpss_Lstat", -retval);
+	if (S_ISLNK(hpss_stat_buf.st_mode))
+		return GlobusGFSErrorSystemError("walk", ENOTDIR);
+
+	retval = hpss_FileGetAttributes(Pathname, &dir_attrs);
+	if (retval < 0)
+		return GlobusGFSErrorSystemError("hpss_FileGetAttributes", -retval);
+
+	if (dir_attrs.Attrs.Type != NS_OBJECT_TYPE_DIRECTORY &&
+	    dir_attrs.Attrs.Type != NS_OBJECT_TYPE_JUNCTION  &&
+	    dir_attrs.Attrs.Type != NS_OBJECT_TYPE_FILESET_ROOT)
+	{
+		return GlobusGFSErrorSystemError("walk", ENOTDIR);
+	}
+
+	memset(&walk, 0, sizeof(walk_t));
+	pthread_mutex_init(&walk.Mutex, NULL);
+	pthread_cond_init(&walk.Cond, NULL);
+	walk.MaxDepth            = MaxDepth;
+	walk.ThreadCount         = ThreadCount;
+	walk.Flags               = Flags;
+	walk.EntriesCallback     = EntriesCallback;
+	walk.DirCompleteCallback = DirCompleteCallback;
+	walk.UserArg             = UserArg;
+
+	walk.Deques = malloc(sizeof(walk_deque_t) * ThreadCount);
+	if (!walk.Deques)
+	{
+		result = GlobusGFSErrorMemory("walk deques");
+		goto cleanup;
+	}
+	memset(walk.Deques, 0, sizeof(walk_deque_t) * ThreadCount);
+	for (i = 0; i < ThreadCount; i++)
+	{
+		pthread_mutex_init(&walk.Deques[i].Mutex, NULL);
+	}
+
+	root = walk_dir_new(NULL, &dir_attrs.ObjectHandle, Pathname, NULL);
+	if (!root)
+	{
+		result = GlobusGFSErrorMemory("walk_dir_t");
+		goto cleanup;
+	}
+
+	result = walk_push(&walk, 0, root);
+	if (result)
+	{
+		walk_dir_free(root);
+		goto cleanup;
+	}
+
+	/*
+	 * This thread is worker 0. Failing to start helpers only costs us
+	 * concurrency.
+	 */
+	for (i = 1; i < ThreadCount; i++)
+	{
+		workers[i].Walk = &walk;
+		workers[i].ID   = i;
+		if (pthread_create(&threads[thread_count], NULL, walk_worker, &workers[i]))
+			break;
+		thread_count++;
+	}
+
+	workers[0].Walk = &walk;
+	workers[0].ID   = 0;
+	walk_worker(&workers[0]);
+
+	for (i = 0; i < thread_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	result = walk.Result;
+
+cleanup:
+	if (walk.Deques)
+	{
+		for (i = 0; i < ThreadCount; i++)
+		{
+			if (walk.Deques[i].Dirs)
+				free(walk.Deques[i].Dirs);
+			pthread_mutex_destroy(&walk.Deques[i].Mutex);
+		}
+		free(walk.Deques);
+	}
+	pthread_cond_destroy(&walk.Cond);
+	pthread_mutex_destroy(&walk.Mutex);
+
+	return result;
+}
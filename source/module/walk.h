@@ -0,0 +1,120 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_WALK_H
+#define HPSS_DSI_WALK_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * HPSS includes
+ */
+#include <ns_ObjHandle.h>
+
+/* Directory entries read per hpss_ReadAttrsHandle() call. */
+#define WALK_ENTRIES_PER_CHUNK 200
+
+/* Upper bound on walk threads regardless of what is asked for. */
+#define WALK_MAX_THREADS 64
+
+/*
+ * walk() flags. WALK_WHOLE_DIRS reads each directory in full and passes it
+ * to the entries callback in one call, for callers that remove entries as
+ * they go; the offsets hpss_ReadAttrsHandle() hands back are not promised
+ * to survive removals, so the next chunk could skip entries.
+ */
+#define WALK_WHOLE_DIRS 0x01
+
+typedef struct walk_dir {
+	struct walk_dir * Parent;
+	ns_ObjHandle_t    ObjHandle;
+	char            * Path;    // Full path of this directory
+	char            * RelPath; // Path relative to the walk root, "" for the root
+	int               Depth;   // The root is depth 0
+	int               Pending; // Private to walk.c
+} walk_dir_t;
+
+/*
+ * Called with each chunk of entries read from Dir, in the same array/count
+ * form passed to globus_gridftp_server_finished_stat_partial(). Chunks from
+ * different directories are delivered concurrently from different threads.
+ * Returning an error aborts the walk.
+ */
+typedef globus_result_t (*walk_entries_callback)(walk_dir_t        * Dir,
+                                                 globus_gfs_stat_t * GFSStatArray,
+                                                 uint32_t            Count,
+                                                 void              * UserArg);
+
+/*
+ * Called once all of Dir's entries and all of its subdirectories have been
+ * walked (post order). Not called for directories left over after an abort.
+ */
+typedef void (*walk_dir_complete_callback)(walk_dir_t * Dir,
+                                           void       * UserArg);
+
+/*
+ * Walks the tree rooted at the directory Pathname, descending at most
+ * MaxDepth levels below it (MaxDepth < 0 is unlimited). Directories are
+ * handed out to ThreadCount workers, the calling thread being one of them,
+ * through per worker deques; idle workers steal from the others so one deep
+ * branch does not serialize the walk. Returns once the walk is complete with
+ * the first error encountered, if any. Flags is 0 or WALK_WHOLE_DIRS.
+ * Either callback may be NULL. A Pathname that is a symbolic link is
+ * refused (ENOTDIR), like any link found below it, so the walk never leaves
+ * the tree it was given.
+ */
+globus_result_t
+walk(char                       * Pathname,
+     int                          MaxDepth,
+     int                          ThreadCount,
+     int                          Flags,
+     walk_entries_callback        EntriesCallback,
+     walk_dir_complete_callback   DirCompleteCallback,
+     void                       * UserArg);
+
+#endif /* HPSS_DSI_WALK_H */
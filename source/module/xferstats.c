@@ -0,0 +1,107 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+
+/*
+ * System includes
+ */
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Globus includes
+ */
+#include <globus_gridftp_server.h>
+
+/*
+ * Local includes
+ */
+#include "histogram.h"
+#include "xferstats.h"
+
+void
+xferstats_init(xferstats_t * Stats, const char * Pathname)
+{
+	memset(Stats, 0, sizeof(xferstats_t));
+	Stats->Pathname  = strdup(Pathname);
+	Stats->StartTime = histogram_now();
+}
+
+void
+xferstats_callout_begin(xferstats_t * Stats)
+{
+	if (Stats->CalloutEnd)
+		Stats->WaitPIO += histogram_now() - Stats->CalloutEnd;
+}
+
+void
+xferstats_callout_end(xferstats_t * Stats, uint64_t Bytes)
+{
+	Stats->Bytes     += Bytes;
+	Stats->CalloutEnd = histogram_now();
+}
+
+void
+xferstats_buffers(xferstats_t * Stats, int BufferCount)
+{
+	if (BufferCount > Stats->BuffersMax)
+		Stats->BuffersMax = BufferCount;
+}
+
+void
+xferstats_log(xferstats_t * Stats, const char * Kind, handoff_t * Handoff)
+{
+	globus_gfs_log_message(GLOBUS_GFS_LOG_INFO,
+	                       "HPSS DSI %s %s: bytes=%"PRIu64" usecs=%"PRIu64" wait_gridftp=%"PRIu64
+	                       " wait_pio=%"PRIu64" sleeps=%"PRIu64" wakeups=%"PRIu64" buffers_max=%d\n",
+	                       Kind,
+	                       Stats->Pathname ? Stats->Pathname : "",
+	                       Stats->Bytes,
+	                       histogram_now() - Stats->StartTime,
+	                       Stats->WaitGridFTP,
+	                       Stats->WaitPIO,
+	                       Handoff ? Handoff->Sleeps  : 0,
+	                       Handoff ? Handoff->Wakeups : 0,
+	                       Stats->BuffersMax);
+
+	free(Stats->Pathname);
+	Stats->Pathname = NULL;
+}
@@ -0,0 +1,97 @@
+/*
+ * University of Illinois/NCSA Open Source License
+ *
+ * Copyright  2017 NCSA.  All rights reserved.
+ *
+ * Developed by:
+ *
+ * Storage Enabling Technologies (SET)
+ *
+ * Nation Center for Supercomputing Applications (NCSA)
+ *
+ * http://www.ncsa.illinois.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the .Software.),
+ * to deal with the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ *    + Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *
+ *    + Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *    + Neither the names of SET, NCSA
+ *      nor the names of its contributors may be used to endorse or promote
+ *      products derived from this Software without specific prior written
+ *      permission.
+ *
+ * THE SOFTWARE IS PROVIDED .AS IS., WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS WITH THE SOFTWARE.
+ */
+#ifndef HPSS_DSI_XFERSTATS_H
+#define HPSS_DSI_XFERSTATS_H
+
+/*
+ * System includes
+ */
+#include <stdint.h>
+
+/*
+ * Local includes
+ */
+#include "handoff.h"
+
+/*
+ * Per transfer accounting of where the transfer pipeline spends its time,
+ * logged when the transfer completes. All times are in usecs.
+ *
+ * The counters are only updated by the PIO thread (and by the transfer
+ * complete callback once PIO is done), so they need no locking.
+ */
+typedef struct {
+	char     * Pathname;
+	uint64_t   StartTime;
+	uint64_t   Bytes;
+
+	uint64_t   WaitGridFTP;   // PIO thread blocked on the network side
+	uint64_t   WaitPIO;       // Between PIO callouts, ie in the mover
+	int        BuffersMax;    // High water mark of allocated buffers
+
+	/* Private */
+	uint64_t   CalloutEnd;
+} xferstats_t;
+
+void
+xferstats_init(xferstats_t * Stats, const char * Pathname);
+
+/* Bracket each PIO data callout; the time in between is the mover's. */
+void
+xferstats_callout_begin(xferstats_t * Stats);
+
+void
+xferstats_callout_end(xferstats_t * Stats, uint64_t Bytes);
+
+/* Call with the current number of allocated buffers. */
+void
+xferstats_buffers(xferstats_t * Stats, int BufferCount);
+
+/*
+ * Logs a one line summary at INFO level and releases Stats' resources, ie
+ *  HPSS DSI RETR /path: bytes=.. usecs=.. wait_gridftp=.. wait_pio=..
+ *  sleeps=.. wakeups=.. buffers_max=..
+ * where sleeps and wakeups come from the transfer's Handoff, if any.
+ */
+void
+xferstats_log(xferstats_t * Stats, const char * Kind, handoff_t * Handoff);
+
+#endif /* HPSS_DSI_XFERSTATS_H */